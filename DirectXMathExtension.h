@@ -496,6 +496,88 @@ __declspec(align(16)) struct MXMFLOAT4X4A : public XMFLOAT4X4A
   }
 };
 
+//------------------------------------------------------------------------------
+// Structure of arrays
+//
+// Loading four consecutive MXMFLOAT3 (AoS) into three XMVECTORs holding all
+// x, y and z components (SoA) and back, or four MXMFLOAT3X3 into one XMVECTOR
+// per element. Used by the batch kernels of the additional headers.
+
+__MXM_INLINE void XM_CALLCONV MXMLoadFloat3SoA(_In_reads_(4) const MXMFLOAT3 *pSource,
+                                               XMVECTOR &x, XMVECTOR &y, XMVECTOR &z)
+{
+  const float *p = &pSource->x;
+  XMVECTOR a = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));     // x0 y0 z0 x1
+  XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 4)); // y1 z1 x2 y2
+  XMVECTOR c = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 8)); // z2 x3 y3 z3
+
+  x = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_1W>(a, b);
+  x = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1Y>(x, c);
+  y = XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W, XM_PERMUTE_0W>(a, b);
+  y = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1Z>(y, c);
+  z = XMVectorPermute<XM_PERMUTE_0Z, XM_PERMUTE_1Y, XM_PERMUTE_0X, XM_PERMUTE_0Y>(a, b);
+  z = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W>(z, c);
+}
+
+__MXM_INLINE void XM_CALLCONV MXMStoreFloat3SoA(_Out_writes_(4) MXMFLOAT3 *pDestination,
+                                                FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+  float *p = &pDestination->x;
+  XMVECTOR xy = XMVectorMergeXY(x, y); // x0 y0 x1 y1
+  XMVECTOR zx = XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_1Z, XM_PERMUTE_0Z, XM_PERMUTE_1W>(z, x); // z1 x2 z2 x3
+  XMVECTOR yz = XMVectorMergeZW(y, z); // y2 z2 y3 z3
+
+  XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p),
+                XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_0Z>(xy, z));
+  XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p + 4),
+                XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1Y, XM_PERMUTE_0Z>(y, zx));
+  XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p + 8),
+                XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_1W, XM_PERMUTE_0Z, XM_PERMUTE_0W>(yz, x));
+}
+
+// Four 3x3 matrices with every element in its own XMVECTOR, m[row][column].
+struct MXMFLOAT3X3SOA
+{
+  XMVECTOR m[3][3];
+};
+
+__MXM_INLINE void MXMLoadFloat3x3SoA(_In_reads_(4) const MXMFLOAT3X3 *pSource, MXMFLOAT3X3SOA &matrices)
+{
+  for (int r = 0; r < 3; ++r) {
+    XMMATRIX rows(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pSource[0].m[r])),
+                  XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pSource[1].m[r])),
+                  XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pSource[2].m[r])),
+                  XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pSource[3].m[r])));
+    rows = XMMatrixTranspose(rows);
+    matrices.m[r][0] = rows.r[0];
+    matrices.m[r][1] = rows.r[1];
+    matrices.m[r][2] = rows.r[2];
+  }
+}
+
+__MXM_INLINE void MXMStoreFloat3x3SoA(_Out_writes_(4) MXMFLOAT3X3 *pDestination, const MXMFLOAT3X3SOA &matrices)
+{
+  for (int r = 0; r < 3; ++r) {
+    XMMATRIX rows(matrices.m[r][0], matrices.m[r][1], matrices.m[r][2], XMVectorZero());
+    rows = XMMatrixTranspose(rows);
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(pDestination[0].m[r]), rows.r[0]);
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(pDestination[1].m[r]), rows.r[1]);
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(pDestination[2].m[r]), rows.r[2]);
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(pDestination[3].m[r]), rows.r[3]);
+  }
+}
+
+// Returns the sign bits of the four components as a 4 bit mask (x = bit 0).
+__MXM_INLINE uint32_t XM_CALLCONV MXMVectorMoveMask(FXMVECTOR v)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return (uint32_t)_mm_movemask_ps(v);
+#else
+  return (XMVectorGetIntX(v) >> 31) | ((XMVectorGetIntY(v) >> 31) << 1) |
+         ((XMVectorGetIntZ(v) >> 31) << 2) | ((XMVectorGetIntW(v) >> 31) << 3);
+#endif
+}
+
 #ifdef _MXM_USE_OVERWRITE_DEFINES
 
 # define XMFLOAT2    MXMFLOAT2
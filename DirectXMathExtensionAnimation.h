@@ -0,0 +1,417 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Compression of uniformly sampled animation clips made of rotation tracks
+  (quaternions in MXMFLOAT4) and translation tracks (MXMFLOAT3).
+
+  The compressor applies three steps, all driven by a single error metric:
+  - range reduction: every track stores its own min and extent, samples are
+    normalized into that range before quantization.
+  - variable bit-rate: every track gets the smallest bit count (0..16 bits
+    per component) that keeps its error below the tolerance. Tracks that do
+    not move at all end up with 0 bits and cost nothing per key.
+  - key reduction: frames which can be linearly interpolated from their
+    neighbours within the tolerance are removed for the whole clip, so a pose
+    is always decoded from exactly two keys.
+
+  The error of a rotation is measured as the largest distance a virtual vertex
+  at shellDistance from the joint can move, the error of a translation is its
+  euclidean distance. Both are compared against the same tolerance.
+
+  Decompression decodes a whole pose four tracks at a time in SoA layout,
+  one XMVECTOR per component with a track in every lane: the bits of the
+  four tracks are gathered into the lanes, then masked, converted,
+  dequantized, interpolated and, for rotations, normalized with vector
+  operations before being transposed straight into the MXM arrays. Tracks
+  left over at the end of the rotations and translations are decoded one by
+  one.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMCOMPRESSEDCLIP clip;
+    MXMCompressClip(clip, rotations, boneCount, translations, boneCount,
+                    frameCount, MXMCLIPCOMPRESSIONSETTINGS());
+    // ... //
+    MXMDecompressPose(clip, time * sampleRate, poseRotations, poseTranslations);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+namespace DirectX
+{
+
+struct MXMCLIPCOMPRESSIONSETTINGS
+{
+  float tolerance;      // maximum allowed error in world units
+  float shellDistance;  // distance of the virtual vertex for rotation errors
+  bool  reduceKeys;     // drop frames which can be interpolated
+
+  MXMCLIPCOMPRESSIONSETTINGS() : tolerance(0.0001f), shellDistance(1.0f), reduceKeys(true) {}
+};
+
+struct MXMCOMPRESSEDCLIP
+{
+  uint32_t rotationTrackCount;
+  uint32_t translationTrackCount;
+  uint32_t frameCount;
+  uint32_t keyBits;                  // bits used by one key of all tracks
+
+  std::vector<MXMFLOAT4> rangeMin;   // per track, rotation tracks first
+  std::vector<MXMFLOAT4> rangeScale; // per track, extent / ((1 << bits) - 1)
+  std::vector<uint8_t>   trackBits;  // per track, bits per component
+  std::vector<uint32_t>  keyFrames;  // frame index of every stored key
+  std::vector<uint8_t>   data;       // keyFrames.size() * keyBits, padded
+
+  MXMCOMPRESSEDCLIP() : rotationTrackCount(0), translationTrackCount(0), frameCount(0), keyBits(0) {}
+
+  size_t SizeInBytes() const {
+    return rangeMin.size() * sizeof(MXMFLOAT4) * 2 + trackBits.size() +
+           keyFrames.size() * sizeof(uint32_t) + data.size();
+  }
+};
+
+//------------------------------------------------------------------------------
+// Bit stream helpers
+
+__MXM_INLINE uint32_t MXMReadBits(_In_ const uint8_t *pData, size_t bitOffset, uint32_t bits)
+{
+  uint64_t word;
+  memcpy(&word, pData + (bitOffset >> 3), sizeof(word));
+  return (uint32_t)(word >> (bitOffset & 7)) & ((1u << bits) - 1u);
+}
+
+__MXM_INLINE void MXMWriteBits(_Inout_ uint8_t *pData, size_t bitOffset, uint32_t bits, uint32_t value)
+{
+  for (uint32_t i = 0; i < bits; ++i, ++bitOffset) {
+    if (value & (1u << i))
+      pData[bitOffset >> 3] |= (uint8_t)(1u << (bitOffset & 7));
+  }
+}
+
+// Unpacks one key of a track and dequantizes it using the track range.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMDecodeTrackKey(_In_ const uint8_t *pData, size_t bitOffset, uint32_t bits,
+                                                    uint32_t components, FXMVECTOR rangeMin, FXMVECTOR rangeScale)
+{
+  if (bits == 0)
+    return rangeMin;
+
+  uint32_t q[4] = { 0, 0, 0, 0 };
+  for (uint32_t c = 0; c < components; ++c, bitOffset += bits)
+    q[c] = MXMReadBits(pData, bitOffset, bits);
+
+  return XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadInt4(q), 0), rangeScale, rangeMin);
+}
+
+// Reads the bits at the given offsets of four tracks into the lanes of a
+// vector, shifted down but not masked. A component has at most 16 bits, so
+// it always lies within the 32 bits at its byte offset.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMGatherTrackBits(_In_ const uint8_t *pData, size_t keyOffset, _In_reads_(4) const size_t *pOffsets)
+{
+  uint32_t words[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    const size_t bitOffset = keyOffset + pOffsets[i];
+    memcpy(&words[i], pData + (bitOffset >> 3), sizeof(uint32_t));
+    words[i] >>= bitOffset & 7;
+  }
+  return XMLoadInt4(words);
+}
+
+// Decodes four tracks at two keys and interpolates them in SoA layout: lane i
+// of pComponents[c] receives component c of track track + i. trackOffset is
+// the bit offset of the first track within a key and is advanced past the
+// four tracks. The tracks may have different bit rates.
+inline void XM_CALLCONV MXMDecodeTracks4(const MXMCOMPRESSEDCLIP &clip, size_t track, uint32_t components,
+                                         size_t keyOffset0, size_t keyOffset1, FXMVECTOR vAlpha, size_t &trackOffset,
+                                         _Out_writes_(components) XMVECTOR *pComponents)
+{
+  size_t offsets[4];
+  uint32_t bits[4], masks[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    bits[i] = clip.trackBits[track + i];
+    masks[i] = (1u << bits[i]) - 1u;
+    offsets[i] = trackOffset;
+    trackOffset += bits[i] * components;
+  }
+  const XMVECTOR vMask = XMLoadInt4(masks);
+
+  // 0 bit tracks decode to 0 * 0 + rangeMin
+  const XMMATRIX rangeMin = XMMatrixTranspose(XMMATRIX(clip.rangeMin[track], clip.rangeMin[track + 1],
+                                                       clip.rangeMin[track + 2], clip.rangeMin[track + 3]));
+  const XMMATRIX rangeScale = XMMatrixTranspose(XMMATRIX(clip.rangeScale[track], clip.rangeScale[track + 1],
+                                                         clip.rangeScale[track + 2], clip.rangeScale[track + 3]));
+
+  const uint8_t *pData = &clip.data[0];
+  for (uint32_t c = 0; c < components; ++c) {
+    XMVECTOR a = XMConvertVectorUIntToFloat(XMVectorAndInt(MXMGatherTrackBits(pData, keyOffset0, offsets), vMask), 0);
+    XMVECTOR b = XMConvertVectorUIntToFloat(XMVectorAndInt(MXMGatherTrackBits(pData, keyOffset1, offsets), vMask), 0);
+    a = XMVectorMultiplyAdd(a, rangeScale.r[c], rangeMin.r[c]);
+    b = XMVectorMultiplyAdd(b, rangeScale.r[c], rangeMin.r[c]);
+    pComponents[c] = XMVectorLerpV(a, b, vAlpha);
+    for (uint32_t i = 0; i < 4; ++i)
+      offsets[i] += bits[i];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Error metric
+
+__MXM_INLINE float XM_CALLCONV MXMTrackError(FXMVECTOR reference, FXMVECTOR value, bool isRotation, float shellDistance)
+{
+  if (isRotation) {
+    // chord of the rotation between both quaternions: 2 * r * sin(angle / 2)
+    float d = XMVectorGetX(XMVector4Dot(reference, XMQuaternionNormalize(value)));
+    float s = 1.0f - d * d;
+    return 2.0f * shellDistance * sqrtf(s > 0.0f ? s : 0.0f);
+  }
+  return XMVectorGetX(XMVector3Length(XMVectorSubtract(reference, value)));
+}
+
+//------------------------------------------------------------------------------
+// Compression
+
+inline void MXMCompressClip(_Out_ MXMCOMPRESSEDCLIP &clip,
+                            _In_reads_(rotationTrackCount * frameCount) const MXMFLOAT4 *pRotations, size_t rotationTrackCount,
+                            _In_reads_(translationTrackCount * frameCount) const MXMFLOAT3 *pTranslations, size_t translationTrackCount,
+                            size_t frameCount, const MXMCLIPCOMPRESSIONSETTINGS &settings)
+{
+  const size_t trackCount = rotationTrackCount + translationTrackCount;
+
+  clip.rotationTrackCount = (uint32_t)rotationTrackCount;
+  clip.translationTrackCount = (uint32_t)translationTrackCount;
+  clip.frameCount = (uint32_t)frameCount;
+  clip.rangeMin.resize(trackCount);
+  clip.rangeScale.resize(trackCount);
+  clip.trackBits.resize(trackCount);
+  clip.keyFrames.clear();
+  clip.data.clear();
+
+  if (frameCount == 0 || trackCount == 0) {
+    clip.keyBits = 0;
+    return;
+  }
+
+  // gather the source samples track-major, rotations made continuous so that
+  // neighbouring keys are always in the same hemisphere
+  std::vector<MXMFLOAT4> samples(trackCount * frameCount);
+  for (size_t t = 0; t < rotationTrackCount; ++t) {
+    XMVECTOR previous = XMQuaternionIdentity();
+    for (size_t f = 0; f < frameCount; ++f) {
+      XMVECTOR q = XMQuaternionNormalize(pRotations[f * rotationTrackCount + t]);
+      if (XMVectorGetX(XMVector4Dot(q, previous)) < 0.0f)
+        q = XMVectorNegate(q);
+      samples[t * frameCount + f] = q;
+      previous = q;
+    }
+  }
+  for (size_t t = 0; t < translationTrackCount; ++t) {
+    for (size_t f = 0; f < frameCount; ++f)
+      samples[(rotationTrackCount + t) * frameCount + f] = XMVectorSetW(pTranslations[f * translationTrackCount + t], 0.0f);
+  }
+
+  // range reduction and bit-rate selection
+  std::vector<MXMFLOAT4> decoded(trackCount * frameCount);
+  clip.keyBits = 0;
+  for (size_t t = 0; t < trackCount; ++t) {
+    const bool isRotation = t < rotationTrackCount;
+    const MXMFLOAT4 *pTrack = &samples[t * frameCount];
+
+    XMVECTOR vMin = pTrack[0];
+    XMVECTOR vMax = vMin;
+    for (size_t f = 1; f < frameCount; ++f) {
+      XMVECTOR v = pTrack[f];
+      vMin = XMVectorMin(vMin, v);
+      vMax = XMVectorMax(vMax, v);
+    }
+    XMVECTOR vExtent = XMVectorSubtract(vMax, vMin);
+
+    uint32_t bits = 0;
+    for (; bits <= 16; ++bits) {
+      // 1 and 2 bits hardly ever satisfy a moving track, start at 3
+      if (bits == 1)
+        bits = 3;
+
+      XMVECTOR vScale = XMVectorZero();
+      XMVECTOR vBase = vMin;
+      if (bits == 0) {
+        vBase = XMVectorMultiplyAdd(vExtent, XMVectorReplicate(0.5f), vMin);
+      } else {
+        vScale = XMVectorScale(vExtent, 1.0f / (float)((1u << bits) - 1u));
+      }
+      XMVECTOR vInvScale = XMVectorSelect(XMVectorReciprocal(vScale), XMVectorZero(), XMVectorEqual(vScale, XMVectorZero()));
+
+      bool fits = true;
+      for (size_t f = 0; f < frameCount; ++f) {
+        XMVECTOR v = pTrack[f];
+        XMVECTOR q = XMVectorRound(XMVectorMultiply(XMVectorSubtract(v, vBase), vInvScale));
+        XMVECTOR r = XMVectorMultiplyAdd(q, vScale, vBase);
+        if (MXMTrackError(v, r, isRotation, settings.shellDistance) > settings.tolerance) {
+          fits = false;
+          break;
+        }
+      }
+      if (fits || bits == 16) {
+        clip.rangeMin[t] = vBase;
+        clip.rangeScale[t] = vScale;
+        break;
+      }
+    }
+    clip.trackBits[t] = (uint8_t)bits;
+    clip.keyBits += bits * (isRotation ? 4 : 3);
+
+    XMVECTOR vBase = clip.rangeMin[t];
+    XMVECTOR vScale = clip.rangeScale[t];
+    XMVECTOR vInvScale = XMVectorSelect(XMVectorReciprocal(vScale), XMVectorZero(), XMVectorEqual(vScale, XMVectorZero()));
+    for (size_t f = 0; f < frameCount; ++f) {
+      XMVECTOR q = XMVectorRound(XMVectorMultiply(XMVectorSubtract(pTrack[f], vBase), vInvScale));
+      decoded[t * frameCount + f] = XMVectorMultiplyAdd(q, vScale, vBase);
+    }
+  }
+
+  // key reduction: extend every segment as long as all frames in between can
+  // be interpolated from the quantized end keys within the tolerance
+  clip.keyFrames.push_back(0);
+  if (settings.reduceKeys) {
+    size_t keyFrame = 0;
+    for (size_t candidate = 2; candidate < frameCount; ++candidate) {
+      bool fits = true;
+      for (size_t t = 0; t < trackCount && fits; ++t) {
+        const bool isRotation = t < rotationTrackCount;
+        XMVECTOR a = decoded[t * frameCount + keyFrame];
+        XMVECTOR b = decoded[t * frameCount + candidate];
+        const float invSpan = 1.0f / (float)(candidate - keyFrame);
+        for (size_t f = keyFrame + 1; f < candidate; ++f) {
+          XMVECTOR r = XMVectorLerp(a, b, (float)(f - keyFrame) * invSpan);
+          if (MXMTrackError(samples[t * frameCount + f], r, isRotation, settings.shellDistance) > settings.tolerance) {
+            fits = false;
+            break;
+          }
+        }
+      }
+      if (!fits) {
+        keyFrame = candidate - 1;
+        clip.keyFrames.push_back((uint32_t)keyFrame);
+      }
+    }
+    if (frameCount > 1)
+      clip.keyFrames.push_back((uint32_t)(frameCount - 1));
+  } else {
+    for (size_t f = 1; f < frameCount; ++f)
+      clip.keyFrames.push_back((uint32_t)f);
+  }
+
+  // pack the quantized keys, 8 bytes padding allow unaligned 64 bit reads
+  const size_t keyCount = clip.keyFrames.size();
+  clip.data.assign((keyCount * clip.keyBits + 7) / 8 + 8, 0);
+  size_t bitOffset = 0;
+  for (size_t k = 0; k < keyCount; ++k) {
+    const size_t f = clip.keyFrames[k];
+    for (size_t t = 0; t < trackCount; ++t) {
+      const uint32_t bits = clip.trackBits[t];
+      const uint32_t components = t < rotationTrackCount ? 4 : 3;
+      if (bits == 0)
+        continue;
+
+      XMVECTOR vScale = clip.rangeScale[t];
+      XMVECTOR vInvScale = XMVectorSelect(XMVectorReciprocal(vScale), XMVectorZero(), XMVectorEqual(vScale, XMVectorZero()));
+      XMVECTOR q = XMVectorRound(XMVectorMultiply(XMVectorSubtract(samples[t * frameCount + f], clip.rangeMin[t]), vInvScale));
+      q = XMVectorClamp(q, XMVectorZero(), XMVectorReplicate((float)((1u << bits) - 1u)));
+
+      uint32_t values[4];
+      XMStoreInt4(values, XMConvertVectorFloatToUInt(q, 0));
+      for (uint32_t c = 0; c < components; ++c, bitOffset += bits)
+        MXMWriteBits(&clip.data[0], bitOffset, bits, values[c]);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Decompression
+
+// Decodes the full pose at the given (fractional) frame. Frames outside of the
+// clip are clamped to its first or last key.
+inline void MXMDecompressPose(const MXMCOMPRESSEDCLIP &clip, float frame,
+                              _Out_writes_(clip.rotationTrackCount) MXMFLOAT4 *pRotations,
+                              _Out_writes_(clip.translationTrackCount) MXMFLOAT3 *pTranslations)
+{
+  if (clip.keyFrames.empty())
+    return;
+
+  // locate the two keys around the frame
+  const size_t keyCount = clip.keyFrames.size();
+  const float lastFrame = (float)clip.keyFrames[keyCount - 1];
+  frame = frame < 0.0f ? 0.0f : (frame > lastFrame ? lastFrame : frame);
+
+  size_t key1 = std::upper_bound(clip.keyFrames.begin(), clip.keyFrames.end(), (uint32_t)frame) - clip.keyFrames.begin();
+  if (key1 >= keyCount)
+    key1 = keyCount - 1;
+  const size_t key0 = key1 > 0 ? key1 - 1 : 0;
+
+  const float frame0 = (float)clip.keyFrames[key0];
+  const float frame1 = (float)clip.keyFrames[key1];
+  const XMVECTOR vAlpha = XMVectorReplicate(frame1 > frame0 ? (frame - frame0) / (frame1 - frame0) : 0.0f);
+
+  const uint8_t *pData = &clip.data[0];
+  const size_t keyOffset0 = key0 * clip.keyBits;
+  const size_t keyOffset1 = key1 * clip.keyBits;
+  size_t trackOffset = 0;
+
+  // four tracks at a time in SoA layout, the remaining ones one by one
+  const size_t rotationTrackCount = clip.rotationTrackCount;
+  size_t t = 0;
+  for (; t + 4 <= rotationTrackCount; t += 4) {
+    XMVECTOR q[4];
+    MXMDecodeTracks4(clip, t, 4, keyOffset0, keyOffset1, vAlpha, trackOffset, q);
+
+    XMVECTOR length = XMVectorMultiply(q[0], q[0]);
+    length = XMVectorMultiplyAdd(q[1], q[1], length);
+    length = XMVectorMultiplyAdd(q[2], q[2], length);
+    length = XMVectorSqrt(XMVectorMultiplyAdd(q[3], q[3], length));
+    const XMVECTOR nonZero = XMVectorNotEqual(length, XMVectorZero());
+    for (uint32_t c = 0; c < 4; ++c)
+      q[c] = XMVectorAndInt(XMVectorDivide(q[c], length), nonZero);
+
+    const XMMATRIX rotations = XMMatrixTranspose(XMMATRIX(q[0], q[1], q[2], q[3]));
+    for (uint32_t i = 0; i < 4; ++i)
+      pRotations[t + i] = rotations.r[i];
+  }
+  for (; t < rotationTrackCount; ++t) {
+    const uint32_t bits = clip.trackBits[t];
+    XMVECTOR vMin = clip.rangeMin[t];
+    XMVECTOR vScale = clip.rangeScale[t];
+    XMVECTOR a = MXMDecodeTrackKey(pData, keyOffset0 + trackOffset, bits, 4, vMin, vScale);
+    XMVECTOR b = MXMDecodeTrackKey(pData, keyOffset1 + trackOffset, bits, 4, vMin, vScale);
+    pRotations[t] = XMQuaternionNormalize(XMVectorLerpV(a, b, vAlpha));
+    trackOffset += bits * 4;
+  }
+
+  const size_t trackCount = rotationTrackCount + clip.translationTrackCount;
+  for (; t + 4 <= trackCount; t += 4) {
+    XMVECTOR v[4];
+    MXMDecodeTracks4(clip, t, 3, keyOffset0, keyOffset1, vAlpha, trackOffset, v);
+    v[3] = XMVectorZero();
+
+    const XMMATRIX translations = XMMatrixTranspose(XMMATRIX(v[0], v[1], v[2], v[3]));
+    for (uint32_t i = 0; i < 4; ++i)
+      pTranslations[t + i - rotationTrackCount] = translations.r[i];
+  }
+  for (; t < trackCount; ++t) {
+    const uint32_t bits = clip.trackBits[t];
+    XMVECTOR vMin = clip.rangeMin[t];
+    XMVECTOR vScale = clip.rangeScale[t];
+    XMVECTOR a = MXMDecodeTrackKey(pData, keyOffset0 + trackOffset, bits, 3, vMin, vScale);
+    XMVECTOR b = MXMDecodeTrackKey(pData, keyOffset1 + trackOffset, bits, 3, vMin, vScale);
+    pTranslations[t - rotationTrackCount] = XMVectorLerpV(a, b, vAlpha);
+    trackOffset += bits * 3;
+  }
+}
+
+} //namespace DirectX
@@ -0,0 +1,774 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Bounding volume hierarchy over triangles or axis aligned boxes.
+
+  Triangles are given as a flat MXMFLOAT3 array with three vertices per
+  triangle, boxes as MXMFLOAT3 min and max arrays. The builder bins the
+  primitive centroids into 16 bins along the largest axis and splits at the
+  lowest surface area heuristic cost. The resulting binary tree is collapsed
+  into nodes with four children whose bounds are stored in SoA layout, so a
+  ray or box is tested against all four children of a node with one set of
+  XMVECTOR operations.
+
+  The binary tree is at most MXM_BVH_MAX_DEPTH levels deep: below half of
+  that depth the builder falls back to median splits, which halve the
+  primitive count per level. This bounds the traversal stacks.
+
+  The build can be distributed over the caller's threads: MXMBVHBuildBegin
+  makes the top level splits and leaves the ranges below them as tasks,
+  MXMBVHBuildSubtree builds the subtree of one task, tasks are independent,
+  and MXMBVHBuildEnd stitches the subtrees together and collapses the tree.
+
+  Nodes are stored parents first. Refitting for animated geometry walks them
+  backwards and recomputes all bounds without changing the topology; rebuild
+  once the animation moved the primitives far from their original layout.
+
+  Queries:
+  - MXMBVHIntersectRay: closest hit of a single ray against a triangle BVH.
+  - MXMBVHIntersectRayAny: any hit, for occlusion and visibility rays.
+  - MXMBVHIntersectPacket: closest hits of a packet of four rays, using the
+    packet triangle kernels of DirectXMathExtensionRay.h in the leaves.
+  - MXMBVHQueryBox: all primitives whose bounds overlap a box.
+
+  All queries only read the BVH and can run concurrently.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMBVH bvh;
+    MXMBVHBuildTriangles(bvh, vertices, triangleCount);
+
+    float t;
+    uint32_t triangle;
+    if (MXMBVHIntersectRay(bvh, vertices, origin, direction, 1000.0f, t, triangle))
+      // ... //
+
+    // after the vertices moved
+    MXMBVHRefitTriangles(bvh, vertices);
+
+    // or built from primitive bounds with a job system
+    MXMBVHBUILD build;
+    MXMBVHBuildBegin(build, bvh, &boundsMin[0], &boundsMax[0], count, 4 * workerCount);
+    for (size_t t = 0; t < build.TaskCount(); ++t)   // distributed across threads
+      MXMBVHBuildSubtree(build, t);
+    MXMBVHBuildEnd(build);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionRay.h"
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+
+namespace DirectX
+{
+
+#define MXM_BVH_EMPTY      0xFFFFFFFFu
+#define MXM_BVH_BIN_COUNT  16
+#define MXM_BVH_MAX_DEPTH  64
+// a visited node replaces itself by at most four children on the stack
+#define MXM_BVH_STACK_SIZE (3 * MXM_BVH_MAX_DEPTH + 1)
+
+// Node with four children. A child with count == 0 is an inner node at index
+// child, otherwise a leaf with the primitives [child, child + count) of
+// MXMBVH::primitives. Unused children have child == MXM_BVH_EMPTY.
+struct MXMBVHNODE
+{
+  float minX[4], minY[4], minZ[4];
+  float maxX[4], maxY[4], maxZ[4];
+  uint32_t child[4];
+  uint32_t count[4];
+};
+
+struct MXMBVH
+{
+  std::vector<MXMBVHNODE> nodes;     // nodes[0] is the root
+  std::vector<uint32_t> primitives;  // primitive indices referenced by leaves
+};
+
+struct MXMBVHBUILDSETTINGS
+{
+  uint32_t maxLeafSize;              // leaves never hold more primitives
+  float traversalCost;               // cost of a node visit relative to a primitive test
+
+  MXMBVHBUILDSETTINGS() : maxLeafSize(4), traversalCost(1.0f) {}
+};
+
+//------------------------------------------------------------------------------
+// Builder
+
+struct MXMBVHBINARYNODE
+{
+  MXMFLOAT3 boundsMin, boundsMax;
+  uint32_t left, right;              // children, left == MXM_BVH_EMPTY for leaves
+  uint32_t first, count;             // primitive range for leaves
+};
+
+__MXM_INLINE float XM_CALLCONV MXMBVHSurfaceArea(FXMVECTOR boundsMin, FXMVECTOR boundsMax)
+{
+  XMVECTOR e = XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorZero());
+  XMVECTOR f = XMVectorSwizzle<1, 2, 0, 3>(e);
+  return 2.0f * XMVectorGetX(XMVector3Dot(e, f));
+}
+
+// Partition predicate, true for primitives left of the split bin.
+struct MXMBVHBINPREDICATE
+{
+  const MXMFLOAT3 *pCentroids;
+  int axis;
+  float centroidMin, binScale;
+  uint32_t splitBin;
+
+  bool operator()(uint32_t primitive) const {
+    const float *c = &pCentroids[primitive].x;
+    int32_t bin = (int32_t)((c[axis] - centroidMin) * binScale);
+    bin = bin < 0 ? 0 : (bin >= MXM_BVH_BIN_COUNT ? MXM_BVH_BIN_COUNT - 1 : bin);
+    return (uint32_t)bin < splitBin;
+  }
+};
+
+// Subtree of the binary tree left for MXMBVHBuildSubtree, built over the
+// primitives [first, first + count) and then stitched in place of node.
+struct MXMBVHBUILDTASK
+{
+  uint32_t first, count, depth;
+  uint32_t node;                     // placeholder node in MXMBVHBUILD::nodes
+  uint32_t root;                     // root of the subtree in nodes
+  std::vector<MXMBVHBINARYNODE> nodes;
+};
+
+struct MXMBVHBUILDER
+{
+  const MXMFLOAT3 *pMin, *pMax, *pCentroids;
+  MXMBVHBUILDSETTINGS settings;
+  std::vector<uint32_t> *pPrimitives;
+  std::vector<MXMBVHBINARYNODE> nodes;
+  std::vector<MXMBVHBUILDTASK> *pTasks; // if set, ranges of at most taskSize primitives become tasks
+  uint32_t taskSize;
+
+  MXMBVHBUILDER() : pMin(NULL), pMax(NULL), pCentroids(NULL), pPrimitives(NULL), pTasks(NULL), taskSize(0) {}
+
+  uint32_t MakeLeaf(uint32_t first, uint32_t count, FXMVECTOR boundsMin, FXMVECTOR boundsMax) {
+    MXMBVHBINARYNODE node;
+    node.boundsMin = boundsMin;
+    node.boundsMax = boundsMax;
+    node.left = node.right = MXM_BVH_EMPTY;
+    node.first = first;
+    node.count = count;
+    nodes.push_back(node);
+    return (uint32_t)nodes.size() - 1;
+  }
+
+  uint32_t Build(uint32_t first, uint32_t count, uint32_t depth) {
+    std::vector<uint32_t> &prims = *pPrimitives;
+
+    if (pTasks && count <= taskSize) {
+      MXMBVHBUILDTASK task;
+      task.first = first;
+      task.count = count;
+      task.depth = depth;
+      task.node = MakeLeaf(first, count, XMVectorZero(), XMVectorZero());
+      task.root = MXM_BVH_EMPTY;
+      pTasks->push_back(task);
+      return task.node;
+    }
+
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    XMVECTOR centroidMin = boundsMin;
+    XMVECTOR centroidMax = boundsMax;
+    for (uint32_t i = first; i < first + count; ++i) {
+      const uint32_t p = prims[i];
+      boundsMin = XMVectorMin(boundsMin, pMin[p]);
+      boundsMax = XMVectorMax(boundsMax, pMax[p]);
+      XMVECTOR c = pCentroids[p];
+      centroidMin = XMVectorMin(centroidMin, c);
+      centroidMax = XMVectorMax(centroidMax, c);
+    }
+    if (count <= 1)
+      return MakeLeaf(first, count, boundsMin, boundsMax);
+
+    // median splits need at most 32 more levels for any uint32_t count
+    if (depth >= MXM_BVH_MAX_DEPTH - 32) {
+      if (count <= settings.maxLeafSize)
+        return MakeLeaf(first, count, boundsMin, boundsMax);
+      return Split(first, count, count / 2, boundsMin, boundsMax, depth);
+    }
+
+    // split axis: largest extent of the centroids
+    XMFLOAT3 extent, cMin;
+    XMStoreFloat3(&extent, XMVectorSubtract(centroidMax, centroidMin));
+    XMStoreFloat3(&cMin, centroidMin);
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    const float axisExtent = (&extent.x)[axis];
+
+    if (axisExtent <= 0.0f) {
+      // all centroids in one spot, no spatial split possible
+      if (count <= settings.maxLeafSize)
+        return MakeLeaf(first, count, boundsMin, boundsMax);
+      return Split(first, count, count / 2, boundsMin, boundsMax, depth);
+    }
+
+    // bin the centroids
+    XMVECTOR binMin[MXM_BVH_BIN_COUNT], binMax[MXM_BVH_BIN_COUNT];
+    uint32_t binCount[MXM_BVH_BIN_COUNT];
+    for (int b = 0; b < MXM_BVH_BIN_COUNT; ++b) {
+      binMin[b] = XMVectorReplicate(FLT_MAX);
+      binMax[b] = XMVectorReplicate(-FLT_MAX);
+      binCount[b] = 0;
+    }
+
+    MXMBVHBINPREDICATE predicate;
+    predicate.pCentroids = pCentroids;
+    predicate.axis = axis;
+    predicate.centroidMin = (&cMin.x)[axis];
+    predicate.binScale = (float)MXM_BVH_BIN_COUNT * (1.0f - 1e-6f) / axisExtent;
+    for (uint32_t i = first; i < first + count; ++i) {
+      const uint32_t p = prims[i];
+      int32_t bin = (int32_t)(((&pCentroids[p].x)[axis] - predicate.centroidMin) * predicate.binScale);
+      bin = bin < 0 ? 0 : (bin >= MXM_BVH_BIN_COUNT ? MXM_BVH_BIN_COUNT - 1 : bin);
+      binMin[bin] = XMVectorMin(binMin[bin], pMin[p]);
+      binMax[bin] = XMVectorMax(binMax[bin], pMax[p]);
+      ++binCount[bin];
+    }
+
+    // sweep from the right, then from the left evaluating every split
+    float rightArea[MXM_BVH_BIN_COUNT];
+    uint32_t rightCount[MXM_BVH_BIN_COUNT];
+    XMVECTOR accMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR accMax = XMVectorReplicate(-FLT_MAX);
+    uint32_t acc = 0;
+    for (int b = MXM_BVH_BIN_COUNT - 1; b > 0; --b) {
+      accMin = XMVectorMin(accMin, binMin[b]);
+      accMax = XMVectorMax(accMax, binMax[b]);
+      acc += binCount[b];
+      rightArea[b] = MXMBVHSurfaceArea(accMin, accMax);
+      rightCount[b] = acc;
+    }
+
+    float bestCost = FLT_MAX;
+    uint32_t bestSplit = 0;
+    accMin = XMVectorReplicate(FLT_MAX);
+    accMax = XMVectorReplicate(-FLT_MAX);
+    acc = 0;
+    for (int b = 1; b < MXM_BVH_BIN_COUNT; ++b) {
+      accMin = XMVectorMin(accMin, binMin[b - 1]);
+      accMax = XMVectorMax(accMax, binMax[b - 1]);
+      acc += binCount[b - 1];
+      if (acc == 0 || rightCount[b] == 0)
+        continue;
+      float cost = acc * MXMBVHSurfaceArea(accMin, accMax) + rightCount[b] * rightArea[b];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestSplit = (uint32_t)b;
+      }
+    }
+
+    const float area = MXMBVHSurfaceArea(boundsMin, boundsMax);
+    const float leafCost = (float)count * area;
+    bestCost = settings.traversalCost * area + bestCost;
+    if (count <= settings.maxLeafSize && (bestSplit == 0 || leafCost <= bestCost))
+      return MakeLeaf(first, count, boundsMin, boundsMax);
+
+    uint32_t leftCount = count / 2;
+    if (bestSplit != 0) {
+      predicate.splitBin = bestSplit;
+      leftCount = (uint32_t)(std::partition(prims.begin() + first, prims.begin() + first + count, predicate) -
+                             (prims.begin() + first));
+    }
+    return Split(first, count, leftCount, boundsMin, boundsMax, depth);
+  }
+
+  uint32_t Split(uint32_t first, uint32_t count, uint32_t leftCount, FXMVECTOR boundsMin, FXMVECTOR boundsMax,
+                 uint32_t depth) {
+    MXMBVHBINARYNODE node;
+    node.boundsMin = boundsMin;
+    node.boundsMax = boundsMax;
+    node.first = first;
+    node.count = 0;
+    nodes.push_back(node);
+    const uint32_t index = (uint32_t)nodes.size() - 1;
+
+    const uint32_t left = Build(first, leftCount, depth + 1);
+    const uint32_t right = Build(first + leftCount, count - leftCount, depth + 1);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+  }
+
+  // Collapses the binary subtree below a node into four wide nodes, appended
+  // to bvh.nodes parents first. Returns the index of the new node.
+  uint32_t Collapse(MXMBVH &bvh, uint32_t binaryIndex) {
+    uint32_t children[4];
+    uint32_t childCount = 0;
+    if (nodes[binaryIndex].left == MXM_BVH_EMPTY) {
+      children[childCount++] = binaryIndex;
+    } else {
+      children[childCount++] = nodes[binaryIndex].left;
+      children[childCount++] = nodes[binaryIndex].right;
+    }
+
+    // open the inner child with the largest surface area until four children
+    while (childCount < 4) {
+      int best = -1;
+      float bestArea = -1.0f;
+      for (uint32_t c = 0; c < childCount; ++c) {
+        const MXMBVHBINARYNODE &n = nodes[children[c]];
+        if (n.left == MXM_BVH_EMPTY)
+          continue;
+        float area = MXMBVHSurfaceArea(n.boundsMin, n.boundsMax);
+        if (area > bestArea) {
+          bestArea = area;
+          best = (int)c;
+        }
+      }
+      if (best < 0)
+        break;
+      const MXMBVHBINARYNODE &n = nodes[children[best]];
+      children[childCount++] = n.right;
+      children[best] = n.left;
+    }
+
+    const uint32_t index = (uint32_t)bvh.nodes.size();
+    bvh.nodes.push_back(MXMBVHNODE());
+    for (uint32_t c = 0; c < 4; ++c) {
+      MXMBVHNODE &node = bvh.nodes[index];
+      if (c >= childCount) {
+        node.minX[c] = node.minY[c] = node.minZ[c] = FLT_MAX;
+        node.maxX[c] = node.maxY[c] = node.maxZ[c] = -FLT_MAX;
+        node.child[c] = MXM_BVH_EMPTY;
+        node.count[c] = 0;
+        continue;
+      }
+
+      const MXMBVHBINARYNODE &n = nodes[children[c]];
+      node.minX[c] = n.boundsMin.x; node.minY[c] = n.boundsMin.y; node.minZ[c] = n.boundsMin.z;
+      node.maxX[c] = n.boundsMax.x; node.maxY[c] = n.boundsMax.y; node.maxZ[c] = n.boundsMax.z;
+      if (n.left == MXM_BVH_EMPTY) {
+        node.child[c] = n.first;
+        node.count[c] = n.count;
+      } else {
+        const uint32_t childIndex = Collapse(bvh, children[c]);
+        bvh.nodes[index].child[c] = childIndex;
+        bvh.nodes[index].count[c] = 0;
+      }
+    }
+    return index;
+  }
+};
+
+// State of a BVH build split into tasks. The primitive bounds have to stay
+// valid until MXMBVHBuildEnd.
+struct MXMBVHBUILD
+{
+  MXMBVH *pBVH;
+  const MXMFLOAT3 *pMin, *pMax;
+  MXMBVHBUILDSETTINGS settings;
+  std::vector<MXMFLOAT3> centroids;
+  std::vector<MXMBVHBINARYNODE> nodes; // binary nodes above the tasks
+  uint32_t root;
+  std::vector<MXMBVHBUILDTASK> tasks;
+
+  MXMBVHBUILD() : pBVH(NULL), pMin(NULL), pMax(NULL), root(MXM_BVH_EMPTY) {}
+
+  size_t TaskCount() const { return tasks.size(); }
+};
+
+// Starts a build from primitive bounds: computes the centroids of the
+// primitives [first, first + count) and makes the top level splits until
+// every remaining range holds at most count / taskCount primitives. Each of
+// these ranges becomes a task for MXMBVHBuildSubtree.
+inline void MXMBVHBuildBegin(MXMBVHBUILD &build, MXMBVH &bvh, _In_reads_(count) const MXMFLOAT3 *pMin,
+                             _In_reads_(count) const MXMFLOAT3 *pMax, size_t count, size_t taskCount,
+                             const MXMBVHBUILDSETTINGS &settings = MXMBVHBUILDSETTINGS())
+{
+  build.pBVH = &bvh;
+  build.pMin = pMin;
+  build.pMax = pMax;
+  build.settings = settings;
+  build.settings.maxLeafSize = settings.maxLeafSize ? settings.maxLeafSize : 1;
+  build.nodes.clear();
+  build.tasks.clear();
+  build.root = MXM_BVH_EMPTY;
+
+  bvh.nodes.clear();
+  bvh.primitives.resize(count);
+  // an empty BVH has no nodes, all queries return right away
+  if (!count)
+    return;
+
+  for (size_t i = 0; i < count; ++i)
+    bvh.primitives[i] = (uint32_t)i;
+
+  build.centroids.resize(count);
+  const XMVECTOR half = XMVectorReplicate(0.5f);
+  for (size_t i = 0; i < count; ++i)
+    build.centroids[i] = XMVectorMultiply(XMVectorAdd(pMin[i], pMax[i]), half);
+
+  MXMBVHBUILDER builder;
+  builder.pMin = pMin;
+  builder.pMax = pMax;
+  builder.pCentroids = &build.centroids[0];
+  builder.settings = build.settings;
+  builder.pPrimitives = &bvh.primitives;
+  builder.pTasks = &build.tasks;
+  builder.taskSize = (uint32_t)(taskCount > 1 ? count / taskCount : count);
+  if (!builder.taskSize)
+    builder.taskSize = 1;
+
+  build.root = builder.Build(0, (uint32_t)count, 0);
+  build.nodes.swap(builder.nodes);
+}
+
+// Builds the subtree of one task. Different tasks may be built concurrently.
+inline void MXMBVHBuildSubtree(MXMBVHBUILD &build, size_t task)
+{
+  MXMBVHBUILDTASK &t = build.tasks[task];
+  MXMBVHBUILDER builder;
+  builder.pMin = build.pMin;
+  builder.pMax = build.pMax;
+  builder.pCentroids = &build.centroids[0];
+  builder.settings = build.settings;
+  builder.pPrimitives = &build.pBVH->primitives;
+  builder.nodes.reserve(t.count * 2);
+
+  t.root = builder.Build(t.first, t.count, t.depth);
+  t.nodes.swap(builder.nodes);
+}
+
+// Stitches the subtrees of all tasks below the top level splits and collapses
+// the binary tree into the nodes of the BVH.
+inline void MXMBVHBuildEnd(MXMBVHBUILD &build)
+{
+  if (build.root == MXM_BVH_EMPTY)
+    return;
+
+  MXMBVHBUILDER builder;
+  builder.nodes.swap(build.nodes);
+  for (size_t i = 0; i < build.tasks.size(); ++i) {
+    MXMBVHBUILDTASK &task = build.tasks[i];
+    const uint32_t offset = (uint32_t)builder.nodes.size();
+    for (size_t n = 0; n < task.nodes.size(); ++n) {
+      MXMBVHBINARYNODE node = task.nodes[n];
+      if (node.left != MXM_BVH_EMPTY) {
+        node.left += offset;
+        node.right += offset;
+      }
+      builder.nodes.push_back(node);
+    }
+    builder.nodes[task.node] = builder.nodes[offset + task.root];
+    std::vector<MXMBVHBINARYNODE>().swap(task.nodes);
+  }
+  builder.Collapse(*build.pBVH, build.root);
+  build.tasks.clear();
+}
+
+// Builds the BVH from primitive bounds on the calling thread. Used by the
+// triangle and box builders.
+inline void MXMBVHBuild(MXMBVH &bvh, _In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                        size_t count, const MXMBVHBUILDSETTINGS &settings)
+{
+  MXMBVHBUILD build;
+  MXMBVHBuildBegin(build, bvh, pMin, pMax, count, 1, settings);
+  for (size_t t = 0; t < build.TaskCount(); ++t)
+    MXMBVHBuildSubtree(build, t);
+  MXMBVHBuildEnd(build);
+}
+
+__MXM_INLINE void XM_CALLCONV MXMBVHTriangleBounds(_In_reads_(3) const MXMFLOAT3 *pTriangle, XMVECTOR &boundsMin, XMVECTOR &boundsMax)
+{
+  XMVECTOR v0 = pTriangle[0];
+  XMVECTOR v1 = pTriangle[1];
+  XMVECTOR v2 = pTriangle[2];
+  boundsMin = XMVectorMin(XMVectorMin(v0, v1), v2);
+  boundsMax = XMVectorMax(XMVectorMax(v0, v1), v2);
+}
+
+// Builds a BVH over triangleCount triangles with three vertices each.
+inline void MXMBVHBuildTriangles(MXMBVH &bvh, _In_reads_(triangleCount * 3) const MXMFLOAT3 *pVertices, size_t triangleCount,
+                                 const MXMBVHBUILDSETTINGS &settings = MXMBVHBUILDSETTINGS())
+{
+  std::vector<MXMFLOAT3> boundsMin(triangleCount), boundsMax(triangleCount);
+  for (size_t i = 0; i < triangleCount; ++i) {
+    XMVECTOR bMin, bMax;
+    MXMBVHTriangleBounds(pVertices + i * 3, bMin, bMax);
+    boundsMin[i] = bMin;
+    boundsMax[i] = bMax;
+  }
+  MXMBVHBuild(bvh, triangleCount ? &boundsMin[0] : NULL, triangleCount ? &boundsMax[0] : NULL, triangleCount, settings);
+}
+
+inline void MXMBVHBuildBoxes(MXMBVH &bvh, _In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                             size_t count, const MXMBVHBUILDSETTINGS &settings = MXMBVHBUILDSETTINGS())
+{
+  MXMBVHBuild(bvh, pMin, pMax, count, settings);
+}
+
+//------------------------------------------------------------------------------
+// Refit
+
+// Recomputes the bounds of all nodes bottom up. primitiveBounds is called as
+// primitiveBounds(index, min, max) for every primitive in a leaf.
+template<typename BoundsFunc>
+inline void MXMBVHRefit(MXMBVH &bvh, const BoundsFunc &primitiveBounds)
+{
+  for (size_t n = bvh.nodes.size(); n-- > 0;) {
+    MXMBVHNODE &node = bvh.nodes[n];
+    for (int c = 0; c < 4; ++c) {
+      if (node.child[c] == MXM_BVH_EMPTY)
+        continue;
+
+      XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+      XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+      if (node.count[c]) {
+        for (uint32_t i = node.child[c]; i < node.child[c] + node.count[c]; ++i) {
+          XMVECTOR pMin, pMax;
+          primitiveBounds(bvh.primitives[i], pMin, pMax);
+          boundsMin = XMVectorMin(boundsMin, pMin);
+          boundsMax = XMVectorMax(boundsMax, pMax);
+        }
+      } else {
+        // children are stored after their parents and are already refitted
+        const MXMBVHNODE &child = bvh.nodes[node.child[c]];
+        XMMATRIX mins(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.minX)),
+                      XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.minY)),
+                      XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.minZ)), XMVectorZero());
+        XMMATRIX maxs(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.maxX)),
+                      XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.maxY)),
+                      XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(child.maxZ)), XMVectorZero());
+        mins = XMMatrixTranspose(mins);
+        maxs = XMMatrixTranspose(maxs);
+        boundsMin = XMVectorMin(XMVectorMin(mins.r[0], mins.r[1]), XMVectorMin(mins.r[2], mins.r[3]));
+        boundsMax = XMVectorMax(XMVectorMax(maxs.r[0], maxs.r[1]), XMVectorMax(maxs.r[2], maxs.r[3]));
+      }
+
+      XMFLOAT3 bMin, bMax;
+      XMStoreFloat3(&bMin, boundsMin);
+      XMStoreFloat3(&bMax, boundsMax);
+      node.minX[c] = bMin.x; node.minY[c] = bMin.y; node.minZ[c] = bMin.z;
+      node.maxX[c] = bMax.x; node.maxY[c] = bMax.y; node.maxZ[c] = bMax.z;
+    }
+  }
+}
+
+struct MXMBVHTRIANGLEBOUNDS
+{
+  const MXMFLOAT3 *pVertices;
+  void operator()(uint32_t index, XMVECTOR &boundsMin, XMVECTOR &boundsMax) const {
+    MXMBVHTriangleBounds(pVertices + index * 3, boundsMin, boundsMax);
+  }
+};
+
+struct MXMBVHBOXBOUNDS
+{
+  const MXMFLOAT3 *pMin, *pMax;
+  void operator()(uint32_t index, XMVECTOR &boundsMin, XMVECTOR &boundsMax) const {
+    boundsMin = pMin[index];
+    boundsMax = pMax[index];
+  }
+};
+
+inline void MXMBVHRefitTriangles(MXMBVH &bvh, _In_ const MXMFLOAT3 *pVertices)
+{
+  MXMBVHTRIANGLEBOUNDS bounds = { pVertices };
+  MXMBVHRefit(bvh, bounds);
+}
+
+inline void MXMBVHRefitBoxes(MXMBVH &bvh, _In_ const MXMFLOAT3 *pMin, _In_ const MXMFLOAT3 *pMax)
+{
+  MXMBVHBOXBOUNDS bounds = { pMin, pMax };
+  MXMBVHRefit(bvh, bounds);
+}
+
+//------------------------------------------------------------------------------
+// Ray queries
+
+// Slab test of one ray against the four children of a node. Returns the mask
+// of the children hit before tMax and their entry distances in tNear.
+__MXM_INLINE uint32_t XM_CALLCONV MXMBVHIntersectNode(const MXMBVHNODE &node,
+                                                      FXMVECTOR originX, FXMVECTOR originY, FXMVECTOR originZ,
+                                                      GXMVECTOR invDirX, HXMVECTOR invDirY, HXMVECTOR invDirZ,
+                                                      float tMax, XMVECTOR &tNear)
+{
+  XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minX)), originX), invDirX);
+  XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxX)), originX), invDirX);
+  XMVECTOR tN = XMVectorMin(t0, t1);
+  XMVECTOR tF = XMVectorMax(t0, t1);
+
+  t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minY)), originY), invDirY);
+  t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxY)), originY), invDirY);
+  tN = XMVectorMax(tN, XMVectorMin(t0, t1));
+  tF = XMVectorMin(tF, XMVectorMax(t0, t1));
+
+  t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minZ)), originZ), invDirZ);
+  t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxZ)), originZ), invDirZ);
+  tN = XMVectorMax(tN, XMVectorMin(t0, t1));
+  tF = XMVectorMin(tF, XMVectorMax(t0, t1));
+
+  tN = XMVectorMax(tN, XMVectorZero());
+  tF = XMVectorMin(tF, XMVectorReplicate(tMax));
+  tNear = tN;
+
+  // unused children have inverted bounds, which the slab test does not reject
+  XMVECTOR used = XMVectorNotEqualInt(XMLoadInt4(node.child), XMVectorReplicateInt(MXM_BVH_EMPTY));
+  return MXMVectorMoveMask(XMVectorAndInt(XMVectorLessOrEqual(tN, tF), used));
+}
+
+// Closest hit of a ray with the triangles of a BVH built by
+// MXMBVHBuildTriangles. Returns false if nothing is hit before tMax.
+inline bool XM_CALLCONV MXMBVHIntersectRay(const MXMBVH &bvh, _In_ const MXMFLOAT3 *pVertices,
+                                           FXMVECTOR origin, FXMVECTOR direction, float tMax,
+                                           float &hitT, uint32_t &hitTriangle, bool anyHit = false)
+{
+  if (bvh.nodes.empty())
+    return false;
+
+  const XMVECTOR invDir = XMVectorReciprocal(direction);
+  const XMVECTOR ox = XMVectorSplatX(origin), oy = XMVectorSplatY(origin), oz = XMVectorSplatZ(origin);
+  const XMVECTOR ix = XMVectorSplatX(invDir), iy = XMVectorSplatY(invDir), iz = XMVectorSplatZ(invDir);
+
+  bool hit = false;
+  uint32_t stack[MXM_BVH_STACK_SIZE];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize) {
+    const MXMBVHNODE &node = bvh.nodes[stack[--stackSize]];
+    XMVECTOR tNear;
+    uint32_t mask = MXMBVHIntersectNode(node, ox, oy, oz, ix, iy, iz, tMax, tNear);
+    if (!mask)
+      continue;
+
+    float distance[4];
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(distance), tNear);
+
+    // leaves right away, inner children pushed far to near
+    uint32_t inner[4];
+    uint32_t innerCount = 0;
+    for (uint32_t c = 0; c < 4; ++c) {
+      if (!(mask & (1u << c)))
+        continue;
+      if (!node.count[c]) {
+        uint32_t k = innerCount++;
+        for (; k > 0 && distance[inner[k - 1]] < distance[c]; --k)
+          inner[k] = inner[k - 1];
+        inner[k] = c;
+        continue;
+      }
+      for (uint32_t i = node.child[c]; i < node.child[c] + node.count[c]; ++i) {
+        const uint32_t triangle = bvh.primitives[i];
+        const MXMFLOAT3 *v = pVertices + triangle * 3;
+        float t;
+        if (MXMRayIntersectTriangle(origin, direction, v[0], v[1], v[2], t) && t < tMax) {
+          tMax = t;
+          hitT = t;
+          hitTriangle = triangle;
+          hit = true;
+          if (anyHit)
+            return true;
+        }
+      }
+    }
+    for (uint32_t k = 0; k < innerCount; ++k)
+      stack[stackSize++] = node.child[inner[k]];
+  }
+  return hit;
+}
+
+// Returns true if the ray hits any triangle before tMax.
+inline bool XM_CALLCONV MXMBVHIntersectRayAny(const MXMBVH &bvh, _In_ const MXMFLOAT3 *pVertices,
+                                              FXMVECTOR origin, FXMVECTOR direction, float tMax)
+{
+  float t;
+  uint32_t triangle;
+  return MXMBVHIntersectRay(bvh, pVertices, origin, direction, tMax, t, triangle, true);
+}
+
+// Closest hits of a packet of four rays. A node is visited once for all rays
+// of the packet that enter it and leaf triangles are tested against the whole
+// packet. packet.tMax holds the hit distances afterwards, pHitTriangles
+// MXM_BVH_EMPTY for rays without a hit.
+inline void MXMBVHIntersectPacket(const MXMBVH &bvh, _In_ const MXMFLOAT3 *pVertices,
+                                  MXMRAYPACKET4 &packet, _Out_writes_(4) uint32_t *pHitTriangles)
+{
+  XMVECTOR hitTriangles = XMVectorReplicateInt(MXM_BVH_EMPTY);
+  if (bvh.nodes.empty()) {
+    XMStoreInt4(pHitTriangles, hitTriangles);
+    return;
+  }
+
+  uint32_t stack[MXM_BVH_STACK_SIZE];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize) {
+    const MXMBVHNODE &node = bvh.nodes[stack[--stackSize]];
+    for (uint32_t c = 0; c < 4; ++c) {
+      if (node.child[c] == MXM_BVH_EMPTY)
+        continue;
+
+      XMVECTOR boxMin = XMVectorSet(node.minX[c], node.minY[c], node.minZ[c], 0.0f);
+      XMVECTOR boxMax = XMVectorSet(node.maxX[c], node.maxY[c], node.maxZ[c], 0.0f);
+      if (!MXMVectorMoveMask(MXMRayPacketIntersectBox(packet, boxMin, boxMax)))
+        continue;
+
+      if (!node.count[c]) {
+        stack[stackSize++] = node.child[c];
+        continue;
+      }
+
+      // rays missing the leaf box cannot hit its triangles, no need to mask them
+      for (uint32_t i = node.child[c]; i < node.child[c] + node.count[c]; ++i) {
+        const uint32_t triangle = bvh.primitives[i];
+        const MXMFLOAT3 *v = pVertices + triangle * 3;
+        MXMRAYTRIANGLE4 prepared;
+        MXMRayTriangleLoad(prepared, v[0], v[1], v[2]);
+        MXMRayPacketClosestHit(packet, prepared, triangle, hitTriangles);
+      }
+    }
+  }
+  XMStoreInt4(pHitTriangles, hitTriangles);
+}
+
+//------------------------------------------------------------------------------
+// Box queries
+
+// Appends the indices of all primitives whose bounds overlap the box.
+inline void XM_CALLCONV MXMBVHQueryBox(const MXMBVH &bvh, FXMVECTOR boxMin, FXMVECTOR boxMax,
+                                       std::vector<uint32_t> &results)
+{
+  if (bvh.nodes.empty())
+    return;
+
+  const XMVECTOR qMinX = XMVectorSplatX(boxMin), qMinY = XMVectorSplatY(boxMin), qMinZ = XMVectorSplatZ(boxMin);
+  const XMVECTOR qMaxX = XMVectorSplatX(boxMax), qMaxY = XMVectorSplatY(boxMax), qMaxZ = XMVectorSplatZ(boxMax);
+
+  uint32_t stack[MXM_BVH_STACK_SIZE];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize) {
+    const MXMBVHNODE &node = bvh.nodes[stack[--stackSize]];
+    XMVECTOR overlap = XMVectorAndInt(XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minX)), qMaxX),
+                                      XMVectorGreaterOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxX)), qMinX));
+    overlap = XMVectorAndInt(overlap, XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minY)), qMaxY));
+    overlap = XMVectorAndInt(overlap, XMVectorGreaterOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxY)), qMinY));
+    overlap = XMVectorAndInt(overlap, XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.minZ)), qMaxZ));
+    overlap = XMVectorAndInt(overlap, XMVectorGreaterOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(node.maxZ)), qMinZ));
+    uint32_t mask = MXMVectorMoveMask(overlap);
+
+    for (uint32_t c = 0; c < 4; ++c) {
+      if (!(mask & (1u << c)))
+        continue;
+      if (node.count[c]) {
+        for (uint32_t i = node.child[c]; i < node.child[c] + node.count[c]; ++i)
+          results.push_back(bvh.primitives[i]);
+      } else {
+        stack[stackSize++] = node.child[c];
+      }
+    }
+  }
+}
+
+} //namespace DirectX
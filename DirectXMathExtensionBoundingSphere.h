@@ -0,0 +1,197 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Bounding spheres of many small point clusters, e.g. the vertices of the
+  meshlets of a mesh, written as MXMFLOAT4 (center xyz, radius w).
+
+  The spheres are built like EPOS-14 (Larsson, "Fast and Tight Fitting
+  Bounding Spheres"): the extremal points of every cluster along seven
+  directions (three axes and four diagonals) are searched for four points at
+  a time, the most distant pair of them gives the initial sphere. It is then
+  grown Ritter-style, but instead of one sequential pass over all points
+  every pass searches the farthest point with SIMD and grows the sphere to
+  contain it, until no point is outside. Two or three passes are typical.
+
+  Clusters are spans of a shared point array: cluster i covers the points
+  [pSpanFirst[i], pSpanFirst[i] + pSpanCount[i]). Like the culling functions,
+  the batch function works on a range of clusters; ranges can be processed
+  from different threads since every cluster writes only its own sphere.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMFLOAT4 sphere = MXMComputeBoundingSphere(&vertices[0], vertexCount);
+
+    // one sphere per meshlet
+    MXMComputeBoundingSpheres(&vertices[0], &meshletFirst[0], &meshletCount[0],
+                              0, meshletCount, &spheres[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <float.h>
+#include <math.h>
+
+namespace DirectX
+{
+
+#define MXM_BOUNDING_SPHERE_DIRECTIONS 7
+
+//------------------------------------------------------------------------------
+// Kernels
+
+// Loads points [i, i + 4) as SoA and their indices as integer lanes, which
+// stay exact for any count below 2^32. Points past the end are replaced by the
+// last point.
+__MXM_INLINE void MXMBoundingSphereLoad4(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count, size_t i,
+                                         XMVECTOR &x, XMVECTOR &y, XMVECTOR &z, XMVECTOR &index)
+{
+  if (i + 4 <= count) {
+    MXMLoadFloat3SoA(pPoints + i, x, y, z);
+    index = XMVectorSetInt((uint32_t)i, (uint32_t)(i + 1), (uint32_t)(i + 2), (uint32_t)(i + 3));
+  }
+  else {
+    MXMFLOAT3 tail[4];
+    uint32_t tailIndex[4];
+    for (size_t k = 0; k < 4; ++k) {
+      const size_t j = i + k < count ? i + k : count - 1;
+      tail[k] = pPoints[j];
+      tailIndex[k] = (uint32_t)j;
+    }
+    MXMLoadFloat3SoA(tail, x, y, z);
+    index = XMLoadInt4(tailIndex);
+  }
+}
+
+// Index of the lane holding the largest value, lanes with equal values
+// resolve to the first one.
+__MXM_INLINE size_t XM_CALLCONV MXMBoundingSphereMaxLane(FXMVECTOR values, FXMVECTOR indices)
+{
+  XMFLOAT4 v;
+  uint32_t i[4];
+  XMStoreFloat4(&v, values);
+  XMStoreInt4(i, indices);
+  float best = v.x;
+  uint32_t bestIndex = i[0];
+  if (v.y > best) { best = v.y; bestIndex = i[1]; }
+  if (v.z > best) { best = v.z; bestIndex = i[2]; }
+  if (v.w > best) { best = v.w; bestIndex = i[3]; }
+  return bestIndex;
+}
+
+// Initial sphere through the most distant pair of the extremal points along
+// the EPOS-14 directions.
+inline XMVECTOR MXMBoundingSphereExtremal(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count)
+{
+  // projections onto x, y, z, (1,1,1), (1,1,-1), (1,-1,1), (1,-1,-1);
+  // minima are tracked as maxima of the negated projections
+  XMVECTOR maxValue[2 * MXM_BOUNDING_SPHERE_DIRECTIONS], maxIndex[2 * MXM_BOUNDING_SPHERE_DIRECTIONS];
+  for (int d = 0; d < 2 * MXM_BOUNDING_SPHERE_DIRECTIONS; ++d) {
+    maxValue[d] = XMVectorReplicate(-FLT_MAX);
+    maxIndex[d] = XMVectorZero();
+  }
+
+  for (size_t i = 0; i < count; i += 4) {
+    XMVECTOR x, y, z, index;
+    MXMBoundingSphereLoad4(pPoints, count, i, x, y, z, index);
+
+    const XMVECTOR xy = XMVectorAdd(x, y);
+    const XMVECTOR xny = XMVectorSubtract(x, y);
+    XMVECTOR projection[MXM_BOUNDING_SPHERE_DIRECTIONS];
+    projection[0] = x;
+    projection[1] = y;
+    projection[2] = z;
+    projection[3] = XMVectorAdd(xy, z);
+    projection[4] = XMVectorSubtract(xy, z);
+    projection[5] = XMVectorAdd(xny, z);
+    projection[6] = XMVectorSubtract(xny, z);
+
+    for (int d = 0; d < MXM_BOUNDING_SPHERE_DIRECTIONS; ++d) {
+      const XMVECTOR negated = XMVectorNegate(projection[d]);
+      const XMVECTOR greater = XMVectorGreater(projection[d], maxValue[2 * d]);
+      const XMVECTOR less = XMVectorGreater(negated, maxValue[2 * d + 1]);
+      maxValue[2 * d] = XMVectorSelect(maxValue[2 * d], projection[d], greater);
+      maxIndex[2 * d] = XMVectorSelect(maxIndex[2 * d], index, greater);
+      maxValue[2 * d + 1] = XMVectorSelect(maxValue[2 * d + 1], negated, less);
+      maxIndex[2 * d + 1] = XMVectorSelect(maxIndex[2 * d + 1], index, less);
+    }
+  }
+
+  XMVECTOR a = pPoints[0], b = a;
+  float bestDistanceSq = -1.0f;
+  for (int d = 0; d < MXM_BOUNDING_SPHERE_DIRECTIONS; ++d) {
+    const XMVECTOR pMax = pPoints[MXMBoundingSphereMaxLane(maxValue[2 * d], maxIndex[2 * d])];
+    const XMVECTOR pMin = pPoints[MXMBoundingSphereMaxLane(maxValue[2 * d + 1], maxIndex[2 * d + 1])];
+    const float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(pMax, pMin)));
+    if (distanceSq > bestDistanceSq) {
+      bestDistanceSq = distanceSq;
+      a = pMin;
+      b = pMax;
+    }
+  }
+
+  const XMVECTOR center = XMVectorMultiply(XMVectorAdd(a, b), XMVectorReplicate(0.5f));
+  return XMVectorSetW(center, 0.5f * sqrtf(bestDistanceSq));
+}
+
+// Grows a sphere (center xyz, radius w) until it contains all points.
+inline XMVECTOR XM_CALLCONV MXMBoundingSphereGrow(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count, FXMVECTOR initialSphere)
+{
+  XMVECTOR sphere = initialSphere;
+  for (;;) {
+    const XMVECTOR cx = XMVectorSplatX(sphere);
+    const XMVECTOR cy = XMVectorSplatY(sphere);
+    const XMVECTOR cz = XMVectorSplatZ(sphere);
+
+    XMVECTOR farDistanceSq = XMVectorReplicate(-1.0f), farIndex = XMVectorZero();
+    for (size_t i = 0; i < count; i += 4) {
+      XMVECTOR x, y, z, index;
+      MXMBoundingSphereLoad4(pPoints, count, i, x, y, z, index);
+      x = XMVectorSubtract(x, cx);
+      y = XMVectorSubtract(y, cy);
+      z = XMVectorSubtract(z, cz);
+      const XMVECTOR distanceSq = XMVectorMultiplyAdd(x, x, XMVectorMultiplyAdd(y, y, XMVectorMultiply(z, z)));
+      const XMVECTOR greater = XMVectorGreater(distanceSq, farDistanceSq);
+      farDistanceSq = XMVectorSelect(farDistanceSq, distanceSq, greater);
+      farIndex = XMVectorSelect(farIndex, index, greater);
+    }
+
+    // the farthest point is exactly at the new surface, only keep growing
+    // when it is outside by more than rounding errors
+    const XMVECTOR farPoint = pPoints[MXMBoundingSphereMaxLane(farDistanceSq, farIndex)];
+    const XMVECTOR offset = XMVectorSubtract(farPoint, sphere);
+    const float distance = XMVectorGetX(XMVector3Length(offset));
+    const float radius = XMVectorGetW(sphere);
+    if (distance <= radius * (1.0f + 1.0e-5f))
+      return XMVectorSetW(sphere, distance > radius ? distance : radius);
+
+    const float newRadius = 0.5f * (radius + distance);
+    const XMVECTOR center = XMVectorMultiplyAdd(offset, XMVectorReplicate((newRadius - radius) / distance), sphere);
+    sphere = XMVectorSetW(center, newRadius);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Spheres
+
+// Bounding sphere of count points, a zero sphere for no points.
+inline MXMFLOAT4 MXMComputeBoundingSphere(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count)
+{
+  if (!count)
+    return MXMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+  return MXMBoundingSphereGrow(pPoints, count, MXMBoundingSphereExtremal(pPoints, count));
+}
+
+// Bounding spheres of the clusters [first, first + count), written to
+// pSpheres[first, first + count).
+inline void MXMComputeBoundingSpheres(_In_ const MXMFLOAT3 *pPoints, _In_ const uint32_t *pSpanFirst, _In_ const uint32_t *pSpanCount,
+                                      size_t first, size_t count, _Out_ MXMFLOAT4 *pSpheres)
+{
+  for (size_t i = first; i < first + count; ++i)
+    pSpheres[i] = MXMComputeBoundingSphere(pPoints + pSpanFirst[i], pSpanCount[i]);
+}
+
+} //namespace DirectX
@@ -0,0 +1,433 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Position based dynamics (Mueller et al., "Position Based Dynamics") for
+  cloth and ropes with SoA storage.
+
+  MXMCLOTH holds the positions, previous positions and inverse masses of the
+  vertices in padded float arrays; a vertex with inverse mass zero is pinned.
+  Two kinds of constraints are supported:
+
+    MXMCLOTHDISTANCE keeps two vertices at their rest distance.
+
+    MXMCLOTHBENDING keeps vertex v at its rest distance from the center of
+    the triangle (b0, v, b1) (Kelager et al., "A Triangle Bending Constraint
+    Model for Position-Based Dynamics"), for consecutive vertices along rope
+    segments or rows and columns of cloth grids.
+
+  Constraints are colored greedily so no vertex is used twice in a color,
+  and every color is packed into batches of four solved with SIMD. Solving
+  is Gauss-Seidel across colors; batches of one color are independent and
+  can be solved concurrently. Empty lanes read a pinned dummy vertex past
+  the end of the arrays and are never written back, so concurrent batches
+  do not share any written vertex.
+
+  A step predicts positions with Verlet integration and then runs the given
+  number of solver iterations. Stiffness values are in [0, 1] per iteration.
+  DirectXMathExtensionClothBenchmark.cpp measures the iterations per second.
+
+//------------------------------------------------------------------------------
+// Example
+
+    std::vector<MXMCLOTHDISTANCE> distances;
+    MXMClothEdgesFromTriangles(&indices[0], triangleCount, 1.0f, distances);
+
+    MXMCLOTH cloth;
+    MXMClothInit(cloth, &positions[0], &inverseMasses[0], vertexCount);
+    MXMClothSetConstraints(cloth, &distances[0], distances.size(), &bendings[0], bendings.size());
+
+    // every frame
+    MXMClothStep(cloth, gravity, 0.99f, dt, 8);
+    MXMFLOAT3 p = MXMClothGetPosition(cloth, 0);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+namespace DirectX
+{
+
+// Rest lengths below zero are replaced by the distances of the initial positions.
+struct MXMCLOTHDISTANCE
+{
+  uint32_t a, b;
+  float restLength;
+  float stiffness;
+};
+
+struct MXMCLOTHBENDING
+{
+  uint32_t b0, v, b1;
+  float restLength;                  // distance of v from the triangle center
+  float stiffness;
+};
+
+struct MXMCLOTHDISTANCEBATCH
+{
+  uint32_t a[4], b[4];
+  float restLength[4];
+  float stiffness[4];
+  uint32_t lanes;                    // used lanes, the others point to the dummy vertex
+};
+
+struct MXMCLOTHBENDINGBATCH
+{
+  uint32_t b0[4], v[4], b1[4];
+  float restLength[4];
+  float stiffness[4];
+  uint32_t lanes;
+};
+
+struct MXMCLOTH
+{
+  std::vector<float> x, y, z;        // positions
+  std::vector<float> px, py, pz;     // previous positions
+  std::vector<float> inverseMass;
+  size_t count;                      // arrays hold count vertices, padding and a dummy vertex
+
+  std::vector<MXMCLOTHDISTANCEBATCH> distanceBatches;
+  std::vector<uint32_t> distanceColorFirst; // batches of color c: [colorFirst[c], colorFirst[c + 1])
+  std::vector<MXMCLOTHBENDINGBATCH> bendingBatches;
+  std::vector<uint32_t> bendingColorFirst;
+
+  MXMCLOTH() : count(0) {}
+};
+
+//------------------------------------------------------------------------------
+// Setup
+
+inline void MXMClothInit(MXMCLOTH &cloth, _In_reads_(count) const MXMFLOAT3 *pPositions, _In_reads_(count) const float *pInverseMasses,
+                         size_t count)
+{
+  const size_t padded = (count + 4) & ~(size_t)3;
+  cloth.count = count;
+  cloth.x.assign(padded, 0.0f);
+  cloth.y.assign(padded, 0.0f);
+  cloth.z.assign(padded, 0.0f);
+  cloth.inverseMass.assign(padded, 0.0f);
+  for (size_t i = 0; i < count; ++i) {
+    cloth.x[i] = pPositions[i].x;
+    cloth.y[i] = pPositions[i].y;
+    cloth.z[i] = pPositions[i].z;
+    cloth.inverseMass[i] = pInverseMasses[i];
+  }
+  cloth.px = cloth.x;
+  cloth.py = cloth.y;
+  cloth.pz = cloth.z;
+  cloth.distanceBatches.clear();
+  cloth.distanceColorFirst.assign(1, 0);
+  cloth.bendingBatches.clear();
+  cloth.bendingColorFirst.assign(1, 0);
+}
+
+__MXM_INLINE MXMFLOAT3 MXMClothGetPosition(const MXMCLOTH &cloth, size_t i)
+{
+  return MXMFLOAT3(cloth.x[i], cloth.y[i], cloth.z[i]);
+}
+
+// Moves a vertex without giving it velocity, e.g. for pinned vertices.
+__MXM_INLINE void XM_CALLCONV MXMClothSetPosition(MXMCLOTH &cloth, size_t i, FXMVECTOR position)
+{
+  XMFLOAT3 p;
+  XMStoreFloat3(&p, position);
+  cloth.x[i] = cloth.px[i] = p.x;
+  cloth.y[i] = cloth.py[i] = p.y;
+  cloth.z[i] = cloth.pz[i] = p.z;
+}
+
+// Appends one distance constraint per unique edge of a triangle list.
+inline void MXMClothEdgesFromTriangles(_In_reads_(triangleCount * 3) const uint32_t *pIndices, size_t triangleCount, float stiffness,
+                                       std::vector<MXMCLOTHDISTANCE> &distances)
+{
+  std::vector<uint64_t> edges;
+  edges.reserve(triangleCount * 3);
+  for (size_t t = 0; t < triangleCount; ++t) {
+    for (int e = 0; e < 3; ++e) {
+      const uint32_t a = pIndices[3 * t + e], b = pIndices[3 * t + (e + 1) % 3];
+      edges.push_back(a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a);
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  for (size_t e = 0; e < edges.size(); ++e) {
+    MXMCLOTHDISTANCE distance = { (uint32_t)(edges[e] >> 32), (uint32_t)edges[e], -1.0f, stiffness };
+    distances.push_back(distance);
+  }
+}
+
+// Greedy coloring of constraints given by stride vertex indices each, 64
+// colors per round. Returns the number of colors.
+inline uint32_t MXMClothColor(_In_ const uint32_t *pVertices, size_t stride, size_t count, size_t vertexCount,
+                              _Out_writes_(count) uint32_t *pColors)
+{
+  std::vector<uint64_t> used(vertexCount);
+  std::vector<uint32_t> pending(count), next;
+  for (size_t i = 0; i < count; ++i)
+    pending[i] = (uint32_t)i;
+
+  uint32_t colorCount = 0;
+  for (uint32_t round = 0; !pending.empty(); ++round) {
+    std::fill(used.begin(), used.end(), 0);
+    next.clear();
+    for (size_t p = 0; p < pending.size(); ++p) {
+      const uint32_t *vertices = pVertices + pending[p] * stride;
+      uint64_t mask = 0;
+      for (size_t k = 0; k < stride; ++k)
+        mask |= used[vertices[k]];
+      if (mask == ~(uint64_t)0) {
+        next.push_back(pending[p]);
+        continue;
+      }
+      uint32_t color = 0;
+      while (mask & ((uint64_t)1 << color))
+        ++color;
+      for (size_t k = 0; k < stride; ++k)
+        used[vertices[k]] |= (uint64_t)1 << color;
+      pColors[pending[p]] = round * 64 + color;
+      colorCount = std::max(colorCount, round * 64 + color + 1);
+    }
+    pending.swap(next);
+  }
+  return colorCount;
+}
+
+// Stable order of count constraints by color, returns the first constraint
+// of every color in colorStart.
+inline void MXMClothColorOrder(_In_reads_(count) const uint32_t *pColors, size_t count, uint32_t colorCount,
+                               std::vector<uint32_t> &colorStart, std::vector<uint32_t> &order)
+{
+  colorStart.assign(colorCount + 1, 0);
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    ++colorStart[pColors[i] + 1];
+  for (uint32_t c = 0; c < colorCount; ++c)
+    colorStart[c + 1] += colorStart[c];
+  std::vector<uint32_t> offset(colorStart.begin(), colorStart.end() - 1);
+  for (size_t i = 0; i < count; ++i)
+    order[offset[pColors[i]]++] = (uint32_t)i;
+}
+
+// Colors and batches the constraints, rest lengths below zero are taken
+// from the current positions.
+inline void MXMClothSetConstraints(MXMCLOTH &cloth, _In_reads_(distanceCount) const MXMCLOTHDISTANCE *pDistances, size_t distanceCount,
+                                   _In_reads_(bendingCount) const MXMCLOTHBENDING *pBendings, size_t bendingCount)
+{
+  const uint32_t dummy = (uint32_t)cloth.count;
+  std::vector<uint32_t> vertices, colors, colorStart, order;
+
+  // distances
+  vertices.resize(distanceCount * 2);
+  for (size_t i = 0; i < distanceCount; ++i) {
+    vertices[2 * i] = pDistances[i].a;
+    vertices[2 * i + 1] = pDistances[i].b;
+  }
+  colors.resize(distanceCount);
+  uint32_t colorCount = MXMClothColor(distanceCount ? &vertices[0] : NULL, 2, distanceCount, cloth.count, distanceCount ? &colors[0] : NULL);
+  MXMClothColorOrder(distanceCount ? &colors[0] : NULL, distanceCount, colorCount, colorStart, order);
+
+  cloth.distanceBatches.clear();
+  cloth.distanceColorFirst.assign(1, 0);
+  for (uint32_t c = 0; c < colorCount; ++c) {
+    for (uint32_t i = colorStart[c]; i < colorStart[c + 1]; i += 4) {
+      MXMCLOTHDISTANCEBATCH batch;
+      batch.lanes = colorStart[c + 1] - i < 4 ? colorStart[c + 1] - i : 4;
+      for (uint32_t k = 0; k < 4; ++k) {
+        batch.a[k] = batch.b[k] = dummy;
+        batch.restLength[k] = batch.stiffness[k] = 0.0f;
+        if (i + k >= colorStart[c + 1])
+          continue;
+        const MXMCLOTHDISTANCE &d = pDistances[order[i + k]];
+        batch.a[k] = d.a;
+        batch.b[k] = d.b;
+        batch.stiffness[k] = d.stiffness;
+        batch.restLength[k] = d.restLength >= 0.0f ? d.restLength :
+          XMVectorGetX(XMVector3Length(XMVectorSubtract(MXMClothGetPosition(cloth, d.a), MXMClothGetPosition(cloth, d.b))));
+      }
+      cloth.distanceBatches.push_back(batch);
+    }
+    cloth.distanceColorFirst.push_back((uint32_t)cloth.distanceBatches.size());
+  }
+
+  // bending
+  vertices.resize(bendingCount * 3);
+  for (size_t i = 0; i < bendingCount; ++i) {
+    vertices[3 * i] = pBendings[i].b0;
+    vertices[3 * i + 1] = pBendings[i].v;
+    vertices[3 * i + 2] = pBendings[i].b1;
+  }
+  colors.resize(bendingCount);
+  colorCount = MXMClothColor(bendingCount ? &vertices[0] : NULL, 3, bendingCount, cloth.count, bendingCount ? &colors[0] : NULL);
+  MXMClothColorOrder(bendingCount ? &colors[0] : NULL, bendingCount, colorCount, colorStart, order);
+
+  cloth.bendingBatches.clear();
+  cloth.bendingColorFirst.assign(1, 0);
+  for (uint32_t c = 0; c < colorCount; ++c) {
+    for (uint32_t i = colorStart[c]; i < colorStart[c + 1]; i += 4) {
+      MXMCLOTHBENDINGBATCH batch;
+      batch.lanes = colorStart[c + 1] - i < 4 ? colorStart[c + 1] - i : 4;
+      for (uint32_t k = 0; k < 4; ++k) {
+        batch.b0[k] = batch.v[k] = batch.b1[k] = dummy;
+        batch.restLength[k] = batch.stiffness[k] = 0.0f;
+        if (i + k >= colorStart[c + 1])
+          continue;
+        const MXMCLOTHBENDING &b = pBendings[order[i + k]];
+        batch.b0[k] = b.b0;
+        batch.v[k] = b.v;
+        batch.b1[k] = b.b1;
+        batch.stiffness[k] = b.stiffness;
+        if (b.restLength >= 0.0f) {
+          batch.restLength[k] = b.restLength;
+        }
+        else {
+          const XMVECTOR v = MXMClothGetPosition(cloth, b.v);
+          const XMVECTOR center = XMVectorScale(XMVectorAdd(XMVectorAdd(MXMClothGetPosition(cloth, b.b0), v), MXMClothGetPosition(cloth, b.b1)), 1.0f / 3.0f);
+          batch.restLength[k] = XMVectorGetX(XMVector3Length(XMVectorSubtract(v, center)));
+        }
+      }
+      cloth.bendingBatches.push_back(batch);
+    }
+    cloth.bendingColorFirst.push_back((uint32_t)cloth.bendingBatches.size());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Gather and scatter
+
+__MXM_INLINE XMVECTOR MXMClothGather(_In_ const float *pArray, _In_reads_(4) const uint32_t *pIndices)
+{
+  return XMVectorSet(pArray[pIndices[0]], pArray[pIndices[1]], pArray[pIndices[2]], pArray[pIndices[3]]);
+}
+
+// Writes the first lanes lanes of v.
+__MXM_INLINE void XM_CALLCONV MXMClothScatter(_Out_ float *pArray, _In_reads_(lanes) const uint32_t *pIndices, FXMVECTOR v,
+                                              uint32_t lanes)
+{
+  float values[4];
+  XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(values), v);
+  for (uint32_t k = 0; k < lanes; ++k)
+    pArray[pIndices[k]] = values[k];
+}
+
+//------------------------------------------------------------------------------
+// Solver
+
+// Verlet prediction of the vertices [first, first + count), pinned vertices
+// stay in place. first has to be a multiple of four.
+inline void XM_CALLCONV MXMClothPredict(MXMCLOTH &cloth, size_t first, size_t count, FXMVECTOR gravity, float damping, float dt)
+{
+  const XMVECTOR d = XMVectorReplicate(damping);
+  const XMVECTOR g = XMVectorScale(gravity, dt * dt);
+  const XMVECTOR g3[3] = { XMVectorSplatX(g), XMVectorSplatY(g), XMVectorSplatZ(g) };
+  float *position[3] = { &cloth.x[0], &cloth.y[0], &cloth.z[0] };
+  float *previous[3] = { &cloth.px[0], &cloth.py[0], &cloth.pz[0] };
+
+  for (size_t i = first; i < first + count; i += 4) {
+    const XMVECTOR pinned = XMVectorEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&cloth.inverseMass[i])), XMVectorZero());
+    for (int a = 0; a < 3; ++a) {
+      const XMVECTOR p = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(position[a] + i));
+      const XMVECTOR step = XMVectorMultiplyAdd(XMVectorSubtract(p, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(previous[a] + i))), d, g3[a]);
+      XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(previous[a] + i), p);
+      XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(position[a] + i), XMVectorSelect(XMVectorAdd(p, step), p, pinned));
+    }
+  }
+}
+
+// Projects the distance batches [first, first + count).
+inline void MXMClothSolveDistances(MXMCLOTH &cloth, size_t first, size_t count)
+{
+  for (size_t i = first; i < first + count; ++i) {
+    const MXMCLOTHDISTANCEBATCH &batch = cloth.distanceBatches[i];
+    const XMVECTOR wa = MXMClothGather(&cloth.inverseMass[0], batch.a);
+    const XMVECTOR wb = MXMClothGather(&cloth.inverseMass[0], batch.b);
+    XMVECTOR ax = MXMClothGather(&cloth.x[0], batch.a), ay = MXMClothGather(&cloth.y[0], batch.a), az = MXMClothGather(&cloth.z[0], batch.a);
+    XMVECTOR bx = MXMClothGather(&cloth.x[0], batch.b), by = MXMClothGather(&cloth.y[0], batch.b), bz = MXMClothGather(&cloth.z[0], batch.b);
+
+    const XMVECTOR dx = XMVectorSubtract(ax, bx), dy = XMVectorSubtract(ay, by), dz = XMVectorSubtract(az, bz);
+    const XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+    const XMVECTOR denominator = XMVectorMultiply(XMVectorAdd(wa, wb), length);
+
+    // s = stiffness * (|d| - rest) / ((wa + wb) * |d|)
+    XMVECTOR s = XMVectorSubtract(length, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.restLength)));
+    s = XMVectorDivide(XMVectorMultiply(s, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.stiffness))), denominator);
+    s = XMVectorSelect(s, XMVectorZero(), XMVectorEqual(denominator, XMVectorZero()));
+
+    const XMVECTOR sa = XMVectorMultiply(s, wa), sb = XMVectorMultiply(s, wb);
+    ax = XMVectorNegativeMultiplySubtract(sa, dx, ax);
+    ay = XMVectorNegativeMultiplySubtract(sa, dy, ay);
+    az = XMVectorNegativeMultiplySubtract(sa, dz, az);
+    bx = XMVectorMultiplyAdd(sb, dx, bx);
+    by = XMVectorMultiplyAdd(sb, dy, by);
+    bz = XMVectorMultiplyAdd(sb, dz, bz);
+
+    MXMClothScatter(&cloth.x[0], batch.a, ax, batch.lanes);
+    MXMClothScatter(&cloth.y[0], batch.a, ay, batch.lanes);
+    MXMClothScatter(&cloth.z[0], batch.a, az, batch.lanes);
+    MXMClothScatter(&cloth.x[0], batch.b, bx, batch.lanes);
+    MXMClothScatter(&cloth.y[0], batch.b, by, batch.lanes);
+    MXMClothScatter(&cloth.z[0], batch.b, bz, batch.lanes);
+  }
+}
+
+// Projects the bending batches [first, first + count).
+inline void MXMClothSolveBendings(MXMCLOTH &cloth, size_t first, size_t count)
+{
+  const XMVECTOR third = XMVectorReplicate(1.0f / 3.0f);
+  const XMVECTOR two = XMVectorReplicate(2.0f);
+  float *position[3] = { &cloth.x[0], &cloth.y[0], &cloth.z[0] };
+
+  for (size_t i = first; i < first + count; ++i) {
+    const MXMCLOTHBENDINGBATCH &batch = cloth.bendingBatches[i];
+    const XMVECTOR w0 = MXMClothGather(&cloth.inverseMass[0], batch.b0);
+    const XMVECTOR wv = MXMClothGather(&cloth.inverseMass[0], batch.v);
+    const XMVECTOR w1 = MXMClothGather(&cloth.inverseMass[0], batch.b1);
+
+    XMVECTOR b0[3], v[3], b1[3], h[3];
+    for (int a = 0; a < 3; ++a) {
+      b0[a] = MXMClothGather(position[a], batch.b0);
+      v[a] = MXMClothGather(position[a], batch.v);
+      b1[a] = MXMClothGather(position[a], batch.b1);
+      h[a] = XMVectorSubtract(v[a], XMVectorMultiply(XMVectorAdd(XMVectorAdd(b0[a], v[a]), b1[a]), third));
+    }
+    const XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(h[0], h[0], XMVectorMultiplyAdd(h[1], h[1], XMVectorMultiply(h[2], h[2]))));
+    const XMVECTOR weight = XMVectorMultiplyAdd(wv, two, XMVectorAdd(w0, w1));
+    const XMVECTOR denominator = XMVectorMultiply(weight, length);
+
+    // s = stiffness * (|h| - rest) / (W * |h|), b0 and b1 move by 2 w s h, v by -4 w s h
+    XMVECTOR s = XMVectorSubtract(length, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.restLength)));
+    s = XMVectorDivide(XMVectorMultiply(s, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.stiffness))), denominator);
+    s = XMVectorSelect(XMVectorMultiply(s, two), XMVectorZero(), XMVectorEqual(denominator, XMVectorZero()));
+    const XMVECTOR s0 = XMVectorMultiply(s, w0), s1 = XMVectorMultiply(s, w1), sv = XMVectorMultiply(XMVectorMultiply(s, wv), two);
+
+    for (int a = 0; a < 3; ++a) {
+      MXMClothScatter(position[a], batch.b0, XMVectorMultiplyAdd(s0, h[a], b0[a]), batch.lanes);
+      MXMClothScatter(position[a], batch.b1, XMVectorMultiplyAdd(s1, h[a], b1[a]), batch.lanes);
+      MXMClothScatter(position[a], batch.v, XMVectorNegativeMultiplySubtract(sv, h[a], v[a]), batch.lanes);
+    }
+  }
+}
+
+// iterations Gauss-Seidel sweeps over the colors of all constraints.
+inline void MXMClothIterate(MXMCLOTH &cloth, uint32_t iterations)
+{
+  for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+    for (size_t c = 0; c + 1 < cloth.distanceColorFirst.size(); ++c)
+      MXMClothSolveDistances(cloth, cloth.distanceColorFirst[c], cloth.distanceColorFirst[c + 1] - cloth.distanceColorFirst[c]);
+    for (size_t c = 0; c + 1 < cloth.bendingColorFirst.size(); ++c)
+      MXMClothSolveBendings(cloth, cloth.bendingColorFirst[c], cloth.bendingColorFirst[c + 1] - cloth.bendingColorFirst[c]);
+  }
+}
+
+inline void XM_CALLCONV MXMClothStep(MXMCLOTH &cloth, FXMVECTOR gravity, float damping, float dt, uint32_t iterations)
+{
+  MXMClothPredict(cloth, 0, cloth.count, gravity, damping, dt);
+  MXMClothIterate(cloth, iterations);
+}
+
+} //namespace DirectX
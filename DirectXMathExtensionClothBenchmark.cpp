@@ -0,0 +1,90 @@
+/*------------------------------------------------------------------------------
+// INFO
+
+  Minimal timing program for DirectXMathExtensionCloth.h.
+
+  Builds a cloth grid of size x size vertices with a distance constraint per
+  triangle edge and bending constraints along the rows and columns, then
+  measures the solver iterations per second of MXMClothIterate on one thread.
+
+  Build with optimizations, e.g.
+    g++ -O2 -msse2 DirectXMathExtensionClothBenchmark.cpp
+  and run with an optional grid size (default 64).
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionCloth.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace DirectX;
+
+int main(int argc, char **argv)
+{
+  const uint32_t size = argc > 1 ? (uint32_t)atoi(argv[1]) : 64;
+  if (size < 3) {
+    printf("grid size has to be at least 3\n");
+    return 1;
+  }
+
+  // grid in the xz plane, pinned at two corners
+  std::vector<MXMFLOAT3> positions;
+  std::vector<float> inverseMasses;
+  std::vector<uint32_t> indices;
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      positions.push_back(MXMFLOAT3(x * 0.1f, 0.0f, y * 0.1f));
+      inverseMasses.push_back(y == 0 && (x == 0 || x == size - 1) ? 0.0f : 1.0f);
+    }
+  }
+  for (uint32_t y = 0; y + 1 < size; ++y) {
+    for (uint32_t x = 0; x + 1 < size; ++x) {
+      const uint32_t a = y * size + x, b = a + 1, c = a + size, d = c + 1;
+      const uint32_t quad[6] = { a, b, c, b, d, c };
+      indices.insert(indices.end(), quad, quad + 6);
+    }
+  }
+
+  std::vector<MXMCLOTHDISTANCE> distances;
+  MXMClothEdgesFromTriangles(&indices[0], indices.size() / 3, 1.0f, distances);
+
+  std::vector<MXMCLOTHBENDING> bendings;
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x + 2 < size; ++x) {
+      const MXMCLOTHBENDING row = { y * size + x, y * size + x + 1, y * size + x + 2, -1.0f, 0.5f };
+      const MXMCLOTHBENDING column = { x * size + y, (x + 1) * size + y, (x + 2) * size + y, -1.0f, 0.5f };
+      bendings.push_back(row);
+      bendings.push_back(column);
+    }
+  }
+
+  MXMCLOTH cloth;
+  MXMClothInit(cloth, &positions[0], &inverseMasses[0], positions.size());
+  MXMClothSetConstraints(cloth, &distances[0], distances.size(), &bendings[0], bendings.size());
+
+  // let the cloth sag first, so the constraints are not already satisfied
+  for (int step = 0; step < 30; ++step)
+    MXMClothStep(cloth, XMVectorSet(0.0f, -9.81f, 0.0f, 0.0f), 0.99f, 1.0f / 60.0f, 4);
+
+  // doubles the iteration count until the measurement takes a quarter second
+  uint32_t iterations = 16;
+  double seconds = 0.0;
+  for (;;) {
+    const clock_t start = clock();
+    MXMClothIterate(cloth, iterations);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (seconds >= 0.25 || iterations >= (1u << 30))
+      break;
+    iterations *= 2;
+  }
+
+  const double constraints = (double)(distances.size() + bendings.size());
+  printf("%u vertices, %u distance and %u bending constraints in %u + %u colors\n",
+         (unsigned)positions.size(), (unsigned)distances.size(), (unsigned)bendings.size(),
+         (unsigned)(cloth.distanceColorFirst.size() - 1), (unsigned)(cloth.bendingColorFirst.size() - 1));
+  printf("%.0f iterations/s, %.1f M constraint projections/s\n",
+         iterations / seconds, iterations * constraints / seconds * 1.0e-6);
+  return 0;
+}
@@ -0,0 +1,320 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Projected Gauss-Seidel solver for velocity constraints between rigid bodies
+  of DirectXMathExtensionRigidBody.h, four constraints per SIMD iteration.
+
+  Every MXMCONSTRAINT is one row of the Jacobian: a linear and an angular
+  part for each of its two bodies, a bias (the target velocity is -bias) and
+  limits for the accumulated impulse, e.g. [0, FLT_MAX] for contacts. A body
+  index of MXM_CONSTRAINT_NO_BODY stands for the static world.
+
+  MXMConstraintSolverPrepare colors the constraints greedily so that no body
+  is used twice by constraints of the same color, and packs every color into
+  batches of four. A batch holds Jacobians, inverse mass weighted Jacobians,
+  effective masses and limits in SoA layout. Solving a batch gathers the
+  velocities of its bodies from the MXM arrays, updates four constraints at
+  once and scatters the velocities back; batches of one color never touch
+  the same body and can be solved in any order or concurrently.
+
+  The accumulated impulses of the last solve can be stored into the
+  constraints and used to warm start the next step.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMRigidBodyIntegrateVelocities(bodies, 0, bodyCount, &forces[0], NULL, gravity, 1.0f, 1.0f, dt);
+
+    MXMCONSTRAINTSOLVER solver;
+    MXMConstraintSolverPrepare(solver, &constraints[0], constraintCount, bodies, bodyCount);
+    MXMConstraintSolverWarmStart(solver, bodies);
+    MXMConstraintSolverIterate(solver, bodies, 8);
+    MXMConstraintSolverStoreImpulses(solver, &constraints[0]);
+
+    MXMRigidBodyIntegratePositions(bodies, 0, bodyCount, dt, &transforms[0]);
+
+    // parallel: for every iteration and color c, distribute the batches
+    // [solver.colorFirst[c], solver.colorFirst[c + 1]) over threads
+    MXMConstraintSolveBatches(solver, bodies, firstBatch, batchCount);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionRigidBody.h"
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+namespace DirectX
+{
+
+#define MXM_CONSTRAINT_NO_BODY 0xFFFFFFFFu
+
+struct MXMCONSTRAINT
+{
+  uint32_t bodyA;
+  uint32_t bodyB;
+  MXMFLOAT3 linearA;                 // e.g. the contact normal n
+  MXMFLOAT3 angularA;                // e.g. rA x n
+  MXMFLOAT3 linearB;                 // e.g. -n
+  MXMFLOAT3 angularB;                // e.g. -(rB x n)
+  float bias;
+  float lower;                       // limits of the accumulated impulse
+  float upper;
+  float impulse;                     // accumulated impulse, for warm starting
+};
+
+// Four constraints in SoA layout, rows of 12 are linear A, angular A,
+// linear B and angular B (xyz each).
+struct MXMCONSTRAINTBATCH
+{
+  uint32_t constraint[4];            // MXM_CONSTRAINT_NO_BODY for empty lanes
+  uint32_t bodyA[4];
+  uint32_t bodyB[4];
+  float jacobian[12][4];
+  float response[12][4];             // inverse mass matrix times jacobian
+  float effectiveMass[4];
+  float bias[4];
+  float lower[4];
+  float upper[4];
+  float impulse[4];
+};
+
+struct MXMCONSTRAINTSOLVER
+{
+  std::vector<MXMCONSTRAINTBATCH> batches;
+  std::vector<uint32_t> colorFirst;  // batches of color c: [colorFirst[c], colorFirst[c + 1])
+};
+
+//------------------------------------------------------------------------------
+// Preparation
+
+// Greedy coloring with 64 colors per round, constraints that do not fit are
+// colored in further rounds. Returns the number of colors.
+inline uint32_t MXMConstraintColor(_In_reads_(count) const MXMCONSTRAINT *pConstraints, size_t count, size_t bodyCount,
+                                   _Out_writes_(count) uint32_t *pColors)
+{
+  std::vector<uint64_t> used(bodyCount);
+  std::vector<uint32_t> pending(count), next;
+  for (size_t i = 0; i < count; ++i)
+    pending[i] = (uint32_t)i;
+
+  uint32_t colorCount = 0;
+  for (uint32_t round = 0; !pending.empty(); ++round) {
+    std::fill(used.begin(), used.end(), 0);
+    next.clear();
+    for (size_t p = 0; p < pending.size(); ++p) {
+      const MXMCONSTRAINT &c = pConstraints[pending[p]];
+      uint64_t mask = 0;
+      if (c.bodyA != MXM_CONSTRAINT_NO_BODY)
+        mask |= used[c.bodyA];
+      if (c.bodyB != MXM_CONSTRAINT_NO_BODY)
+        mask |= used[c.bodyB];
+      if (mask == ~(uint64_t)0) {
+        next.push_back(pending[p]);
+        continue;
+      }
+      uint32_t color = 0;
+      while (mask & ((uint64_t)1 << color))
+        ++color;
+      if (c.bodyA != MXM_CONSTRAINT_NO_BODY)
+        used[c.bodyA] |= (uint64_t)1 << color;
+      if (c.bodyB != MXM_CONSTRAINT_NO_BODY)
+        used[c.bodyB] |= (uint64_t)1 << color;
+      pColors[pending[p]] = round * 64 + color;
+      colorCount = std::max(colorCount, round * 64 + color + 1);
+    }
+    pending.swap(next);
+  }
+  return colorCount;
+}
+
+// Colors and batches the constraints and computes their effective masses
+// from the inverse masses and world inverse inertias of the bodies.
+inline void MXMConstraintSolverPrepare(MXMCONSTRAINTSOLVER &solver, _In_reads_(count) const MXMCONSTRAINT *pConstraints, size_t count,
+                                       const MXMRIGIDBODIES &bodies, size_t bodyCount)
+{
+  solver.batches.clear();
+  solver.colorFirst.assign(1, 0);
+
+  std::vector<uint32_t> colors(count);
+  const uint32_t colorCount = MXMConstraintColor(pConstraints, count, bodyCount, count ? &colors[0] : NULL);
+
+  // counting sort by color, stable so the batches follow the input order
+  std::vector<uint32_t> colorStart(colorCount + 1, 0), order(count);
+  for (size_t i = 0; i < count; ++i)
+    ++colorStart[colors[i] + 1];
+  for (uint32_t c = 0; c < colorCount; ++c)
+    colorStart[c + 1] += colorStart[c];
+  std::vector<uint32_t> offset(colorStart.begin(), colorStart.end() - 1);
+  for (size_t i = 0; i < count; ++i)
+    order[offset[colors[i]]++] = (uint32_t)i;
+
+  for (uint32_t c = 0; c < colorCount; ++c) {
+    for (uint32_t i = colorStart[c]; i < colorStart[c + 1]; i += 4) {
+      MXMCONSTRAINTBATCH batch;
+      memset(&batch, 0, sizeof(batch));
+      for (uint32_t k = 0; k < 4; ++k) {
+        batch.constraint[k] = batch.bodyA[k] = batch.bodyB[k] = MXM_CONSTRAINT_NO_BODY;
+        if (i + k >= colorStart[c + 1])
+          continue;
+
+        const uint32_t index = order[i + k];
+        const MXMCONSTRAINT &constraint = pConstraints[index];
+        batch.constraint[k] = index;
+        batch.bodyA[k] = constraint.bodyA;
+        batch.bodyB[k] = constraint.bodyB;
+        batch.bias[k] = constraint.bias;
+        batch.lower[k] = constraint.lower;
+        batch.upper[k] = constraint.upper;
+        batch.impulse[k] = constraint.impulse;
+
+        const MXMFLOAT3 *rows[4] = { &constraint.linearA, &constraint.angularA, &constraint.linearB, &constraint.angularB };
+        const uint32_t bodyIndex[2] = { constraint.bodyA, constraint.bodyB };
+        float inverseEffectiveMass = 0.0f;
+        for (uint32_t b = 0; b < 2; ++b) {
+          const XMVECTOR linear = *rows[2 * b];
+          const XMVECTOR angular = *rows[2 * b + 1];
+          XMVECTOR linearResponse = XMVectorZero(), angularResponse = XMVectorZero();
+          if (bodyIndex[b] != MXM_CONSTRAINT_NO_BODY) {
+            linearResponse = XMVectorScale(linear, bodies.pInverseMasses[bodyIndex[b]]);
+            angularResponse = XMVector3TransformNormal(angular, bodies.pInverseWorldInertias[bodyIndex[b]]);
+          }
+          inverseEffectiveMass += XMVectorGetX(XMVector3Dot(linear, linearResponse)) + XMVectorGetX(XMVector3Dot(angular, angularResponse));
+
+          XMFLOAT3 values[4];
+          XMStoreFloat3(&values[0], linear);
+          XMStoreFloat3(&values[1], angular);
+          XMStoreFloat3(&values[2], linearResponse);
+          XMStoreFloat3(&values[3], angularResponse);
+          for (uint32_t a = 0; a < 3; ++a) {
+            batch.jacobian[6 * b + a][k] = (&values[0].x)[a];
+            batch.jacobian[6 * b + 3 + a][k] = (&values[1].x)[a];
+            batch.response[6 * b + a][k] = (&values[2].x)[a];
+            batch.response[6 * b + 3 + a][k] = (&values[3].x)[a];
+          }
+        }
+        batch.effectiveMass[k] = inverseEffectiveMass > 0.0f ? 1.0f / inverseEffectiveMass : 0.0f;
+      }
+      solver.batches.push_back(batch);
+    }
+    solver.colorFirst.push_back((uint32_t)solver.batches.size());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Solving
+
+// Loads the velocities of four bodies as SoA, zero for MXM_CONSTRAINT_NO_BODY.
+__MXM_INLINE void MXMConstraintGather(_In_ const MXMFLOAT3 *pVelocities, _In_reads_(4) const uint32_t *pBodies,
+                                      XMVECTOR &x, XMVECTOR &y, XMVECTOR &z)
+{
+  MXMFLOAT3 v[4];
+  for (int k = 0; k < 4; ++k)
+    v[k] = pBodies[k] != MXM_CONSTRAINT_NO_BODY ? pVelocities[pBodies[k]] : MXMFLOAT3(0.0f, 0.0f, 0.0f);
+  MXMLoadFloat3SoA(v, x, y, z);
+}
+
+__MXM_INLINE void XM_CALLCONV MXMConstraintScatter(_Out_ MXMFLOAT3 *pVelocities, _In_reads_(4) const uint32_t *pBodies,
+                                                   FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+  MXMFLOAT3 v[4];
+  MXMStoreFloat3SoA(v, x, y, z);
+  for (int k = 0; k < 4; ++k) {
+    if (pBodies[k] != MXM_CONSTRAINT_NO_BODY)
+      pVelocities[pBodies[k]] = v[k];
+  }
+}
+
+#define MXM_CONSTRAINT_ROW(array, row) XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.array[row]))
+
+// Adds response * impulse to the velocities of body b (0 = A, 1 = B).
+__MXM_INLINE void XM_CALLCONV MXMConstraintApply(const MXMCONSTRAINTBATCH &batch, int b, FXMVECTOR impulse, XMVECTOR *pVelocity)
+{
+  for (int r = 0; r < 6; ++r)
+    pVelocity[r] = XMVectorMultiplyAdd(MXM_CONSTRAINT_ROW(response, 6 * b + r), impulse, pVelocity[r]);
+}
+
+// Gathers linear and angular velocities of both bodies of a batch, 12 SoA rows.
+__MXM_INLINE void MXMConstraintGatherBatch(const MXMCONSTRAINTBATCH &batch, const MXMRIGIDBODIES &bodies, _Out_writes_(12) XMVECTOR *pVelocity)
+{
+  MXMConstraintGather(bodies.pLinearVelocities, batch.bodyA, pVelocity[0], pVelocity[1], pVelocity[2]);
+  MXMConstraintGather(bodies.pAngularVelocities, batch.bodyA, pVelocity[3], pVelocity[4], pVelocity[5]);
+  MXMConstraintGather(bodies.pLinearVelocities, batch.bodyB, pVelocity[6], pVelocity[7], pVelocity[8]);
+  MXMConstraintGather(bodies.pAngularVelocities, batch.bodyB, pVelocity[9], pVelocity[10], pVelocity[11]);
+}
+
+__MXM_INLINE void MXMConstraintScatterBatch(const MXMCONSTRAINTBATCH &batch, const MXMRIGIDBODIES &bodies, _In_reads_(12) const XMVECTOR *pVelocity)
+{
+  MXMConstraintScatter(bodies.pLinearVelocities, batch.bodyA, pVelocity[0], pVelocity[1], pVelocity[2]);
+  MXMConstraintScatter(bodies.pAngularVelocities, batch.bodyA, pVelocity[3], pVelocity[4], pVelocity[5]);
+  MXMConstraintScatter(bodies.pLinearVelocities, batch.bodyB, pVelocity[6], pVelocity[7], pVelocity[8]);
+  MXMConstraintScatter(bodies.pAngularVelocities, batch.bodyB, pVelocity[9], pVelocity[10], pVelocity[11]);
+}
+
+// One Gauss-Seidel update of the batches [first, first + count). The
+// batches must belong to one color when solved concurrently.
+inline void MXMConstraintSolveBatches(MXMCONSTRAINTSOLVER &solver, const MXMRIGIDBODIES &bodies, size_t first, size_t count)
+{
+  for (size_t i = first; i < first + count; ++i) {
+    MXMCONSTRAINTBATCH &batch = solver.batches[i];
+    XMVECTOR velocity[12];
+    MXMConstraintGatherBatch(batch, bodies, velocity);
+
+    // lambda = -effectiveMass * (J * v + bias), clamped on the accumulated impulse
+    XMVECTOR jv = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.bias));
+    for (int r = 0; r < 12; ++r)
+      jv = XMVectorMultiplyAdd(MXM_CONSTRAINT_ROW(jacobian, r), velocity[r], jv);
+    const XMVECTOR accumulated = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.impulse));
+    XMVECTOR impulse = XMVectorNegativeMultiplySubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.effectiveMass)), jv, accumulated);
+    impulse = XMVectorClamp(impulse, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.lower)),
+                            XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.upper)));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(batch.impulse), impulse);
+    const XMVECTOR delta = XMVectorSubtract(impulse, accumulated);
+
+    MXMConstraintApply(batch, 0, delta, velocity);
+    MXMConstraintApply(batch, 1, delta, velocity + 6);
+    MXMConstraintScatterBatch(batch, bodies, velocity);
+  }
+}
+
+// Applies the accumulated impulses of the constraints to the velocities.
+inline void MXMConstraintSolverWarmStart(MXMCONSTRAINTSOLVER &solver, const MXMRIGIDBODIES &bodies)
+{
+  for (size_t i = 0; i < solver.batches.size(); ++i) {
+    const MXMCONSTRAINTBATCH &batch = solver.batches[i];
+    XMVECTOR velocity[12];
+    MXMConstraintGatherBatch(batch, bodies, velocity);
+    const XMVECTOR impulse = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(batch.impulse));
+    MXMConstraintApply(batch, 0, impulse, velocity);
+    MXMConstraintApply(batch, 1, impulse, velocity + 6);
+    MXMConstraintScatterBatch(batch, bodies, velocity);
+  }
+}
+
+#undef MXM_CONSTRAINT_ROW
+
+// iterations Gauss-Seidel sweeps over all colors.
+inline void MXMConstraintSolverIterate(MXMCONSTRAINTSOLVER &solver, const MXMRIGIDBODIES &bodies, uint32_t iterations)
+{
+  for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+    for (size_t c = 0; c + 1 < solver.colorFirst.size(); ++c)
+      MXMConstraintSolveBatches(solver, bodies, solver.colorFirst[c], solver.colorFirst[c + 1] - solver.colorFirst[c]);
+  }
+}
+
+// Writes the accumulated impulses back to the constraints.
+inline void MXMConstraintSolverStoreImpulses(const MXMCONSTRAINTSOLVER &solver, _Out_ MXMCONSTRAINT *pConstraints)
+{
+  for (size_t i = 0; i < solver.batches.size(); ++i) {
+    const MXMCONSTRAINTBATCH &batch = solver.batches[i];
+    for (int k = 0; k < 4; ++k) {
+      if (batch.constraint[k] != MXM_CONSTRAINT_NO_BODY)
+        pConstraints[batch.constraint[k]].impulse = batch.impulse[k];
+    }
+  }
+}
+
+} //namespace DirectX
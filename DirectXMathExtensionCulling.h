@@ -0,0 +1,510 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Batch frustum culling of bounding spheres and axis aligned bounding boxes
+  stored in MXM arrays.
+
+  A frustum is given by six planes in MXMFLOAT4 (a, b, c, d with the normal
+  pointing inside), for example taken from BoundingFrustum::GetPlanes or built
+  with MXMFrustumPlanesFromMatrix. MXMCULLFRUSTUM keeps the planes splatted
+  into XMVECTORs so four objects are tested against one plane with a single
+  multiply-add chain. The batch functions test eight objects per iteration and
+  never branch on the result of a single object.
+
+  Spheres are given by an array of MXMFLOAT3 centers and an array of radii,
+  boxes by an array of MXMFLOAT3 minima and an array of MXMFLOAT3 maxima.
+
+  The results are either written as a bitmask (bit i set = object i visible)
+  or as a compacted list of visible indices. To cull in parallel, split the
+  objects into chunks whose first index is a multiple of 32 and cull every
+  chunk from its own thread: chunks then never share a mask word. Compacted
+  lists of several chunks are written to separate ranges and concatenated by
+  the caller.
+
+  MXMCULLCACHE adds a temporal coherent mode for spheres. It remembers the
+  plane which rejected every object last time and tests it first; a group of
+  four objects rejected by their remembered planes costs one plane test
+  instead of six. While the camera planes stay within cameraThreshold of the
+  planes of the last full test, objects whose sphere moved less than
+  objectThreshold keep their previous result without any plane test.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMFLOAT4 planes[6];
+    MXMFrustumPlanesFromMatrix(planes, view * projection);
+
+    MXMCULLFRUSTUM frustum(planes);
+    size_t visibleCount = MXMCullSpheres(frustum, centers, radii, 0, count, visibleIndices);
+
+    // temporal coherent culling, cache.visibleMask holds the result
+    MXMCULLCACHE cache(count);
+    // ... every frame: //
+    MXMCullCacheBeginFrame(cache, planes);
+    MXMCullSpheresCoherent(cache, centers, radii, 0, count);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Frustum
+
+// Extracts the normalized planes of a view-projection matrix (0 <= z <= w)
+// in the order near, far, left, right, top, bottom.
+__MXM_INLINE void XM_CALLCONV MXMFrustumPlanesFromMatrix(_Out_writes_(6) MXMFLOAT4 *pPlanes, FXMMATRIX viewProjection)
+{
+  XMMATRIX columns = XMMatrixTranspose(viewProjection);
+  pPlanes[0] = XMPlaneNormalize(columns.r[2]);
+  pPlanes[1] = XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[2]));
+  pPlanes[2] = XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[0]));
+  pPlanes[3] = XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[0]));
+  pPlanes[4] = XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[1]));
+  pPlanes[5] = XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[1]));
+}
+
+struct MXMCULLFRUSTUM
+{
+  XMVECTOR x[6], y[6], z[6], w[6];      // plane components, splatted
+  XMVECTOR absX[6], absY[6], absZ[6];   // absolute normal, splatted
+
+  __MXM_INLINE MXMCULLFRUSTUM() {}
+  __MXM_INLINE explicit MXMCULLFRUSTUM(_In_reads_(6) const MXMFLOAT4 *pPlanes) {
+    for (int i = 0; i < 6; ++i) {
+      XMVECTOR p = pPlanes[i];
+      x[i] = XMVectorSplatX(p);
+      y[i] = XMVectorSplatY(p);
+      z[i] = XMVectorSplatZ(p);
+      w[i] = XMVectorSplatW(p);
+      absX[i] = XMVectorAbs(x[i]);
+      absY[i] = XMVectorAbs(y[i]);
+      absZ[i] = XMVectorAbs(z[i]);
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+// 4 wide kernels
+
+// Signed distance of four points (SoA) to one plane of the frustum.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMCullPlaneDistance(const MXMCULLFRUSTUM &frustum, int plane,
+                                                       FXMVECTOR cx, FXMVECTOR cy, FXMVECTOR cz)
+{
+  XMVECTOR d = XMVectorMultiplyAdd(cx, frustum.x[plane], frustum.w[plane]);
+  d = XMVectorMultiplyAdd(cy, frustum.y[plane], d);
+  return XMVectorMultiplyAdd(cz, frustum.z[plane], d);
+}
+
+// Projected half size of four boxes (SoA extents) onto the normal of one plane.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMCullPlaneRadius(const MXMCULLFRUSTUM &frustum, int plane,
+                                                     FXMVECTOR ex, FXMVECTOR ey, FXMVECTOR ez)
+{
+  XMVECTOR r = XMVectorMultiply(ex, frustum.absX[plane]);
+  r = XMVectorMultiplyAdd(ey, frustum.absY[plane], r);
+  return XMVectorMultiplyAdd(ez, frustum.absZ[plane], r);
+}
+
+// Returns a 4 bit mask of the spheres intersecting or inside the frustum.
+__MXM_INLINE uint32_t XM_CALLCONV MXMTestSpheres4(const MXMCULLFRUSTUM &frustum,
+                                                  FXMVECTOR cx, FXMVECTOR cy, FXMVECTOR cz, GXMVECTOR radius)
+{
+  XMVECTOR visible = XMVectorTrueInt();
+  XMVECTOR negRadius = XMVectorNegate(radius);
+  for (int i = 0; i < 6; ++i) {
+    XMVECTOR d = MXMCullPlaneDistance(frustum, i, cx, cy, cz);
+    visible = XMVectorAndInt(visible, XMVectorGreaterOrEqual(d, negRadius));
+  }
+  return MXMVectorMoveMask(visible);
+}
+
+// Returns a 4 bit mask of the boxes (center and extents) intersecting or
+// inside the frustum.
+__MXM_INLINE uint32_t XM_CALLCONV MXMTestBoxes4(const MXMCULLFRUSTUM &frustum,
+                                                FXMVECTOR cx, FXMVECTOR cy, FXMVECTOR cz,
+                                                GXMVECTOR ex, HXMVECTOR ey, HXMVECTOR ez)
+{
+  XMVECTOR visible = XMVectorTrueInt();
+  for (int i = 0; i < 6; ++i) {
+    XMVECTOR d = MXMCullPlaneDistance(frustum, i, cx, cy, cz);
+    XMVECTOR r = MXMCullPlaneRadius(frustum, i, ex, ey, ez);
+    visible = XMVectorAndInt(visible, XMVectorGreaterOrEqual(XMVectorAdd(d, r), XMVectorZero()));
+  }
+  return MXMVectorMoveMask(visible);
+}
+
+//------------------------------------------------------------------------------
+// Loading groups of four objects
+
+__MXM_INLINE uint32_t XM_CALLCONV MXMCullSpheres4(const MXMCULLFRUSTUM &frustum,
+                                                  _In_reads_(4) const MXMFLOAT3 *pCenters, _In_reads_(4) const float *pRadii)
+{
+  XMVECTOR cx, cy, cz;
+  MXMLoadFloat3SoA(pCenters, cx, cy, cz);
+  return MXMTestSpheres4(frustum, cx, cy, cz, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pRadii)));
+}
+
+__MXM_INLINE uint32_t XM_CALLCONV MXMCullBoxes4(const MXMCULLFRUSTUM &frustum,
+                                                _In_reads_(4) const MXMFLOAT3 *pMin, _In_reads_(4) const MXMFLOAT3 *pMax)
+{
+  XMVECTOR minX, minY, minZ, maxX, maxY, maxZ;
+  MXMLoadFloat3SoA(pMin, minX, minY, minZ);
+  MXMLoadFloat3SoA(pMax, maxX, maxY, maxZ);
+
+  const XMVECTOR half = XMVectorReplicate(0.5f);
+  return MXMTestBoxes4(frustum,
+                       XMVectorMultiply(XMVectorAdd(minX, maxX), half),
+                       XMVectorMultiply(XMVectorAdd(minY, maxY), half),
+                       XMVectorMultiply(XMVectorAdd(minZ, maxZ), half),
+                       XMVectorMultiply(XMVectorSubtract(maxX, minX), half),
+                       XMVectorMultiply(XMVectorSubtract(maxY, minY), half),
+                       XMVectorMultiply(XMVectorSubtract(maxZ, minZ), half));
+}
+
+// Tests the last 1..3 objects of an array by padding them to a group of four.
+__MXM_INLINE uint32_t MXMCullSpheresTail(const MXMCULLFRUSTUM &frustum,
+                                         _In_reads_(count) const MXMFLOAT3 *pCenters, _In_reads_(count) const float *pRadii,
+                                         size_t count)
+{
+  MXMFLOAT3 centers[4];
+  float radii[4];
+  for (size_t i = 0; i < 4; ++i) {
+    centers[i] = pCenters[i < count ? i : 0];
+    radii[i] = pRadii[i < count ? i : 0];
+  }
+  return MXMCullSpheres4(frustum, centers, radii) & ((1u << count) - 1u);
+}
+
+__MXM_INLINE uint32_t MXMCullBoxesTail(const MXMCULLFRUSTUM &frustum,
+                                       _In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                                       size_t count)
+{
+  MXMFLOAT3 boxMin[4], boxMax[4];
+  for (size_t i = 0; i < 4; ++i) {
+    boxMin[i] = pMin[i < count ? i : 0];
+    boxMax[i] = pMax[i < count ? i : 0];
+  }
+  return MXMCullBoxes4(frustum, boxMin, boxMax) & ((1u << count) - 1u);
+}
+
+//------------------------------------------------------------------------------
+// Output helpers
+
+// Appends the indices of the set bits of a 4 bit mask without branching.
+__MXM_INLINE size_t MXMAppendIndices4(_Out_writes_(4) uint32_t *pIndices, uint32_t mask, uint32_t baseIndex)
+{
+  size_t n = 0;
+  pIndices[n] = baseIndex;     n += mask & 1;
+  pIndices[n] = baseIndex + 1; n += (mask >> 1) & 1;
+  pIndices[n] = baseIndex + 2; n += (mask >> 2) & 1;
+  pIndices[n] = baseIndex + 3; n += (mask >> 3) & 1;
+  return n;
+}
+
+// Converts the bits [first, first + count) of a mask into a list of indices.
+// Returns the number of indices written.
+inline size_t MXMMaskToIndices(_In_ const uint32_t *pMask, size_t first, size_t count,
+                               _Out_writes_(count) uint32_t *pIndices)
+{
+  size_t n = 0;
+  for (size_t i = first; i < first + count; ++i) {
+    pIndices[n] = (uint32_t)i;
+    n += (pMask[i >> 5] >> (i & 31)) & 1;
+  }
+  return n;
+}
+
+//------------------------------------------------------------------------------
+// Batch culling
+
+// Writes visibility bits for the spheres [first, first + count) into pMask.
+// first has to be a multiple of 32, bits past the end of the range in the
+// last mask word are cleared.
+inline void MXMCullSpheresMask(const MXMCULLFRUSTUM &frustum,
+                               _In_ const MXMFLOAT3 *pCenters, _In_ const float *pRadii,
+                               size_t first, size_t count, _Out_ uint32_t *pMask)
+{
+  const size_t end = first + count;
+  uint32_t *pWord = pMask + (first >> 5);
+  size_t i = first;
+  while (i < end) {
+    uint32_t word = 0;
+    const size_t wordEnd = (end - i) < 32 ? end : i + 32;
+    uint32_t shift = 0;
+    for (; i + 8 <= wordEnd; i += 8, shift += 8) {
+      uint32_t m0 = MXMCullSpheres4(frustum, pCenters + i, pRadii + i);
+      uint32_t m1 = MXMCullSpheres4(frustum, pCenters + i + 4, pRadii + i + 4);
+      word |= (m0 | (m1 << 4)) << shift;
+    }
+    for (; i + 4 <= wordEnd; i += 4, shift += 4)
+      word |= MXMCullSpheres4(frustum, pCenters + i, pRadii + i) << shift;
+    if (i < wordEnd) {
+      word |= MXMCullSpheresTail(frustum, pCenters + i, pRadii + i, wordEnd - i) << shift;
+      i = wordEnd;
+    }
+    *pWord++ = word;
+  }
+}
+
+// Writes the indices of the visible spheres in [first, first + count) to
+// pVisibleIndices and returns their number.
+inline size_t MXMCullSpheres(const MXMCULLFRUSTUM &frustum,
+                             _In_ const MXMFLOAT3 *pCenters, _In_ const float *pRadii,
+                             size_t first, size_t count, _Out_writes_(count) uint32_t *pVisibleIndices)
+{
+  const size_t end = first + count;
+  size_t n = 0;
+  size_t i = first;
+  for (; i + 8 <= end; i += 8) {
+    uint32_t m0 = MXMCullSpheres4(frustum, pCenters + i, pRadii + i);
+    uint32_t m1 = MXMCullSpheres4(frustum, pCenters + i + 4, pRadii + i + 4);
+    n += MXMAppendIndices4(pVisibleIndices + n, m0, (uint32_t)i);
+    n += MXMAppendIndices4(pVisibleIndices + n, m1, (uint32_t)i + 4);
+  }
+  for (; i + 4 <= end; i += 4)
+    n += MXMAppendIndices4(pVisibleIndices + n, MXMCullSpheres4(frustum, pCenters + i, pRadii + i), (uint32_t)i);
+  if (i < end) {
+    uint32_t indices[4];
+    size_t tail = MXMAppendIndices4(indices, MXMCullSpheresTail(frustum, pCenters + i, pRadii + i, end - i), (uint32_t)i);
+    for (size_t k = 0; k < tail; ++k)
+      pVisibleIndices[n++] = indices[k];
+  }
+  return n;
+}
+
+// Writes visibility bits for the boxes [first, first + count) into pMask.
+// first has to be a multiple of 32, bits past the end of the range in the
+// last mask word are cleared.
+inline void MXMCullBoxesMask(const MXMCULLFRUSTUM &frustum,
+                             _In_ const MXMFLOAT3 *pMin, _In_ const MXMFLOAT3 *pMax,
+                             size_t first, size_t count, _Out_ uint32_t *pMask)
+{
+  const size_t end = first + count;
+  uint32_t *pWord = pMask + (first >> 5);
+  size_t i = first;
+  while (i < end) {
+    uint32_t word = 0;
+    const size_t wordEnd = (end - i) < 32 ? end : i + 32;
+    uint32_t shift = 0;
+    for (; i + 8 <= wordEnd; i += 8, shift += 8) {
+      uint32_t m0 = MXMCullBoxes4(frustum, pMin + i, pMax + i);
+      uint32_t m1 = MXMCullBoxes4(frustum, pMin + i + 4, pMax + i + 4);
+      word |= (m0 | (m1 << 4)) << shift;
+    }
+    for (; i + 4 <= wordEnd; i += 4, shift += 4)
+      word |= MXMCullBoxes4(frustum, pMin + i, pMax + i) << shift;
+    if (i < wordEnd) {
+      word |= MXMCullBoxesTail(frustum, pMin + i, pMax + i, wordEnd - i) << shift;
+      i = wordEnd;
+    }
+    *pWord++ = word;
+  }
+}
+
+// Writes the indices of the visible boxes in [first, first + count) to
+// pVisibleIndices and returns their number.
+inline size_t MXMCullBoxes(const MXMCULLFRUSTUM &frustum,
+                           _In_ const MXMFLOAT3 *pMin, _In_ const MXMFLOAT3 *pMax,
+                           size_t first, size_t count, _Out_writes_(count) uint32_t *pVisibleIndices)
+{
+  const size_t end = first + count;
+  size_t n = 0;
+  size_t i = first;
+  for (; i + 8 <= end; i += 8) {
+    uint32_t m0 = MXMCullBoxes4(frustum, pMin + i, pMax + i);
+    uint32_t m1 = MXMCullBoxes4(frustum, pMin + i + 4, pMax + i + 4);
+    n += MXMAppendIndices4(pVisibleIndices + n, m0, (uint32_t)i);
+    n += MXMAppendIndices4(pVisibleIndices + n, m1, (uint32_t)i + 4);
+  }
+  for (; i + 4 <= end; i += 4)
+    n += MXMAppendIndices4(pVisibleIndices + n, MXMCullBoxes4(frustum, pMin + i, pMax + i), (uint32_t)i);
+  if (i < end) {
+    uint32_t indices[4];
+    size_t tail = MXMAppendIndices4(indices, MXMCullBoxesTail(frustum, pMin + i, pMax + i, end - i), (uint32_t)i);
+    for (size_t k = 0; k < tail; ++k)
+      pVisibleIndices[n++] = indices[k];
+  }
+  return n;
+}
+
+//------------------------------------------------------------------------------
+// Temporal coherent culling
+
+struct MXMCULLCACHE
+{
+  float cameraThreshold;              // allowed plane drift for reusing results
+  float objectThreshold;              // allowed sphere movement for reusing results
+
+  MXMFLOAT4 planes[6];                // planes of the current frame
+  MXMFLOAT4 referencePlanes[6];       // planes of the last full test
+  MXMCULLFRUSTUM frustum;             // current planes, splatted
+  bool referenceValid;                // referencePlanes have been set
+  bool cameraStill;                   // planes still close to referencePlanes
+
+  std::vector<MXMFLOAT4> bounds;      // sphere (center, radius) when last tested
+  std::vector<uint8_t>   rejectPlane; // plane which rejected the sphere last time
+  std::vector<uint32_t>  visibleMask; // result, one bit per sphere
+
+  MXMCULLCACHE() : cameraThreshold(0.001f), objectThreshold(0.001f), referenceValid(false), cameraStill(false) {}
+  explicit MXMCULLCACHE(size_t count)
+    : cameraThreshold(0.001f), objectThreshold(0.001f), referenceValid(false), cameraStill(false) {
+    Resize(count);
+  }
+
+  // Resizing invalidates all cached results.
+  void Resize(size_t count) {
+    bounds.assign(count, MXMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f));
+    rejectPlane.assign(count, 0);
+    visibleMask.assign((count + 31) / 32, 0);
+    referenceValid = false;
+    cameraStill = false;
+  }
+};
+
+// Sets the planes of the current frame. Has to be called once per frame
+// before any MXMCullSpheresCoherent call.
+inline void MXMCullCacheBeginFrame(MXMCULLCACHE &cache, _In_reads_(6) const MXMFLOAT4 *pPlanes)
+{
+  bool still = cache.referenceValid;
+  if (still) {
+    XMVECTOR threshold = XMVectorReplicate(cache.cameraThreshold);
+    XMVECTOR inside = XMVectorTrueInt();
+    for (int i = 0; i < 6; ++i) {
+      XMVECTOR delta = XMVectorAbs(XMVectorSubtract(pPlanes[i], cache.referencePlanes[i]));
+      inside = XMVectorAndInt(inside, XMVectorLessOrEqual(delta, threshold));
+    }
+    still = MXMVectorMoveMask(inside) == 0xF;
+  }
+
+  for (int i = 0; i < 6; ++i) {
+    cache.planes[i] = pPlanes[i];
+    if (!still)
+      cache.referencePlanes[i] = pPlanes[i];
+  }
+  cache.frustum = MXMCULLFRUSTUM(pPlanes);
+  cache.referenceValid = true;
+  cache.cameraStill = still;
+}
+
+// Tests a group of four spheres against their remembered planes and, if any
+// of them survives, against the whole frustum. Returns the 4 bit visibility
+// mask and adds the number of plane tests (per object) to planeTests.
+__MXM_INLINE uint32_t XM_CALLCONV MXMCullSpheres4Coherent(MXMCULLCACHE &cache,
+                                                          _In_reads_(4) const MXMFLOAT3 *pCenters, _In_reads_(4) const float *pRadii,
+                                                          _Inout_updates_(4) MXMFLOAT4 *pBounds, _Inout_updates_(4) uint8_t *pRejectPlane,
+                                                          uint32_t previousMask, size_t &planeTests)
+{
+  XMVECTOR cx, cy, cz;
+  MXMLoadFloat3SoA(pCenters, cx, cy, cz);
+  XMVECTOR radius = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pRadii));
+
+  // lanes which did not move enough to need a new test
+  uint32_t stillMask = 0;
+  if (cache.cameraStill) {
+    XMMATRIX cached = XMMatrixTranspose(XMMATRIX(pBounds[0], pBounds[1], pBounds[2], pBounds[3]));
+    XMVECTOR moved = XMVectorAdd(XMVectorAbs(XMVectorSubtract(cx, cached.r[0])),
+                                 XMVectorAbs(XMVectorSubtract(cy, cached.r[1])));
+    moved = XMVectorAdd(moved, XMVectorAbs(XMVectorSubtract(cz, cached.r[2])));
+    moved = XMVectorAdd(moved, XMVectorAbs(XMVectorSubtract(radius, cached.r[3])));
+    // bounds which were never tested are stored with a negative radius
+    XMVECTOR still = XMVectorAndInt(XMVectorLessOrEqual(moved, XMVectorReplicate(cache.objectThreshold)),
+                                    XMVectorGreaterOrEqual(cached.r[3], XMVectorZero()));
+    stillMask = MXMVectorMoveMask(still);
+    if (stillMask == 0xF)
+      return previousMask;
+  }
+
+  // remembered planes first, gathered per lane
+  XMMATRIX plane = XMMatrixTranspose(XMMATRIX(cache.planes[pRejectPlane[0]], cache.planes[pRejectPlane[1]],
+                                              cache.planes[pRejectPlane[2]], cache.planes[pRejectPlane[3]]));
+  XMVECTOR d = XMVectorMultiplyAdd(cx, plane.r[0], plane.r[3]);
+  d = XMVectorMultiplyAdd(cy, plane.r[1], d);
+  d = XMVectorMultiplyAdd(cz, plane.r[2], d);
+  uint32_t rejectedMask = MXMVectorMoveMask(XMVectorLess(d, XMVectorNegate(radius)));
+  planeTests += 4;
+
+  uint32_t mask;
+  if ((rejectedMask | stillMask) == 0xF) {
+    mask = 0;
+  } else {
+    XMVECTOR visible = XMVectorTrueInt();
+    XMVECTOR firstReject = XMVectorZero();
+    XMVECTOR negRadius = XMVectorNegate(radius);
+    for (uint32_t i = 0; i < 6; ++i) {
+      XMVECTOR outside = XMVectorLess(MXMCullPlaneDistance(cache.frustum, i, cx, cy, cz), negRadius);
+      firstReject = XMVectorSelect(firstReject, XMVectorReplicateInt(i), XMVectorAndInt(outside, visible));
+      visible = XMVectorAndCInt(visible, outside);
+    }
+    planeTests += 24;
+    mask = MXMVectorMoveMask(visible);
+
+    uint32_t planes[4];
+    XMStoreInt4(planes, firstReject);
+    for (int k = 0; k < 4; ++k) {
+      if (!(mask & (1u << k)))
+        pRejectPlane[k] = (uint8_t)planes[k];
+    }
+  }
+
+  // remember the bounds of every lane that was tested this time
+  for (int k = 0; k < 4; ++k) {
+    if (!(stillMask & (1u << k)))
+      pBounds[k] = MXMFLOAT4(pCenters[k].x, pCenters[k].y, pCenters[k].z, pRadii[k]);
+  }
+  return (mask & ~stillMask) | (previousMask & stillMask);
+}
+
+// Culls the spheres [first, first + count) using and updating the cache, the
+// result is written to cache.visibleMask. first has to be a multiple of 32.
+// Returns the number of plane tests done (summed over all objects).
+inline size_t MXMCullSpheresCoherent(MXMCULLCACHE &cache,
+                                     _In_ const MXMFLOAT3 *pCenters, _In_ const float *pRadii,
+                                     size_t first, size_t count)
+{
+  size_t planeTests = 0;
+  const size_t end = first + count;
+  for (size_t i = first; i < end; i += 32) {
+    const uint32_t previous = cache.visibleMask[i >> 5];
+    uint32_t word = 0;
+    const size_t wordEnd = (end - i) < 32 ? end : i + 32;
+    size_t j = i;
+    for (; j + 4 <= wordEnd; j += 4) {
+      const uint32_t shift = (uint32_t)(j - i);
+      word |= MXMCullSpheres4Coherent(cache, pCenters + j, pRadii + j, &cache.bounds[j], &cache.rejectPlane[j],
+                                      (previous >> shift) & 0xF, planeTests) << shift;
+    }
+    if (j < wordEnd) {
+      // pad the tail to four lanes with copies of its first sphere
+      const size_t tail = wordEnd - j;
+      const uint32_t shift = (uint32_t)(j - i);
+      MXMFLOAT3 centers[4];
+      float radii[4];
+      MXMFLOAT4 bounds[4];
+      uint8_t rejectPlane[4];
+      for (size_t k = 0; k < 4; ++k) {
+        const size_t src = j + (k < tail ? k : 0);
+        centers[k] = pCenters[src];
+        radii[k] = pRadii[src];
+        bounds[k] = cache.bounds[src];
+        rejectPlane[k] = cache.rejectPlane[src];
+      }
+      uint32_t mask = MXMCullSpheres4Coherent(cache, centers, radii, bounds, rejectPlane,
+                                              (previous >> shift) & 0xF, planeTests);
+      for (size_t k = 0; k < tail; ++k) {
+        cache.bounds[j + k] = bounds[k];
+        cache.rejectPlane[j + k] = rejectPlane[k];
+      }
+      word |= (mask & ((1u << tail) - 1u)) << shift;
+    }
+    cache.visibleMask[i >> 5] = word;
+  }
+  return planeTests;
+}
+
+} //namespace DirectX
@@ -0,0 +1,219 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Deterministic reductions and integration over MXM arrays, for lockstep
+  simulations that need bit-identical results on every machine.
+
+  Work is split into chunks of MXM_DETERMINISTIC_CHUNK_SIZE elements, a
+  constant that never depends on the number of threads. Every chunk is
+  reduced by a chunk kernel into a partial result and the partials are merged
+  in the fixed pairwise tree of MXMReduceTree. Chunks can be computed by any
+  number of threads in any order, the result stays the same.
+  DirectXMathExtensionDeterministicCheck.cpp verifies this on 1 to N
+  std::thread workers.
+
+  The kernels only use operations that round identically everywhere:
+  separate multiplies and additions instead of XMVectorMultiplyAdd, which
+  becomes a fused multiply-add with _XM_FMA3_INTRINSICS_, and lane sums in a
+  fixed order. The compiler must not contract them either (/fp:precise or
+  -ffp-contract=off) and x87 code is not supported.
+
+  Integration kernels update every element on its own and are deterministic
+  for any split into ranges.
+
+//------------------------------------------------------------------------------
+// Example
+
+    // serial
+    float energy = MXMDeterministicSum(&energies[0], count);
+
+    // parallel, with any kind of job system
+    size_t chunkCount = MXMDeterministicChunkCount(count);
+    std::vector<float> partials(chunkCount);
+    for (size_t c = 0; c < chunkCount; ++c)     // distributed across threads
+      partials[c] = MXMDeterministicSumChunk(&energies[0], count, c);
+    float energy = MXMDeterministicMerge(partials);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionReduce.h"
+
+#include <vector>
+
+namespace DirectX
+{
+
+#define MXM_DETERMINISTIC_CHUNK_SIZE 1024
+
+//------------------------------------------------------------------------------
+// Chunks
+
+__MXM_INLINE size_t MXMDeterministicChunkCount(size_t count)
+{
+  return (count + MXM_DETERMINISTIC_CHUNK_SIZE - 1) / MXM_DETERMINISTIC_CHUNK_SIZE;
+}
+
+// Returns the first element of a chunk and its number of elements in size.
+__MXM_INLINE size_t MXMDeterministicChunkRange(size_t count, size_t chunk, size_t &size)
+{
+  const size_t first = chunk * MXM_DETERMINISTIC_CHUNK_SIZE;
+  size = count - first < MXM_DETERMINISTIC_CHUNK_SIZE ? count - first : MXM_DETERMINISTIC_CHUNK_SIZE;
+  return first;
+}
+
+struct MXMDETERMINISTICADD
+{
+  float operator()(float a, float b) const { return a + b; }
+  MXMFLOAT3 operator()(const MXMFLOAT3 &a, const MXMFLOAT3 &b) const { return XMVectorAdd(a, b); }
+};
+
+// Merges the chunk partials in the fixed tree, partials are overwritten.
+inline float MXMDeterministicMerge(std::vector<float> &partials)
+{
+  if (partials.empty())
+    return 0.0f;
+  MXMReduceTree(&partials[0], partials.size(), MXMDETERMINISTICADD());
+  return partials[0];
+}
+
+inline XMVECTOR MXMDeterministicMerge(std::vector<MXMFLOAT3> &partials)
+{
+  if (partials.empty())
+    return XMVectorZero();
+  MXMReduceTree(&partials[0], partials.size(), MXMDETERMINISTICADD());
+  return partials[0];
+}
+
+inline MXMPOINTSTATS MXMDeterministicMerge(std::vector<MXMPOINTSTATS> &partials)
+{
+  if (partials.empty())
+    return MXMPOINTSTATS();
+  MXMReduceTree(&partials[0], partials.size(), MXMPOINTSTATSMERGE());
+  return partials[0];
+}
+
+//------------------------------------------------------------------------------
+// Chunk kernels
+
+// Sum of the floats of one chunk in four lanes, the lanes added in a fixed order.
+inline float MXMDeterministicSumChunk(_In_reads_(count) const float *pValues, size_t count, size_t chunk)
+{
+  size_t size;
+  const float *p = pValues + MXMDeterministicChunkRange(count, chunk, size);
+
+  XMVECTOR sum = XMVectorZero();
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4)
+    sum = XMVectorAdd(sum, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + i)));
+
+  float result = XMVectorGetX(MXMVectorHorizontalSum(sum));
+  for (; i < size; ++i)
+    result += p[i];
+  return result;
+}
+
+// Dot product of two float arrays over one chunk.
+inline float MXMDeterministicDotChunk(_In_reads_(count) const float *pA, _In_reads_(count) const float *pB, size_t count, size_t chunk)
+{
+  size_t size;
+  const size_t first = MXMDeterministicChunkRange(count, chunk, size);
+  const float *a = pA + first;
+  const float *b = pB + first;
+
+  XMVECTOR sum = XMVectorZero();
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    XMVECTOR products = XMVectorMultiply(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a + i)),
+                                         XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(b + i)));
+    sum = XMVectorAdd(sum, products);
+  }
+
+  float result = XMVectorGetX(MXMVectorHorizontalSum(sum));
+  for (; i < size; ++i) {
+    float product = a[i] * b[i];
+    result += product;
+  }
+  return result;
+}
+
+// Sum of the MXMFLOAT3 of one chunk.
+inline MXMFLOAT3 MXMDeterministicSumChunk(_In_reads_(count) const MXMFLOAT3 *pValues, size_t count, size_t chunk)
+{
+  size_t size;
+  const MXMFLOAT3 *p = pValues + MXMDeterministicChunkRange(count, chunk, size);
+  return MXMComputeSum(p, size);
+}
+
+// Bounds, sums and sums of products of one chunk, relative to the first
+// element of the whole array so all chunks can be merged.
+inline MXMPOINTSTATS MXMDeterministicPointStatsChunk(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count, size_t chunk)
+{
+  size_t size;
+  const size_t first = MXMDeterministicChunkRange(count, chunk, size);
+  return MXMComputePointStatsRange(pPoints, first, size, pPoints[0]);
+}
+
+//------------------------------------------------------------------------------
+// Serial reductions
+
+// Same results as computing the chunks concurrently and merging them.
+inline float MXMDeterministicSum(_In_reads_(count) const float *pValues, size_t count)
+{
+  std::vector<float> partials(MXMDeterministicChunkCount(count));
+  for (size_t c = 0; c < partials.size(); ++c)
+    partials[c] = MXMDeterministicSumChunk(pValues, count, c);
+  return MXMDeterministicMerge(partials);
+}
+
+inline float MXMDeterministicDot(_In_reads_(count) const float *pA, _In_reads_(count) const float *pB, size_t count)
+{
+  std::vector<float> partials(MXMDeterministicChunkCount(count));
+  for (size_t c = 0; c < partials.size(); ++c)
+    partials[c] = MXMDeterministicDotChunk(pA, pB, count, c);
+  return MXMDeterministicMerge(partials);
+}
+
+inline XMVECTOR MXMDeterministicSum(_In_reads_(count) const MXMFLOAT3 *pValues, size_t count)
+{
+  std::vector<MXMFLOAT3> partials(MXMDeterministicChunkCount(count));
+  for (size_t c = 0; c < partials.size(); ++c)
+    partials[c] = MXMDeterministicSumChunk(pValues, count, c);
+  return MXMDeterministicMerge(partials);
+}
+
+inline MXMPOINTSTATS MXMDeterministicPointStats(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count)
+{
+  std::vector<MXMPOINTSTATS> partials(MXMDeterministicChunkCount(count));
+  for (size_t c = 0; c < partials.size(); ++c)
+    partials[c] = MXMDeterministicPointStatsChunk(pPoints, count, c);
+  return MXMDeterministicMerge(partials);
+}
+
+//------------------------------------------------------------------------------
+// Integration
+
+// Semi-implicit Euler step of the elements [first, first + count):
+// velocity += acceleration * dt, position += velocity * dt.
+inline void MXMDeterministicIntegrate(_Inout_ MXMFLOAT3 *pPositions, _Inout_ MXMFLOAT3 *pVelocities, _In_ const MXMFLOAT3 *pAccelerations,
+                                      size_t first, size_t count, float dt)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  for (size_t i = first; i < first + count; ++i) {
+    XMVECTOR velocity = XMVectorAdd(pVelocities[i], XMVectorMultiply(pAccelerations[i], step));
+    pVelocities[i] = velocity;
+    pPositions[i] = XMVectorAdd(pPositions[i], XMVectorMultiply(velocity, step));
+  }
+}
+
+// Integration of one chunk, the chunks may be processed in any order.
+inline void MXMDeterministicIntegrateChunk(_Inout_updates_(count) MXMFLOAT3 *pPositions, _Inout_updates_(count) MXMFLOAT3 *pVelocities,
+                                           _In_reads_(count) const MXMFLOAT3 *pAccelerations, size_t count, size_t chunk, float dt)
+{
+  size_t size;
+  const size_t first = MXMDeterministicChunkRange(count, chunk, size);
+  MXMDeterministicIntegrate(pPositions, pVelocities, pAccelerations, first, size, dt);
+}
+
+} //namespace DirectX
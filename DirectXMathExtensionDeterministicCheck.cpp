@@ -0,0 +1,170 @@
+/*------------------------------------------------------------------------------
+// INFO
+
+  Self-contained check of DirectXMathExtensionDeterministic.h.
+
+  For every thread count from 1 to N, std::thread workers compute the chunk
+  kernels into shared partial arrays, taking the next chunk from an atomic
+  counter so the assignment of chunks to threads differs from run to run.
+  The merged results of all reductions (float sum, dot product, MXMFLOAT3
+  sum and point stats) have to match the serial functions bit for bit, and
+  integrating the chunks from the workers has to produce exactly the
+  positions and velocities of one MXMDeterministicIntegrate call.
+
+  C++11 is needed for std::thread. Build with contraction disabled, as the
+  header requires, e.g.
+    g++ -std=c++11 -O2 -msse2 -ffp-contract=off -pthread DirectXMathExtensionDeterministicCheck.cpp
+  and run with an optional maximum thread count (default 16).
+
+  Returns 0 when all results match.
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionDeterministic.h"
+
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace DirectX;
+
+struct CHECKINPUT
+{
+  size_t count;
+  std::vector<float> values, weights;
+  std::vector<MXMFLOAT3> points, velocities, accelerations;
+};
+
+struct CHECKPARTIALS
+{
+  std::vector<float> sum, dot;
+  std::vector<MXMFLOAT3> sum3;
+  std::vector<MXMPOINTSTATS> stats;
+  std::vector<MXMFLOAT3> positions, velocities;    // integrated in place
+};
+
+// Runs all chunk kernels on threadCount threads, each taking the next chunk
+// from a shared counter.
+static void RunChunks(const CHECKINPUT &input, CHECKPARTIALS &partials, size_t threadCount, float dt)
+{
+  const size_t chunkCount = MXMDeterministicChunkCount(input.count);
+  partials.sum.assign(chunkCount, 0.0f);
+  partials.dot.assign(chunkCount, 0.0f);
+  partials.sum3.assign(chunkCount, MXMFLOAT3(0.0f, 0.0f, 0.0f));
+  partials.stats.assign(chunkCount, MXMPOINTSTATS());
+  partials.positions = input.points;
+  partials.velocities = input.velocities;
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threadCount; ++t) {
+    threads.push_back(std::thread([&]() {
+      for (size_t c = next++; c < chunkCount; c = next++) {
+        partials.sum[c] = MXMDeterministicSumChunk(&input.values[0], input.count, c);
+        partials.dot[c] = MXMDeterministicDotChunk(&input.values[0], &input.weights[0], input.count, c);
+        partials.sum3[c] = MXMDeterministicSumChunk(&input.points[0], input.count, c);
+        partials.stats[c] = MXMDeterministicPointStatsChunk(&input.points[0], input.count, c);
+        MXMDeterministicIntegrateChunk(&partials.positions[0], &partials.velocities[0], &input.accelerations[0],
+                                       input.count, c, dt);
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+}
+
+static bool SameBits(float a, float b)
+{
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool SameBits(const MXMFLOAT3 &a, const MXMFLOAT3 &b)
+{
+  return SameBits(a.x, b.x) && SameBits(a.y, b.y) && SameBits(a.z, b.z);
+}
+
+static bool SameBits(const MXMPOINTSTATS &a, const MXMPOINTSTATS &b)
+{
+  return SameBits(a.boundsMin, b.boundsMin) && SameBits(a.boundsMax, b.boundsMax) && SameBits(a.shift, b.shift) &&
+         SameBits(a.sum, b.sum) && SameBits(a.sumXX, b.sumXX) && SameBits(a.sumXY, b.sumXY) &&
+         SameBits(a.sumXZ, b.sumXZ) && SameBits(a.sumYY, b.sumYY) && SameBits(a.sumYZ, b.sumYZ) &&
+         SameBits(a.sumZZ, b.sumZZ) && a.count == b.count;
+}
+
+static bool SameBits(const std::vector<MXMFLOAT3> &a, const std::vector<MXMFLOAT3> &b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!SameBits(a[i], b[i]))
+      return false;
+  }
+  return true;
+}
+
+static float Random(float scale)
+{
+  return ((float)rand() / (float)RAND_MAX - 0.5f) * scale;
+}
+
+int main(int argc, char **argv)
+{
+  static const size_t counts[] = { 1, 3, 1024, 1025, 4099, 100003 };
+  const size_t maxThreads = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+  const float dt = 1.0f / 60.0f;
+
+  srand(1);
+  size_t failures = 0;
+  size_t checks = 0;
+
+  for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); ++n) {
+    // mixed magnitudes, so the sums depend on the order of the additions
+    CHECKINPUT input;
+    input.count = counts[n];
+    input.values.resize(input.count);
+    input.weights.resize(input.count);
+    input.points.resize(input.count);
+    input.velocities.resize(input.count);
+    input.accelerations.resize(input.count);
+    for (size_t i = 0; i < input.count; ++i) {
+      input.values[i] = Random(i % 7 ? 1.0f : 1.0e6f);
+      input.weights[i] = Random(i % 3 ? 1.0f : 1.0e3f);
+      input.points[i] = MXMFLOAT3(1000.0f + Random(10.0f), Random(i % 5 ? 1.0f : 1.0e4f), Random(0.01f));
+      input.velocities[i] = MXMFLOAT3(Random(10.0f), Random(10.0f), Random(10.0f));
+      input.accelerations[i] = MXMFLOAT3(Random(1.0f), -9.81f + Random(1.0f), Random(1.0f));
+    }
+
+    const float sum = MXMDeterministicSum(&input.values[0], input.count);
+    const float dot = MXMDeterministicDot(&input.values[0], &input.weights[0], input.count);
+    const MXMFLOAT3 sum3 = MXMDeterministicSum(&input.points[0], input.count);
+    const MXMPOINTSTATS stats = MXMDeterministicPointStats(&input.points[0], input.count);
+    std::vector<MXMFLOAT3> positions = input.points, velocities = input.velocities;
+    MXMDeterministicIntegrate(&positions[0], &velocities[0], &input.accelerations[0], 0, input.count, dt);
+
+    for (size_t threadCount = 1; threadCount <= maxThreads; ++threadCount) {
+      CHECKPARTIALS partials;
+      RunChunks(input, partials, threadCount, dt);
+
+      const bool results[5] = {
+        SameBits(MXMDeterministicMerge(partials.sum), sum),
+        SameBits(MXMDeterministicMerge(partials.dot), dot),
+        SameBits(MXMFLOAT3(MXMDeterministicMerge(partials.sum3)), sum3),
+        SameBits(MXMDeterministicMerge(partials.stats), stats),
+        SameBits(partials.positions, positions) && SameBits(partials.velocities, velocities)
+      };
+      static const char *names[5] = { "sum", "dot", "MXMFLOAT3 sum", "point stats", "integration" };
+      for (int r = 0; r < 5; ++r) {
+        ++checks;
+        if (!results[r]) {
+          printf("%s mismatch: count %u, threads %u\n", names[r], (unsigned)input.count, (unsigned)threadCount);
+          ++failures;
+        }
+      }
+    }
+  }
+
+  printf("%u of %u checks passed\n", (unsigned)(checks - failures), (unsigned)checks);
+  return failures ? 1 : 0;
+}
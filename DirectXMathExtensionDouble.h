@@ -0,0 +1,384 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Double precision storage types for large world coordinates.
+
+  MXMDOUBLE3 and MXMDOUBLE4X4 follow the MXM float types: they assign to and
+  from the register types MXMVECTORD and MXMMATRIXD and load or store
+  implicitly. With AVX MXMVECTORD is a __m256d holding four doubles, without
+  it a plain array with the same functions.
+
+  Rendering works in float relative to the camera. MXMVectorDRelative and
+  MXMMatrixDRelative subtract the camera position in double precision and
+  convert the small difference to float afterwards, so no precision is lost
+  far away from the world origin. MXMRebasePositions and MXMRebaseMatrices do
+  the same for whole arrays; split large arrays into ranges to convert them
+  concurrently.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMDOUBLE3 cameraPosition(6378137.0, 12.5, -3.0);
+    MXMDOUBLE4X4 world = MXMMatrixDTranslation(6378140.0, 10.0, 0.0);
+
+    MXMFLOAT4X4 relativeWorld = MXMMatrixDRelative(world, cameraPosition);
+
+    MXMRebasePositions(&positions[0], count, cameraPosition, &relativePositions[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+# include <immintrin.h>
+#endif
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Register types
+
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+typedef __m256d MXMVECTORD;
+typedef const MXMVECTORD FXMVECTORD;
+#else
+struct MXMVECTORD
+{
+  double v[4];
+};
+typedef const MXMVECTORD& FXMVECTORD;
+#endif
+
+struct MXMMATRIXD
+{
+  MXMVECTORD r[4];
+};
+typedef const MXMMATRIXD& CXMMATRIXD;
+
+//------------------------------------------------------------------------------
+// Vector operations
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDSet(double x, double y, double z, double w)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_set_pd(w, z, y, x);
+#else
+  MXMVECTORD result = { { x, y, z, w } };
+  return result;
+#endif
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDReplicate(double value)
+{
+  return MXMVectorDSet(value, value, value, value);
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDZero()
+{
+  return MXMVectorDSet(0.0, 0.0, 0.0, 0.0);
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDAdd(FXMVECTORD a, FXMVECTORD b)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_add_pd(a, b);
+#else
+  return MXMVectorDSet(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]);
+#endif
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDSubtract(FXMVECTORD a, FXMVECTORD b)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_sub_pd(a, b);
+#else
+  return MXMVectorDSet(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]);
+#endif
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDMultiply(FXMVECTORD a, FXMVECTORD b)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_mul_pd(a, b);
+#else
+  return MXMVectorDSet(a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]);
+#endif
+}
+
+// Returns a * b + c.
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDMultiplyAdd(FXMVECTORD a, FXMVECTORD b, FXMVECTORD c)
+{
+  return MXMVectorDAdd(MXMVectorDMultiply(a, b), c);
+}
+
+__MXM_INLINE double XM_CALLCONV MXMVectorDGetX(FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_cvtsd_f64(v);
+#else
+  return v.v[0];
+#endif
+}
+
+template<int Element>
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDSplat(FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  // duplicate the 128 bit half holding the element, then the element inside it
+  const __m256d half = _mm256_permute2f128_pd(v, v, Element < 2 ? 0x00 : 0x11);
+  return _mm256_permute_pd(half, Element & 1 ? 0xF : 0x0);
+#else
+  return MXMVectorDReplicate(v.v[Element]);
+#endif
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDZeroW(FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_blend_pd(v, _mm256_setzero_pd(), 0x8);
+#else
+  return MXMVectorDSet(v.v[0], v.v[1], v.v[2], 0.0);
+#endif
+}
+
+// Rounds the four components to float.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorDToFloat(FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_cvtpd_ps(v);
+#else
+  return XMVectorSet((float)v.v[0], (float)v.v[1], (float)v.v[2], (float)v.v[3]);
+#endif
+}
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVectorDFromFloat(FXMVECTOR v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_cvtps_pd(v);
+#else
+  XMFLOAT4 f;
+  XMStoreFloat4(&f, v);
+  return MXMVectorDSet(f.x, f.y, f.z, f.w);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Matrix operations
+
+__MXM_INLINE MXMMATRIXD XM_CALLCONV MXMMatrixDSet(FXMVECTORD r0, FXMVECTORD r1, FXMVECTORD r2, FXMVECTORD r3)
+{
+  MXMMATRIXD result;
+  result.r[0] = r0;
+  result.r[1] = r1;
+  result.r[2] = r2;
+  result.r[3] = r3;
+  return result;
+}
+
+__MXM_INLINE MXMMATRIXD XM_CALLCONV MXMMatrixDIdentity()
+{
+  return MXMMatrixDSet(MXMVectorDSet(1.0, 0.0, 0.0, 0.0), MXMVectorDSet(0.0, 1.0, 0.0, 0.0),
+                       MXMVectorDSet(0.0, 0.0, 1.0, 0.0), MXMVectorDSet(0.0, 0.0, 0.0, 1.0));
+}
+
+__MXM_INLINE MXMMATRIXD XM_CALLCONV MXMMatrixDTranslation(double x, double y, double z)
+{
+  return MXMMatrixDSet(MXMVectorDSet(1.0, 0.0, 0.0, 0.0), MXMVectorDSet(0.0, 1.0, 0.0, 0.0),
+                       MXMVectorDSet(0.0, 0.0, 1.0, 0.0), MXMVectorDSet(x, y, z, 1.0));
+}
+
+// Row vector times matrix, v.x * m.r[0] + v.y * m.r[1] + v.z * m.r[2] + v.w * m.r[3].
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMVector4DTransform(FXMVECTORD v, CXMMATRIXD m)
+{
+  MXMVECTORD result = MXMVectorDMultiply(MXMVectorDSplat<0>(v), m.r[0]);
+  result = MXMVectorDMultiplyAdd(MXMVectorDSplat<1>(v), m.r[1], result);
+  result = MXMVectorDMultiplyAdd(MXMVectorDSplat<2>(v), m.r[2], result);
+  return MXMVectorDMultiplyAdd(MXMVectorDSplat<3>(v), m.r[3], result);
+}
+
+// Same order as XMMatrixMultiply: transforms by a, then by b.
+__MXM_INLINE MXMMATRIXD XM_CALLCONV MXMMatrixDMultiply(CXMMATRIXD a, CXMMATRIXD b)
+{
+  return MXMMatrixDSet(MXMVector4DTransform(a.r[0], b), MXMVector4DTransform(a.r[1], b),
+                       MXMVector4DTransform(a.r[2], b), MXMVector4DTransform(a.r[3], b));
+}
+
+__MXM_INLINE XMMATRIX XM_CALLCONV MXMMatrixDToFloat(CXMMATRIXD m)
+{
+  return XMMATRIX(MXMVectorDToFloat(m.r[0]), MXMVectorDToFloat(m.r[1]),
+                  MXMVectorDToFloat(m.r[2]), MXMVectorDToFloat(m.r[3]));
+}
+
+__MXM_INLINE MXMMATRIXD XM_CALLCONV MXMMatrixDFromFloat(FXMMATRIX m)
+{
+  return MXMMatrixDSet(MXMVectorDFromFloat(m.r[0]), MXMVectorDFromFloat(m.r[1]),
+                       MXMVectorDFromFloat(m.r[2]), MXMVectorDFromFloat(m.r[3]));
+}
+
+//------------------------------------------------------------------------------
+// Loads and stores
+
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMLoadDouble4(_In_reads_(4) const double *pSource)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_loadu_pd(pSource);
+#else
+  return MXMVectorDSet(pSource[0], pSource[1], pSource[2], pSource[3]);
+#endif
+}
+
+__MXM_INLINE void XM_CALLCONV MXMStoreDouble4(_Out_writes_(4) double *pDestination, FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  _mm256_storeu_pd(pDestination, v);
+#else
+  pDestination[0] = v.v[0];
+  pDestination[1] = v.v[1];
+  pDestination[2] = v.v[2];
+  pDestination[3] = v.v[3];
+#endif
+}
+
+// Loads three doubles, w is zero.
+__MXM_INLINE MXMVECTORD XM_CALLCONV MXMLoadDouble3(_In_reads_(3) const double *pSource)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  return _mm256_maskload_pd(pSource, _mm256_set_epi64x(0, -1, -1, -1));
+#else
+  return MXMVectorDSet(pSource[0], pSource[1], pSource[2], 0.0);
+#endif
+}
+
+__MXM_INLINE void XM_CALLCONV MXMStoreDouble3(_Out_writes_(3) double *pDestination, FXMVECTORD v)
+{
+#if defined(_XM_AVX_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  _mm256_maskstore_pd(pDestination, _mm256_set_epi64x(0, -1, -1, -1), v);
+#else
+  pDestination[0] = v.v[0];
+  pDestination[1] = v.v[1];
+  pDestination[2] = v.v[2];
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Storage types
+
+struct MXMDOUBLE3
+{
+  double x, y, z;
+
+  __MXM_INLINE MXMDOUBLE3() : x(0.0), y(0.0), z(0.0) {}
+  __MXM_INLINE MXMDOUBLE3(double _x, double _y, double _z) : x(_x), y(_y), z(_z) {}
+  __MXM_INLINE explicit MXMDOUBLE3(_In_reads_(3) const double *pArray) : x(pArray[0]), y(pArray[1]), z(pArray[2]) {}
+
+  __MXM_INLINE MXMDOUBLE3(FXMVECTORD v) {
+    MXMStoreDouble3(&x, v);
+  }
+
+  __MXM_INLINE XM_CALLCONV operator const MXMVECTORD() const {
+    return MXMLoadDouble3(&x);
+  }
+
+  __MXM_INLINE MXMDOUBLE3& XM_CALLCONV operator= (FXMVECTORD v) {
+    MXMStoreDouble3(&x, v);
+    return *this;
+  }
+};
+
+struct MXMDOUBLE4X4
+{
+  double m[4][4];
+
+  __MXM_INLINE MXMDOUBLE4X4() {
+    for (int r = 0; r < 4; ++r)
+      m[r][0] = m[r][1] = m[r][2] = m[r][3] = 0.0;
+  }
+  __MXM_INLINE MXMDOUBLE4X4(double m00, double m01, double m02, double m03,
+                             double m10, double m11, double m12, double m13,
+                             double m20, double m21, double m22, double m23,
+                             double m30, double m31, double m32, double m33) {
+    m[0][0] = m00; m[0][1] = m01; m[0][2] = m02; m[0][3] = m03;
+    m[1][0] = m10; m[1][1] = m11; m[1][2] = m12; m[1][3] = m13;
+    m[2][0] = m20; m[2][1] = m21; m[2][2] = m22; m[2][3] = m23;
+    m[3][0] = m30; m[3][1] = m31; m[3][2] = m32; m[3][3] = m33;
+  }
+  __MXM_INLINE explicit MXMDOUBLE4X4(_In_reads_(16) const double *pArray) {
+    for (int i = 0; i < 16; ++i)
+      m[i / 4][i % 4] = pArray[i];
+  }
+
+  __MXM_INLINE MXMDOUBLE4X4(CXMMATRIXD mat) {
+    for (int r = 0; r < 4; ++r)
+      MXMStoreDouble4(m[r], mat.r[r]);
+  }
+
+  __MXM_INLINE XM_CALLCONV operator const MXMMATRIXD() const {
+    return MXMMatrixDSet(MXMLoadDouble4(m[0]), MXMLoadDouble4(m[1]), MXMLoadDouble4(m[2]), MXMLoadDouble4(m[3]));
+  }
+
+  __MXM_INLINE MXMDOUBLE4X4& XM_CALLCONV operator= (CXMMATRIXD mat) {
+    for (int r = 0; r < 4; ++r)
+      MXMStoreDouble4(m[r], mat.r[r]);
+    return *this;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Camera relative conversion
+
+// Returns position - origin in float. The w components are ignored.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorDRelative(FXMVECTORD position, FXMVECTORD origin)
+{
+  return MXMVectorDToFloat(MXMVectorDZeroW(MXMVectorDSubtract(position, origin)));
+}
+
+// Returns the world matrix with its translation moved by -origin in float.
+// The w component of origin is ignored.
+__MXM_INLINE XMMATRIX XM_CALLCONV MXMMatrixDRelative(CXMMATRIXD world, FXMVECTORD origin)
+{
+  return XMMATRIX(MXMVectorDToFloat(world.r[0]), MXMVectorDToFloat(world.r[1]), MXMVectorDToFloat(world.r[2]),
+                  MXMVectorDToFloat(MXMVectorDSubtract(world.r[3], MXMVectorDZeroW(origin))));
+}
+
+// Converts count positions relative to origin, four positions per step.
+inline void MXMRebasePositions(_In_reads_(count) const MXMDOUBLE3 *pPositions, size_t count, const MXMDOUBLE3 &origin,
+                               _Out_writes_(count) MXMFLOAT3 *pRelative)
+{
+  // four MXMDOUBLE3 are twelve consecutive doubles: xyzx yzxy zxyz
+  const MXMVECTORD o0 = MXMVectorDSet(origin.x, origin.y, origin.z, origin.x);
+  const MXMVECTORD o1 = MXMVectorDSet(origin.y, origin.z, origin.x, origin.y);
+  const MXMVECTORD o2 = MXMVectorDSet(origin.z, origin.x, origin.y, origin.z);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const double *pSource = &pPositions[i].x;
+    float *pDestination = &pRelative[i].x;
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination), MXMVectorDToFloat(MXMVectorDSubtract(MXMLoadDouble4(pSource), o0)));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 4), MXMVectorDToFloat(MXMVectorDSubtract(MXMLoadDouble4(pSource + 4), o1)));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 8), MXMVectorDToFloat(MXMVectorDSubtract(MXMLoadDouble4(pSource + 8), o2)));
+  }
+  const MXMVECTORD o = origin;
+  for (; i < count; ++i)
+    pRelative[i] = MXMVectorDRelative(pPositions[i], o);
+}
+
+// Converts count world matrices relative to origin.
+inline void MXMRebaseMatrices(_In_reads_(count) const MXMDOUBLE4X4 *pMatrices, size_t count, const MXMDOUBLE3 &origin,
+                              _Out_writes_(count) MXMFLOAT4X4 *pRelative)
+{
+  const MXMVECTORD o = MXMVectorDSet(origin.x, origin.y, origin.z, 0.0);
+  for (size_t i = 0; i < count; ++i) {
+    const MXMDOUBLE4X4 &source = pMatrices[i];
+    XMFLOAT4X4 &destination = pRelative[i];
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(destination.m[0]), MXMVectorDToFloat(MXMLoadDouble4(source.m[0])));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(destination.m[1]), MXMVectorDToFloat(MXMLoadDouble4(source.m[1])));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(destination.m[2]), MXMVectorDToFloat(MXMLoadDouble4(source.m[2])));
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(destination.m[3]),
+                  MXMVectorDToFloat(MXMVectorDSubtract(MXMLoadDouble4(source.m[3]), o)));
+  }
+}
+
+} //namespace DirectX
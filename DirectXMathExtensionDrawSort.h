@@ -0,0 +1,163 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  View depth and sort keys for ordering draws, e.g. transparent objects back
+  to front.
+
+  MXMViewDepths only loads the translation row of every MXMFLOAT4X4 world
+  matrix. Four translations are transposed into x, y, z and w vectors and
+  dotted with the third column of the view matrix, which gives the view
+  space depth of four objects at once; every iteration handles eight.
+
+  MXMDrawSortKeys turns the depths into 64 bit keys: the float bits are
+  flipped into an unsigned order (negative depths included) and inverted for
+  back to front sorting, the material id fills the lower bits. Sorting the
+  keys with MXMRadixSort orders by depth first and by material for equal
+  depths. Fewer material bits shorten the keys and save radix passes.
+
+  Depths and keys are computed over ranges and the chunk functions of
+  MXMRadixSort sort from several threads, so every stage can be distributed
+  over the caller's worker threads.
+
+//------------------------------------------------------------------------------
+// Example
+
+    std::vector<uint32_t> order(count);
+    MXMSortDraws(&worlds[0], &materials[0], count, view, true, &order[0]);
+    // draw object order[0] first
+
+    // or by stages over ranges
+    MXMViewDepths(&worlds[0], first, rangeCount, view, &depths[0]);
+    MXMDrawSortKeys(&depths[0], &materials[0], first, rangeCount, true, 16, &keys[0], &order[0]);
+    MXMRadixSort(&keys[0], &order[0], count, 32 + 16);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionRadixSort.h"
+
+#include <vector>
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Depth
+
+// Depths of four objects from their translation rows. World matrices are
+// affine, so w = 1 picks up the translation of the view.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMViewDepth4(_In_reads_(4) const MXMFLOAT4X4 *pWorlds, FXMVECTOR column)
+{
+  XMMATRIX t(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pWorlds[0].m[3])),
+             XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pWorlds[1].m[3])),
+             XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pWorlds[2].m[3])),
+             XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pWorlds[3].m[3])));
+  t = XMMatrixTranspose(t);
+  XMVECTOR depth = XMVectorMultiply(t.r[3], XMVectorSplatW(column));
+  depth = XMVectorMultiplyAdd(t.r[2], XMVectorSplatZ(column), depth);
+  depth = XMVectorMultiplyAdd(t.r[1], XMVectorSplatY(column), depth);
+  return XMVectorMultiplyAdd(t.r[0], XMVectorSplatX(column), depth);
+}
+
+// Writes the view space depth of the objects [first, first + count) to
+// pDepths[first, first + count).
+inline void XM_CALLCONV MXMViewDepths(_In_reads_(_Inexpressible_(first + count)) const MXMFLOAT4X4 *pWorlds,
+                                      size_t first, size_t count, FXMMATRIX view,
+                                      _Out_writes_(_Inexpressible_(first + count)) float *pDepths)
+{
+  const XMVECTOR column = XMMatrixTranspose(view).r[2];
+  const size_t end = first + count;
+  size_t i = first;
+  for (; i + 8 <= end; i += 8) {
+    const XMVECTOR depth0 = MXMViewDepth4(pWorlds + i, column);
+    const XMVECTOR depth1 = MXMViewDepth4(pWorlds + i + 4, column);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDepths + i), depth0);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDepths + i + 4), depth1);
+  }
+  for (; i < end; ++i)
+    pDepths[i] = XMVectorGetX(XMVector4Dot(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pWorlds[i].m[3])), column));
+}
+
+//------------------------------------------------------------------------------
+// Keys
+
+// Maps four depths to unsigned integers of the same order, or of the reverse
+// order for back to front sorting.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMDrawSortDepthBits(FXMVECTOR depth, bool backToFront)
+{
+  // negative floats flip all bits, positive ones only the sign
+  const XMVECTOR signMask = XMVectorSplatSignMask();
+  const XMVECTOR negative = XMVectorEqualInt(XMVectorAndInt(depth, signMask), signMask);
+  XMVECTOR flip = XMVectorSelect(signMask, XMVectorTrueInt(), negative);
+  if (backToFront)
+    flip = XMVectorXorInt(flip, XMVectorTrueInt());
+  return XMVectorXorInt(depth, flip);
+}
+
+__MXM_INLINE uint64_t MXMDrawSortKey(float depth, uint32_t material, bool backToFront, uint32_t materialBits = 32)
+{
+  const uint32_t depthBits = XMVectorGetIntX(MXMDrawSortDepthBits(XMVectorReplicate(depth), backToFront));
+  const uint32_t materialMask = materialBits < 32 ? (1u << materialBits) - 1 : 0xFFFFFFFFu;
+  return ((uint64_t)depthBits << materialBits) | (material & materialMask);
+}
+
+// Writes the keys of the objects [first, first + count) and their indices as
+// values. Sort with keyBits = 32 + materialBits.
+inline void MXMDrawSortKeys(_In_reads_(_Inexpressible_(first + count)) const float *pDepths,
+                            _In_reads_(_Inexpressible_(first + count)) const uint32_t *pMaterials,
+                            size_t first, size_t count, bool backToFront, uint32_t materialBits,
+                            _Out_writes_(_Inexpressible_(first + count)) uint64_t *pKeys,
+                            _Out_writes_(_Inexpressible_(first + count)) uint32_t *pValues)
+{
+  const uint32_t materialMask = materialBits < 32 ? (1u << materialBits) - 1 : 0xFFFFFFFFu;
+  const size_t end = first + count;
+  size_t i = first;
+  for (; i + 4 <= end; i += 4) {
+    uint32_t bits[4];
+    XMStoreInt4(bits, MXMDrawSortDepthBits(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pDepths + i)), backToFront));
+    pKeys[i] = ((uint64_t)bits[0] << materialBits) | (pMaterials[i] & materialMask);
+    pKeys[i + 1] = ((uint64_t)bits[1] << materialBits) | (pMaterials[i + 1] & materialMask);
+    pKeys[i + 2] = ((uint64_t)bits[2] << materialBits) | (pMaterials[i + 2] & materialMask);
+    pKeys[i + 3] = ((uint64_t)bits[3] << materialBits) | (pMaterials[i + 3] & materialMask);
+    pValues[i] = (uint32_t)i;
+    pValues[i + 1] = (uint32_t)i + 1;
+    pValues[i + 2] = (uint32_t)i + 2;
+    pValues[i + 3] = (uint32_t)i + 3;
+  }
+  for (; i < end; ++i) {
+    pKeys[i] = MXMDrawSortKey(pDepths[i], pMaterials[i], backToFront, materialBits);
+    pValues[i] = (uint32_t)i;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Sorting
+
+// Writes the draw order of count objects to pOrder on the calling thread.
+// pMaterials may be NULL to sort by depth only.
+inline void XM_CALLCONV MXMSortDraws(_In_reads_(count) const MXMFLOAT4X4 *pWorlds,
+                                     _In_reads_opt_(count) const uint32_t *pMaterials, size_t count,
+                                     FXMMATRIX view, bool backToFront, _Out_writes_(count) uint32_t *pOrder,
+                                     uint32_t materialBits = 32)
+{
+  if (!count)
+    return;
+  if (!pMaterials)
+    materialBits = 0;
+
+  std::vector<float> depths(count);
+  std::vector<uint64_t> keys(count);
+  MXMViewDepths(pWorlds, 0, count, view, &depths[0]);
+  if (pMaterials) {
+    MXMDrawSortKeys(&depths[0], pMaterials, 0, count, backToFront, materialBits, &keys[0], pOrder);
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      keys[i] = MXMDrawSortKey(depths[i], 0, backToFront, 0);
+      pOrder[i] = (uint32_t)i;
+    }
+  }
+  MXMRadixSort(&keys[0], pOrder, count, 32 + materialBits);
+}
+
+} //namespace DirectX
@@ -0,0 +1,287 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Eigen-decomposition of symmetric 3x3 matrices and oriented bounding box
+  fitting by principal component analysis.
+
+  The eigen-solver runs cyclic Jacobi sweeps on four matrices at once, held
+  in a MXMFLOAT3X3SOA with one XMVECTOR per element. Every rotation is
+  computed without branches, so all four lanes follow the same instructions.
+  Single matrices are solved in all lanes of one packet. Five sweeps are
+  plenty for float precision on covariance matrices.
+
+  Eigenvalues are sorted descending. Eigenvectors are returned as the rows
+  of a MXMFLOAT3X3 (row i belongs to eigenvalue i), so they can be used as
+  the axes of a frame directly.
+
+  Oriented boxes are fitted along the eigenvectors of the covariance of the
+  points (DirectXMathExtensionReduce.h) and stored like DirectX's
+  BoundingOrientedBox: center, half extents and orientation quaternion.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMFLOAT3 eigenvalues;
+    MXMFLOAT3X3 eigenvectors;
+    MXMEigenSymmetric3x3(covariance, eigenvalues, eigenvectors);
+
+    MXMORIENTEDBOX box = MXMFitOrientedBox(&vertices[0], vertexCount);
+
+    // one box per span of a vertex array, eigen-decompositions in packets of four
+    MXMFitOrientedBoxes(&vertices[0], &spanFirst[0], &spanCount[0], spanCount, &boxes[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionReduce.h"
+
+#include <vector>
+#include <float.h>
+
+namespace DirectX
+{
+
+#define MXM_EIGEN_DEFAULT_SWEEPS 5
+
+//------------------------------------------------------------------------------
+// Jacobi eigen-solver
+
+// Jacobi rotation zeroing a[p][q] of four symmetric matrices, applied to the
+// matrices and the rows of the eigenvector matrices e.
+__MXM_INLINE void MXMJacobiRotate(XMVECTOR a[3][3], XMVECTOR e[3][3], int p, int q)
+{
+  const int r = 3 - p - q;
+  const XMVECTOR apq = a[p][q];
+  const XMVECTOR d = XMVectorSubtract(a[q][q], a[p][p]);
+
+  // t = tan of the rotation angle, the smaller root for stability
+  const XMVECTOR sign = XMVectorSelect(XMVectorSplatOne(), XMVectorNegate(XMVectorSplatOne()), XMVectorLess(d, XMVectorZero()));
+  const XMVECTOR apq2 = XMVectorAdd(apq, apq);
+  const XMVECTOR denominator = XMVectorAdd(XMVectorAbs(d), XMVectorSqrt(XMVectorAdd(XMVectorMultiply(d, d), XMVectorMultiply(apq2, apq2))));
+  XMVECTOR t = XMVectorDivide(XMVectorMultiply(apq2, sign), denominator);
+  t = XMVectorSelect(t, XMVectorZero(), XMVectorEqual(denominator, XMVectorZero()));
+
+  const XMVECTOR c = XMVectorReciprocalSqrt(XMVectorAdd(XMVectorMultiply(t, t), XMVectorSplatOne()));
+  const XMVECTOR s = XMVectorMultiply(t, c);
+
+  const XMVECTOR tapq = XMVectorMultiply(t, apq);
+  a[p][p] = XMVectorSubtract(a[p][p], tapq);
+  a[q][q] = XMVectorAdd(a[q][q], tapq);
+  a[p][q] = a[q][p] = XMVectorZero();
+
+  const XMVECTOR arp = a[r][p];
+  const XMVECTOR arq = a[r][q];
+  a[r][p] = a[p][r] = XMVectorSubtract(XMVectorMultiply(c, arp), XMVectorMultiply(s, arq));
+  a[r][q] = a[q][r] = XMVectorAdd(XMVectorMultiply(s, arp), XMVectorMultiply(c, arq));
+
+  for (int k = 0; k < 3; ++k) {
+    const XMVECTOR epk = e[p][k];
+    const XMVECTOR eqk = e[q][k];
+    e[p][k] = XMVectorSubtract(XMVectorMultiply(c, epk), XMVectorMultiply(s, eqk));
+    e[q][k] = XMVectorAdd(XMVectorMultiply(s, epk), XMVectorMultiply(c, eqk));
+  }
+}
+
+// Swaps eigenvalues i and j and their eigenvectors in the lanes where
+// eigenvalue i is smaller than eigenvalue j.
+__MXM_INLINE void MXMEigenSortPair(XMVECTOR eigenvalues[3], XMVECTOR e[3][3], int i, int j)
+{
+  const XMVECTOR swap = XMVectorLess(eigenvalues[i], eigenvalues[j]);
+  const XMVECTOR vi = eigenvalues[i];
+  eigenvalues[i] = XMVectorSelect(vi, eigenvalues[j], swap);
+  eigenvalues[j] = XMVectorSelect(eigenvalues[j], vi, swap);
+  for (int k = 0; k < 3; ++k) {
+    const XMVECTOR ei = e[i][k];
+    e[i][k] = XMVectorSelect(ei, e[j][k], swap);
+    e[j][k] = XMVectorSelect(e[j][k], ei, swap);
+  }
+}
+
+// Eigen-decomposition of four symmetric matrices. Only the upper triangle of
+// the matrices is read. eigenvectors.m[i] holds eigenvector i of every lane.
+inline void MXMEigenSymmetric3x3SoA(const MXMFLOAT3X3SOA &matrices, _Out_writes_(3) XMVECTOR *pEigenvalues,
+                                    MXMFLOAT3X3SOA &eigenvectors, uint32_t sweeps = MXM_EIGEN_DEFAULT_SWEEPS)
+{
+  XMVECTOR a[3][3];
+  for (int i = 0; i < 3; ++i) {
+    for (int j = i; j < 3; ++j)
+      a[i][j] = a[j][i] = matrices.m[i][j];
+  }
+
+  XMVECTOR (&e)[3][3] = eigenvectors.m;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j)
+      e[i][j] = i == j ? XMVectorSplatOne() : XMVectorZero();
+  }
+
+  for (uint32_t sweep = 0; sweep < sweeps; ++sweep) {
+    MXMJacobiRotate(a, e, 0, 1);
+    MXMJacobiRotate(a, e, 0, 2);
+    MXMJacobiRotate(a, e, 1, 2);
+  }
+
+  pEigenvalues[0] = a[0][0];
+  pEigenvalues[1] = a[1][1];
+  pEigenvalues[2] = a[2][2];
+  MXMEigenSortPair(pEigenvalues, e, 0, 1);
+  MXMEigenSortPair(pEigenvalues, e, 0, 2);
+  MXMEigenSortPair(pEigenvalues, e, 1, 2);
+}
+
+// Eigen-decomposition of a single symmetric matrix, see above.
+inline void MXMEigenSymmetric3x3(const MXMFLOAT3X3 &matrix, MXMFLOAT3 &eigenvalues, MXMFLOAT3X3 &eigenvectors,
+                                 uint32_t sweeps = MXM_EIGEN_DEFAULT_SWEEPS)
+{
+  MXMFLOAT3X3SOA packet, vectors;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j)
+      packet.m[i][j] = XMVectorReplicate(matrix.m[i][j]);
+  }
+
+  XMVECTOR values[3];
+  MXMEigenSymmetric3x3SoA(packet, values, vectors, sweeps);
+
+  eigenvalues = MXMFLOAT3(XMVectorGetX(values[0]), XMVectorGetX(values[1]), XMVectorGetX(values[2]));
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j)
+      eigenvectors.m[i][j] = XMVectorGetX(vectors.m[i][j]);
+  }
+}
+
+// Eigen-decompositions of count symmetric matrices, four per packet.
+inline void MXMEigenSymmetric3x3(_In_reads_(count) const MXMFLOAT3X3 *pMatrices, size_t count,
+                                 _Out_writes_(count) MXMFLOAT3 *pEigenvalues, _Out_writes_(count) MXMFLOAT3X3 *pEigenvectors,
+                                 uint32_t sweeps = MXM_EIGEN_DEFAULT_SWEEPS)
+{
+  for (size_t i = 0; i < count; i += 4) {
+    MXMFLOAT3X3 tail[4];
+    const MXMFLOAT3X3 *matrices = pMatrices + i;
+    if (i + 4 > count) {
+      for (size_t k = 0; k < 4; ++k)
+        tail[k] = pMatrices[i + k < count ? i + k : count - 1];
+      matrices = tail;
+    }
+
+    MXMFLOAT3X3SOA packet, vectors;
+    MXMLoadFloat3x3SoA(matrices, packet);
+    XMVECTOR values[3];
+    MXMEigenSymmetric3x3SoA(packet, values, vectors, sweeps);
+
+    MXMFLOAT3 eigenvalues[4];
+    MXMFLOAT3X3 eigenvectors[4];
+    MXMStoreFloat3SoA(eigenvalues, values[0], values[1], values[2]);
+    MXMStoreFloat3x3SoA(eigenvectors, vectors);
+    for (size_t k = 0; k < 4 && i + k < count; ++k) {
+      pEigenvalues[i + k] = eigenvalues[k];
+      pEigenvectors[i + k] = eigenvectors[k];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Oriented bounding boxes
+
+// Same layout as BoundingOrientedBox of DirectXCollision.
+struct MXMORIENTEDBOX
+{
+  MXMFLOAT3 center;
+  MXMFLOAT3 extents;                 // half extents along the local axes
+  MXMFLOAT4 orientation;             // rotation from local to world space
+};
+
+// Fits a box with the given axes (rows, orthonormal and right handed) around
+// the points.
+inline MXMORIENTEDBOX MXMFitOrientedBoxAxes(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count, const MXMFLOAT3X3 &axes)
+{
+  MXMORIENTEDBOX box;
+  const XMMATRIX m = axes;
+  box.orientation = XMQuaternionNormalize(XMQuaternionRotationMatrix(m));
+  if (!count) {
+    box.center = MXMFLOAT3(0.0f, 0.0f, 0.0f);
+    box.extents = MXMFLOAT3(0.0f, 0.0f, 0.0f);
+    return box;
+  }
+
+  // projections of four points onto each axis per step
+  XMVECTOR axis[3][3];
+  for (int a = 0; a < 3; ++a) {
+    for (int k = 0; k < 3; ++k)
+      axis[a][k] = XMVectorReplicate(axes.m[a][k]);
+  }
+  XMVECTOR projectionMin[3], projectionMax[3];
+  for (int a = 0; a < 3; ++a) {
+    projectionMin[a] = XMVectorReplicate(FLT_MAX);
+    projectionMax[a] = XMVectorReplicate(-FLT_MAX);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(pPoints + i, x, y, z);
+    for (int a = 0; a < 3; ++a) {
+      XMVECTOR d = XMVectorMultiplyAdd(x, axis[a][0], XMVectorMultiplyAdd(y, axis[a][1], XMVectorMultiply(z, axis[a][2])));
+      projectionMin[a] = XMVectorMin(projectionMin[a], d);
+      projectionMax[a] = XMVectorMax(projectionMax[a], d);
+    }
+  }
+
+  XMVECTOR boundsMin = MXMVectorHorizontalMin3(projectionMin[0], projectionMin[1], projectionMin[2]);
+  XMVECTOR boundsMax = MXMVectorHorizontalMax3(projectionMax[0], projectionMax[1], projectionMax[2]);
+  const XMMATRIX transposed = XMMatrixTranspose(m);
+  for (; i < count; ++i) {
+    XMVECTOR d = XMVector3TransformNormal(pPoints[i], transposed);
+    boundsMin = XMVectorMin(boundsMin, d);
+    boundsMax = XMVectorMax(boundsMax, d);
+  }
+
+  const XMVECTOR half = XMVectorReplicate(0.5f);
+  box.extents = XMVectorMultiply(XMVectorSubtract(boundsMax, boundsMin), half);
+  box.center = XMVector3TransformNormal(XMVectorMultiply(XMVectorAdd(boundsMin, boundsMax), half), m);
+  return box;
+}
+
+// Turns sorted eigenvectors into right handed box axes.
+__MXM_INLINE MXMFLOAT3X3 MXMOrientedBoxAxes(const MXMFLOAT3X3 &eigenvectors)
+{
+  XMVECTOR axis0 = XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(eigenvectors.m[0])));
+  XMVECTOR axis1 = XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(eigenvectors.m[1])));
+  XMVECTOR axis2 = XMVector3Cross(axis0, axis1);
+
+  MXMFLOAT3X3 axes;
+  XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(axes.m[0]), axis0);
+  XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(axes.m[1]), axis1);
+  XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(axes.m[2]), axis2);
+  return axes;
+}
+
+// Fits a box along the principal axes of the points.
+inline MXMORIENTEDBOX MXMFitOrientedBox(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count,
+                                        uint32_t sweeps = MXM_EIGEN_DEFAULT_SWEEPS)
+{
+  MXMFLOAT3 eigenvalues;
+  MXMFLOAT3X3 eigenvectors;
+  MXMEigenSymmetric3x3(MXMPointStatsCovariance(MXMComputePointStats(pPoints, count)), eigenvalues, eigenvectors, sweeps);
+  return MXMFitOrientedBoxAxes(pPoints, count, MXMOrientedBoxAxes(eigenvectors));
+}
+
+// Fits one box per span of points, span i covers the points
+// [pSpanFirst[i], pSpanFirst[i] + pSpanCount[i]).
+inline void MXMFitOrientedBoxes(_In_ const MXMFLOAT3 *pPoints, _In_reads_(spanCount) const uint32_t *pSpanFirst,
+                                _In_reads_(spanCount) const uint32_t *pSpanCount, size_t spanCount,
+                                _Out_writes_(spanCount) MXMORIENTEDBOX *pBoxes, uint32_t sweeps = MXM_EIGEN_DEFAULT_SWEEPS)
+{
+  std::vector<MXMFLOAT3X3> covariances(spanCount);
+  for (size_t i = 0; i < spanCount; ++i)
+    covariances[i] = MXMPointStatsCovariance(MXMComputePointStats(pPoints + pSpanFirst[i], pSpanCount[i]));
+
+  std::vector<MXMFLOAT3> eigenvalues(spanCount);
+  std::vector<MXMFLOAT3X3> eigenvectors(spanCount);
+  if (spanCount)
+    MXMEigenSymmetric3x3(&covariances[0], spanCount, &eigenvalues[0], &eigenvectors[0], sweeps);
+
+  for (size_t i = 0; i < spanCount; ++i)
+    pBoxes[i] = MXMFitOrientedBoxAxes(pPoints + pSpanFirst[i], pSpanCount[i], MXMOrientedBoxAxes(eigenvectors[i]));
+}
+
+} //namespace DirectX
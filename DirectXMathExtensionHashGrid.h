@@ -0,0 +1,318 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Spatial hash grid for neighbor queries over MXMFLOAT3 positions.
+
+  Positions are quantized to MXMINT3 cells of a uniform cell size, four at a
+  time. The cells are hashed into a power of two table and the points are
+  sorted into the table buckets with a counting sort, so every bucket is one
+  contiguous range. The sorted positions are kept in SoA layout and radius
+  queries test four candidates per XMVECTOR comparison.
+
+  A radius query visits every cell overlapping the query sphere, which are the
+  27 cells around the center for radii up to the cell size. Different cells
+  hashing into the same bucket are visited only once and points of other
+  cells in a visited bucket are rejected by the distance test. For larger
+  radii the buckets of all overlapped cells are sorted to drop duplicates.
+
+  Rebuild the grid whenever the positions changed. Large grids can be built
+  from several threads with the chunk functions, a counting sort like the
+  chunked MXMRadixSort: every chunk of positions is quantized and counted
+  into its own bucket histogram, the histograms are turned into scatter
+  offsets and every chunk is scattered; chunks are independent in both
+  steps. Queries only read the grid and can run concurrently.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMHASHGRID grid;
+    MXMHashGridBuild(grid, &positions[0], count, interactionRadius);
+
+    // or chunked, the iterations of both chunk loops may run concurrently
+    MXMHashGridBegin(grid, count, interactionRadius);
+    std::vector<uint32_t> histograms(chunkCount * grid.BucketCount());
+    for (size_t c = 0; c < chunkCount; ++c)
+      MXMHashGridHistogram(grid, &positions[0], chunkFirst[c], chunkSize[c], &histograms[c * grid.BucketCount()]);
+    MXMHashGridPrefix(grid, &histograms[0], chunkCount);
+    for (size_t c = 0; c < chunkCount; ++c)
+      MXMHashGridScatter(grid, &positions[0], chunkFirst[c], chunkSize[c], &histograms[c * grid.BucketCount()]);
+
+    std::vector<uint32_t> neighbors;
+    MXMHashGridQueryRadius(grid, positions[i], interactionRadius, neighbors);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace DirectX
+{
+
+struct MXMHASHGRID
+{
+  float cellSize;
+  float invCellSize;
+  uint32_t bucketMask;               // bucket count - 1, bucket count is a power of two
+
+  std::vector<uint32_t> bucketStart; // first sorted point of every bucket, bucket count + 1 entries
+  std::vector<uint32_t> indices;     // original index of every sorted point
+  std::vector<float> x, y, z;        // sorted positions, padded by three entries for 4-wide loads
+
+  std::vector<MXMINT3> cells;        // cell of every point in original order
+  std::vector<uint32_t> buckets;     // bucket of every point in original order
+
+  MXMHASHGRID() : cellSize(1.0f), invCellSize(1.0f), bucketMask(0) {}
+
+  size_t Size() const { return indices.size(); }
+  uint32_t BucketCount() const { return bucketMask + 1; }
+};
+
+//------------------------------------------------------------------------------
+// Cells
+
+__MXM_INLINE uint32_t MXMHashGridHash(int32_t x, int32_t y, int32_t z)
+{
+  return ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+}
+
+// Quantizes count positions to their grid cells, four positions per step.
+inline void MXMHashGridQuantize(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count, float invCellSize,
+                                _Out_writes_(count) MXMINT3 *pCells)
+{
+  const XMVECTOR scale = XMVectorReplicate(invCellSize);
+  size_t i = 0;
+  for (; i < count; i += 4) {
+    MXMFLOAT3 tail[4];
+    const MXMFLOAT3 *positions = pPositions + i;
+    if (i + 4 > count) {
+      for (size_t k = 0; k < 4; ++k)
+        tail[k] = pPositions[i + k < count ? i + k : count - 1];
+      positions = tail;
+    }
+
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(positions, x, y, z);
+    x = XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(x, scale)), 0);
+    y = XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(y, scale)), 0);
+    z = XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(z, scale)), 0);
+
+    uint32_t cellX[4], cellY[4], cellZ[4];
+    XMStoreInt4(cellX, x);
+    XMStoreInt4(cellY, y);
+    XMStoreInt4(cellZ, z);
+    for (size_t k = 0; k < 4 && i + k < count; ++k)
+      pCells[i + k] = MXMINT3((int32_t)cellX[k], (int32_t)cellY[k], (int32_t)cellZ[k]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Build
+
+// Starts a build over count positions: picks the bucket count, the next power
+// of two of at least twice the point count unless given, and sizes all arrays.
+inline void MXMHashGridBegin(MXMHASHGRID &grid, size_t count, float cellSize, uint32_t bucketCount = 0)
+{
+  grid.cellSize = cellSize;
+  grid.invCellSize = 1.0f / cellSize;
+
+  if (!bucketCount)
+    bucketCount = (uint32_t)(count * 2);
+  uint32_t powerOfTwo = 1;
+  while (powerOfTwo < bucketCount)
+    powerOfTwo <<= 1;
+  grid.bucketMask = powerOfTwo - 1;
+
+  grid.cells.resize(count);
+  grid.buckets.resize(count);
+  grid.bucketStart.assign(powerOfTwo + 1, 0);
+  grid.indices.resize(count);
+  grid.x.resize(count + 3);
+  grid.y.resize(count + 3);
+  grid.z.resize(count + 3);
+  for (size_t i = count; i < count + 3; ++i)
+    grid.x[i] = grid.y[i] = grid.z[i] = 0.0f;
+}
+
+// Quantizes and hashes the positions [first, first + count) and counts them
+// per bucket into pHistogram, which has BucketCount() entries.
+inline void MXMHashGridHistogram(MXMHASHGRID &grid, _In_reads_(_Inexpressible_(first + count)) const MXMFLOAT3 *pPositions,
+                                 size_t first, size_t count, _Out_writes_(_Inexpressible_(grid.BucketCount())) uint32_t *pHistogram)
+{
+  memset(pHistogram, 0, grid.BucketCount() * sizeof(uint32_t));
+  if (!count)
+    return;
+
+  MXMHashGridQuantize(pPositions + first, count, grid.invCellSize, &grid.cells[first]);
+  for (size_t i = first; i < first + count; ++i) {
+    const MXMINT3 &cell = grid.cells[i];
+    const uint32_t bucket = MXMHashGridHash(cell.x, cell.y, cell.z) & grid.bucketMask;
+    grid.buckets[i] = bucket;
+    ++pHistogram[bucket];
+  }
+}
+
+// Turns the histograms of chunkCount consecutive chunks into the scatter
+// offsets of every chunk and fills the bucket ranges of the grid.
+inline void MXMHashGridPrefix(MXMHASHGRID &grid, _Inout_updates_(_Inexpressible_(chunkCount * grid.BucketCount())) uint32_t *pHistograms,
+                              size_t chunkCount)
+{
+  const uint32_t bucketCount = grid.BucketCount();
+  uint32_t total = 0;
+  for (uint32_t b = 0; b < bucketCount; ++b) {
+    grid.bucketStart[b] = total;
+    for (size_t c = 0; c < chunkCount; ++c) {
+      uint32_t &entry = pHistograms[c * bucketCount + b];
+      const uint32_t chunkBucketCount = entry;
+      entry = total;
+      total += chunkBucketCount;
+    }
+  }
+  grid.bucketStart[bucketCount] = total;
+}
+
+// Sorts the positions [first, first + count) into their buckets at the
+// offsets of their chunk.
+inline void MXMHashGridScatter(MXMHASHGRID &grid, _In_reads_(_Inexpressible_(first + count)) const MXMFLOAT3 *pPositions,
+                               size_t first, size_t count, _Inout_updates_(_Inexpressible_(grid.BucketCount())) uint32_t *pOffsets)
+{
+  for (size_t i = first; i < first + count; ++i) {
+    const uint32_t target = pOffsets[grid.buckets[i]]++;
+    grid.indices[target] = (uint32_t)i;
+    grid.x[target] = pPositions[i].x;
+    grid.y[target] = pPositions[i].y;
+    grid.z[target] = pPositions[i].z;
+  }
+}
+
+// Builds the grid over count positions on the calling thread. The bucket
+// count is the next power of two of at least twice the point count unless
+// given.
+inline void MXMHashGridBuild(MXMHASHGRID &grid, _In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                             float cellSize, uint32_t bucketCount = 0)
+{
+  MXMHashGridBegin(grid, count, cellSize, bucketCount);
+  std::vector<uint32_t> offsets(grid.BucketCount());
+  MXMHashGridHistogram(grid, pPositions, 0, count, &offsets[0]);
+  MXMHashGridPrefix(grid, &offsets[0], 1);
+  MXMHashGridScatter(grid, pPositions, 0, count, &offsets[0]);
+}
+
+//------------------------------------------------------------------------------
+// Queries
+
+// Tests the sorted points [first, first + count) against a sphere and appends
+// the original indices of the points inside it.
+inline void XM_CALLCONV MXMHashGridTestRange(const MXMHASHGRID &grid, uint32_t first, uint32_t count,
+                                             FXMVECTOR centerX, FXMVECTOR centerY, FXMVECTOR centerZ, GXMVECTOR radiusSq,
+                                             std::vector<uint32_t> &results)
+{
+  static const uint32_t laneMasks[5] = { 0x0, 0x1, 0x3, 0x7, 0xF };
+  for (uint32_t i = first; i < first + count; i += 4) {
+    XMVECTOR dx = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&grid.x[i])), centerX);
+    XMVECTOR dy = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&grid.y[i])), centerY);
+    XMVECTOR dz = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&grid.z[i])), centerZ);
+    XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+    const uint32_t remaining = first + count - i;
+    uint32_t mask = MXMVectorMoveMask(XMVectorLessOrEqual(distSq, radiusSq)) & laneMasks[remaining < 4 ? remaining : 4];
+    for (; mask; mask &= mask - 1) {
+      uint32_t lane = 0;
+      while (!(mask & (1u << lane)))
+        ++lane;
+      results.push_back(grid.indices[i + lane]);
+    }
+  }
+}
+
+// Appends the original indices of all points within radius of center. The
+// order of the results is unspecified.
+inline void XM_CALLCONV MXMHashGridQueryRadius(const MXMHASHGRID &grid, FXMVECTOR center, float radius,
+                                               std::vector<uint32_t> &results)
+{
+  if (grid.indices.empty())
+    return;
+
+  const XMVECTOR scale = XMVectorReplicate(grid.invCellSize);
+  const XMVECTOR r = XMVectorReplicate(radius);
+  MXMINT3 cellMin = XMVectorFloor(XMVectorMultiply(XMVectorSubtract(center, r), scale));
+  MXMINT3 cellMax = XMVectorFloor(XMVectorMultiply(XMVectorAdd(center, r), scale));
+
+  const XMVECTOR centerX = XMVectorSplatX(center);
+  const XMVECTOR centerY = XMVectorSplatY(center);
+  const XMVECTOR centerZ = XMVectorSplatZ(center);
+  const XMVECTOR radiusSq = XMVectorReplicate(radius * radius);
+
+  const size_t cellCount = (size_t)(cellMax.x - cellMin.x + 1) * (size_t)(cellMax.y - cellMin.y + 1) *
+                           (size_t)(cellMax.z - cellMin.z + 1);
+
+  // radii up to the cell size visit at most 27 cells, a linear search finds
+  // the buckets already visited
+  if (cellCount <= 27) {
+    uint32_t visited[27];
+    uint32_t visitedCount = 0;
+    for (int32_t cz = cellMin.z; cz <= cellMax.z; ++cz) {
+      for (int32_t cy = cellMin.y; cy <= cellMax.y; ++cy) {
+        for (int32_t cx = cellMin.x; cx <= cellMax.x; ++cx) {
+          const uint32_t bucket = MXMHashGridHash(cx, cy, cz) & grid.bucketMask;
+          const uint32_t first = grid.bucketStart[bucket];
+          const uint32_t count = grid.bucketStart[bucket + 1] - first;
+          if (!count)
+            continue;
+
+          bool seen = false;
+          for (uint32_t v = 0; v < visitedCount && !seen; ++v)
+            seen = visited[v] == bucket;
+          if (seen)
+            continue;
+          visited[visitedCount++] = bucket;
+
+          MXMHashGridTestRange(grid, first, count, centerX, centerY, centerZ, radiusSq, results);
+        }
+      }
+    }
+    return;
+  }
+
+  // larger radii collect the non-empty buckets of all cells and remove the
+  // duplicates by sorting
+  std::vector<uint32_t> buckets;
+  buckets.reserve(cellCount);
+  for (int32_t cz = cellMin.z; cz <= cellMax.z; ++cz) {
+    for (int32_t cy = cellMin.y; cy <= cellMax.y; ++cy) {
+      for (int32_t cx = cellMin.x; cx <= cellMax.x; ++cx) {
+        const uint32_t bucket = MXMHashGridHash(cx, cy, cz) & grid.bucketMask;
+        if (grid.bucketStart[bucket + 1] != grid.bucketStart[bucket])
+          buckets.push_back(bucket);
+      }
+    }
+  }
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+  for (size_t b = 0; b < buckets.size(); ++b) {
+    const uint32_t first = grid.bucketStart[buckets[b]];
+    MXMHashGridTestRange(grid, first, grid.bucketStart[buckets[b] + 1] - first, centerX, centerY, centerZ, radiusSq,
+                         results);
+  }
+}
+
+// Radius queries for count query points, e.g. all particles of a simulation.
+// The neighbors of query i are pNeighbors[pNeighborStart[i], pNeighborStart[i + 1]).
+inline void MXMHashGridQueryRadius(const MXMHASHGRID &grid, _In_reads_(count) const MXMFLOAT3 *pCenters, size_t count,
+                                   float radius, std::vector<uint32_t> &neighborStart, std::vector<uint32_t> &neighbors)
+{
+  neighborStart.resize(count + 1);
+  neighbors.clear();
+  for (size_t i = 0; i < count; ++i) {
+    neighborStart[i] = (uint32_t)neighbors.size();
+    MXMHashGridQueryRadius(grid, pCenters[i], radius, neighbors);
+  }
+  neighborStart[count] = (uint32_t)neighbors.size();
+}
+
+} //namespace DirectX
@@ -0,0 +1,145 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Building instance buffers from the world matrices of visible objects.
+
+  After culling, the MXMFLOAT4X4A world matrices of the visible objects are
+  gathered through their index list, transposed in registers into the column
+  layout shaders expect and written to the upload buffer with non-temporal
+  stores, which bypass the cache the buffer is never read through again.
+  The matrix a few entries ahead in the index list is prefetched while the
+  current one is converted.
+
+    3x4 layout  three float4 per instance, the first three columns of the
+                world matrix (the fourth column of an affine matrix is 0001)
+    4x4 layout  four float4 per instance, the full transposed matrix
+
+  The destination has to be aligned to MXM_INSTANCE_CACHE_LINE bytes. To
+  build from several threads, MXMInstanceRange splits the instances into
+  ranges whose outputs start on cache line boundaries, so no two threads
+  write to the same cache line. Every build call finishes its streaming
+  stores with a fence before it returns.
+
+//------------------------------------------------------------------------------
+// Example
+
+    // upload buffer of visibleCount * 3 float4, 64 byte aligned
+    MXMBuildInstances3x4(&worlds[0], &visible[0], 0, visibleCount, pUpload);
+
+    // or from rangeCount threads
+    size_t first, rangeSize;
+    MXMInstanceRange(visibleCount, MXM_INSTANCE_STRIDE_3X4, rangeIndex, rangeCount, first, rangeSize);
+    MXMBuildInstances3x4(&worlds[0], &visible[0], first, rangeSize, pUpload);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+namespace DirectX
+{
+
+#define MXM_INSTANCE_CACHE_LINE        64
+#define MXM_INSTANCE_STRIDE_3X4        48  // bytes per instance
+#define MXM_INSTANCE_STRIDE_4X4        64
+#define MXM_INSTANCE_PREFETCH_DISTANCE 8   // instances
+
+//------------------------------------------------------------------------------
+// Memory helpers
+
+__MXM_INLINE void MXMInstancePrefetch(_In_ const void *pSource)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  // a 16 byte aligned matrix may straddle two cache lines
+  _mm_prefetch(static_cast<const char*>(pSource), _MM_HINT_T0);
+  _mm_prefetch(static_cast<const char*>(pSource) + sizeof(XMFLOAT4X4A) - 1, _MM_HINT_T0);
+#else
+  (void)pSource;
+#endif
+}
+
+__MXM_INLINE void XM_CALLCONV MXMInstanceStream(_Out_writes_(1) MXMFLOAT4A *pDestination, FXMVECTOR v)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  _mm_stream_ps(&pDestination->x, v);
+#else
+  XMStoreFloat4A(pDestination, v);
+#endif
+}
+
+__MXM_INLINE void MXMInstanceFence()
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  _mm_sfence();
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Ranges
+
+// Splits count instances of stride bytes into rangeCount ranges and returns
+// range rangeIndex. The first instance of every range starts on a cache line,
+// e.g. every fourth instance of the 3x4 layout.
+__MXM_INLINE void MXMInstanceRange(size_t count, size_t stride, size_t rangeIndex, size_t rangeCount,
+                                   size_t &first, size_t &rangeSize)
+{
+  // smallest instance count that fills whole cache lines
+  size_t granularity = 1;
+  while ((granularity * stride) % MXM_INSTANCE_CACHE_LINE)
+    ++granularity;
+
+  const size_t groups = (count + granularity - 1) / granularity;
+  const size_t begin = groups * rangeIndex / rangeCount * granularity;
+  const size_t end = groups * (rangeIndex + 1) / rangeCount * granularity;
+  first = begin < count ? begin : count;
+  rangeSize = (end < count ? end : count) - first;
+}
+
+//------------------------------------------------------------------------------
+// Building
+
+// Writes the transposed world matrices of the visible objects [first,
+// first + count) to pDestination[first * 3, (first + count) * 3).
+inline void MXMBuildInstances3x4(_In_ const MXMFLOAT4X4A *pWorlds,
+                                 _In_reads_(_Inexpressible_(first + count)) const uint32_t *pVisible,
+                                 size_t first, size_t count,
+                                 _Out_writes_(_Inexpressible_((first + count) * 3)) MXMFLOAT4A *pDestination)
+{
+  const size_t end = first + count;
+  for (size_t i = first; i < end; ++i) {
+    if (i + MXM_INSTANCE_PREFETCH_DISTANCE < end)
+      MXMInstancePrefetch(&pWorlds[pVisible[i + MXM_INSTANCE_PREFETCH_DISTANCE]]);
+
+    const XMMATRIX m = XMMatrixTranspose(pWorlds[pVisible[i]]);
+    MXMFLOAT4A *pInstance = pDestination + i * 3;
+    MXMInstanceStream(pInstance, m.r[0]);
+    MXMInstanceStream(pInstance + 1, m.r[1]);
+    MXMInstanceStream(pInstance + 2, m.r[2]);
+  }
+  MXMInstanceFence();
+}
+
+// Writes the transposed world matrices of the visible objects [first,
+// first + count) to pDestination[first * 4, (first + count) * 4).
+inline void MXMBuildInstances4x4(_In_ const MXMFLOAT4X4A *pWorlds,
+                                 _In_reads_(_Inexpressible_(first + count)) const uint32_t *pVisible,
+                                 size_t first, size_t count,
+                                 _Out_writes_(_Inexpressible_((first + count) * 4)) MXMFLOAT4A *pDestination)
+{
+  const size_t end = first + count;
+  for (size_t i = first; i < end; ++i) {
+    if (i + MXM_INSTANCE_PREFETCH_DISTANCE < end)
+      MXMInstancePrefetch(&pWorlds[pVisible[i + MXM_INSTANCE_PREFETCH_DISTANCE]]);
+
+    const XMMATRIX m = XMMatrixTranspose(pWorlds[pVisible[i]]);
+    MXMFLOAT4A *pInstance = pDestination + i * 4;
+    MXMInstanceStream(pInstance, m.r[0]);
+    MXMInstanceStream(pInstance + 1, m.r[1]);
+    MXMInstanceStream(pInstance + 2, m.r[2]);
+    MXMInstanceStream(pInstance + 3, m.r[3]);
+  }
+  MXMInstanceFence();
+}
+
+} //namespace DirectX
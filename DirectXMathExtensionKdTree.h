@@ -0,0 +1,495 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  kd-tree over MXMFLOAT3 point clouds with k-nearest-neighbor queries.
+
+  The tree is built top down by splitting every node at the median of its
+  widest axis with std::nth_element, until leaves hold at most leafSize
+  points. Afterwards the points are stored in SoA layout in tree order, so a
+  leaf is one contiguous range and is scanned four points at a time.
+
+  The k nearest neighbors of a query are kept in a bounded priority queue,
+  a list sorted by distance in the output arrays. Its last entry is the
+  current search radius that prunes further nodes.
+
+  Batched queries handle four query points per traversal, stored as SoA
+  XMVECTORs. A node is visited once for all four queries and each point of a
+  leaf is tested against all four queries with one set of XMVECTOR
+  operations, which shares the cache misses of the traversal.
+
+  The build can be distributed over the caller's threads:
+  MXMKdTreeBuildBegin makes the top level median splits and leaves the ranges
+  below them as tasks, MXMKdTreeBuildSubtree builds the subtree of one task,
+  tasks are independent, and MXMKdTreeBuildEnd stitches the subtrees
+  together. The tree does not depend on the number of tasks.
+
+  Queries only read the tree and can run concurrently.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMKDTREE tree;
+    MXMKdTreeBuild(tree, &points[0], pointCount);
+
+    uint32_t indices[8];
+    float distancesSq[8];
+    uint32_t found = MXMKdTreeNearest(tree, query, 8, indices, distancesSq);
+
+    // k neighbors for every point of a cloud
+    MXMKdTreeNearest(tree, &queries[0], queryCount, k, &allIndices[0], &allDistancesSq[0]);
+
+    // or built with a job system
+    MXMKDBUILD build;
+    MXMKdTreeBuildBegin(build, tree, &points[0], pointCount, 4 * workerCount);
+    for (size_t t = 0; t < build.TaskCount(); ++t)   // distributed across threads
+      MXMKdTreeBuildSubtree(build, t);
+    MXMKdTreeBuildEnd(build);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+
+namespace DirectX
+{
+
+#define MXM_KDTREE_LEAF      3u
+#define MXM_KDTREE_NONE      0xFFFFFFFFu
+#define MXM_KDTREE_MAX_DEPTH 64
+
+// Inner nodes split at split along axis into the children first (below) and
+// second (above). Leaves have axis == MXM_KDTREE_LEAF and hold the sorted
+// points [first, first + second).
+struct MXMKDNODE
+{
+  float split;
+  uint32_t axis;
+  uint32_t first;
+  uint32_t second;
+};
+
+struct MXMKDTREE
+{
+  std::vector<MXMKDNODE> nodes;      // nodes[0] is the root
+  std::vector<uint32_t> indices;     // original index of every sorted point
+  std::vector<float> x, y, z;        // sorted points, padded by three entries for 4-wide loads
+};
+
+//------------------------------------------------------------------------------
+// Build
+
+struct MXMKDAXISLESS
+{
+  const float *pCoordinates;
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    return pCoordinates[a] < pCoordinates[b];
+  }
+};
+
+// Subtree left for MXMKdTreeBuildSubtree, built over the sorted points
+// [first, first + count) and then stitched in place of node.
+struct MXMKDBUILDTASK
+{
+  uint32_t first, count, depth;
+  uint32_t node;                     // placeholder node in MXMKDBUILD::nodes
+  std::vector<MXMKDNODE> nodes;      // subtree, nodes[0] is its root
+};
+
+struct MXMKDBUILDER
+{
+  const float *pCoordinates[3];      // SoA coordinates in original order
+  uint32_t leafSize;
+  std::vector<MXMKDNODE> *pNodes;
+  std::vector<uint32_t> *pIndices;
+  std::vector<MXMKDBUILDTASK> *pTasks; // if set, ranges of at most taskSize points become tasks
+  uint32_t taskSize;
+
+  MXMKDBUILDER() : leafSize(1), pNodes(NULL), pIndices(NULL), pTasks(NULL), taskSize(0) {
+    pCoordinates[0] = pCoordinates[1] = pCoordinates[2] = NULL;
+  }
+
+  uint32_t Build(uint32_t first, uint32_t count, uint32_t depth) {
+    std::vector<MXMKDNODE> &nodes = *pNodes;
+    std::vector<uint32_t> &indices = *pIndices;
+    const uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(MXMKDNODE());
+
+    const bool leaf = count <= leafSize || depth >= MXM_KDTREE_MAX_DEPTH;
+    if (pTasks && (leaf || count <= taskSize)) {
+      MXMKDBUILDTASK task;
+      task.first = first;
+      task.count = count;
+      task.depth = depth;
+      task.node = index;
+      pTasks->push_back(task);
+      return index;
+    }
+
+    if (leaf) {
+      nodes[index].split = 0.0f;
+      nodes[index].axis = MXM_KDTREE_LEAF;
+      nodes[index].first = first;
+      nodes[index].second = count;
+      return index;
+    }
+
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t a = 0; a < 3; ++a) {
+      const float *c = pCoordinates[a];
+      for (uint32_t i = first; i < first + count; ++i) {
+        boundsMin[a] = std::min(boundsMin[a], c[indices[i]]);
+        boundsMax[a] = std::max(boundsMax[a], c[indices[i]]);
+      }
+    }
+    const float extent[3] = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+    const uint32_t axis = extent[0] >= extent[1] ? (extent[0] >= extent[2] ? 0 : 2) : (extent[1] >= extent[2] ? 1 : 2);
+
+    const uint32_t half = count / 2;
+    MXMKDAXISLESS less = { pCoordinates[axis] };
+    std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count, less);
+
+    nodes[index].split = pCoordinates[axis][indices[first + half]];
+    nodes[index].axis = axis;
+    const uint32_t below = Build(first, half, depth + 1);
+    const uint32_t above = Build(first + half, count - half, depth + 1);
+    nodes[index].first = below;
+    nodes[index].second = above;
+    return index;
+  }
+};
+
+// State of a kd-tree build split into tasks.
+struct MXMKDBUILD
+{
+  MXMKDTREE *pTree;
+  uint32_t leafSize;
+  std::vector<float> coordinates;    // SoA coordinates in original order
+  std::vector<MXMKDNODE> nodes;      // nodes above the tasks
+  std::vector<MXMKDBUILDTASK> tasks;
+
+  MXMKDBUILD() : pTree(NULL), leafSize(1) {}
+
+  size_t TaskCount() const { return tasks.size(); }
+
+  const float *Coordinates(uint32_t axis) const {
+    return &coordinates[0] + (coordinates.size() / 3) * axis;
+  }
+
+  // Appends node and its subtree to the tree in depth first order, with the
+  // subtree of a task in place of its placeholder. Returns the new index.
+  uint32_t Stitch(uint32_t node, const std::vector<uint32_t> &nodeTasks, std::vector<MXMKDNODE> &out) const {
+    const uint32_t index = (uint32_t)out.size();
+    if (nodeTasks[node] != MXM_KDTREE_NONE) {
+      const std::vector<MXMKDNODE> &subtree = tasks[nodeTasks[node]].nodes;
+      for (size_t n = 0; n < subtree.size(); ++n) {
+        MXMKDNODE copy = subtree[n];
+        if (copy.axis != MXM_KDTREE_LEAF) {
+          copy.first += index;
+          copy.second += index;
+        }
+        out.push_back(copy);
+      }
+      return index;
+    }
+    out.push_back(nodes[node]);
+    const uint32_t below = Stitch(nodes[node].first, nodeTasks, out);
+    const uint32_t above = Stitch(nodes[node].second, nodeTasks, out);
+    out[index].first = below;
+    out[index].second = above;
+    return index;
+  }
+};
+
+// Starts a build: copies the points into SoA layout and makes the top level
+// median splits until every remaining range holds at most count / taskCount
+// points. Each of these ranges becomes a task for MXMKdTreeBuildSubtree.
+inline void MXMKdTreeBuildBegin(MXMKDBUILD &build, MXMKDTREE &tree, _In_reads_(count) const MXMFLOAT3 *pPoints,
+                                size_t count, size_t taskCount, uint32_t leafSize = 8)
+{
+  build.pTree = &tree;
+  build.leafSize = leafSize ? leafSize : 1;
+  build.nodes.clear();
+  build.tasks.clear();
+
+  tree.nodes.clear();
+  tree.indices.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    tree.indices[i] = (uint32_t)i;
+
+  // coordinates in SoA layout for cache friendly partitioning
+  build.coordinates.resize(count * 3 + 1);
+  for (size_t i = 0; i < count; ++i) {
+    build.coordinates[i] = pPoints[i].x;
+    build.coordinates[count + i] = pPoints[i].y;
+    build.coordinates[count * 2 + i] = pPoints[i].z;
+  }
+
+  // far away padding, its distances are never below the search radius
+  tree.x.resize(count + 3);
+  tree.y.resize(count + 3);
+  tree.z.resize(count + 3);
+  for (size_t i = count; i < count + 3; ++i)
+    tree.x[i] = tree.y[i] = tree.z[i] = FLT_MAX;
+
+  MXMKDBUILDER builder;
+  for (uint32_t a = 0; a < 3; ++a)
+    builder.pCoordinates[a] = build.Coordinates(a);
+  builder.leafSize = build.leafSize;
+  builder.pNodes = &build.nodes;
+  builder.pIndices = &tree.indices;
+  builder.pTasks = &build.tasks;
+  builder.taskSize = (uint32_t)(taskCount > 1 ? count / taskCount : count);
+  builder.Build(0, (uint32_t)count, 0);
+}
+
+// Builds the subtree of one task and stores its points in tree order.
+// Different tasks may be built concurrently.
+inline void MXMKdTreeBuildSubtree(MXMKDBUILD &build, size_t task)
+{
+  MXMKDBUILDTASK &t = build.tasks[task];
+  MXMKDTREE &tree = *build.pTree;
+
+  MXMKDBUILDER builder;
+  for (uint32_t a = 0; a < 3; ++a)
+    builder.pCoordinates[a] = build.Coordinates(a);
+  builder.leafSize = build.leafSize;
+  builder.pNodes = &t.nodes;
+  builder.pIndices = &tree.indices;
+  builder.Build(t.first, t.count, t.depth);
+
+  for (uint32_t i = t.first; i < t.first + t.count; ++i) {
+    tree.x[i] = builder.pCoordinates[0][tree.indices[i]];
+    tree.y[i] = builder.pCoordinates[1][tree.indices[i]];
+    tree.z[i] = builder.pCoordinates[2][tree.indices[i]];
+  }
+}
+
+// Stitches the subtrees of all tasks below the top level splits. The nodes
+// end up in the same depth first order as with a single task.
+inline void MXMKdTreeBuildEnd(MXMKDBUILD &build)
+{
+  std::vector<uint32_t> nodeTasks(build.nodes.size(), MXM_KDTREE_NONE);
+  for (size_t i = 0; i < build.tasks.size(); ++i)
+    nodeTasks[build.tasks[i].node] = (uint32_t)i;
+
+  MXMKDTREE &tree = *build.pTree;
+  tree.nodes.reserve(build.nodes.size());
+  build.Stitch(0, nodeTasks, tree.nodes);
+
+  build.nodes.clear();
+  build.tasks.clear();
+  std::vector<float>().swap(build.coordinates);
+}
+
+// Builds the tree on the calling thread.
+inline void MXMKdTreeBuild(MXMKDTREE &tree, _In_reads_(count) const MXMFLOAT3 *pPoints, size_t count, uint32_t leafSize = 8)
+{
+  MXMKDBUILD build;
+  MXMKdTreeBuildBegin(build, tree, pPoints, count, 1, leafSize);
+  for (size_t t = 0; t < build.TaskCount(); ++t)
+    MXMKdTreeBuildSubtree(build, t);
+  MXMKdTreeBuildEnd(build);
+}
+
+//------------------------------------------------------------------------------
+// Bounded priority queue
+
+// Inserts a candidate into a list of k neighbors sorted by distance, dropping
+// the farthest one. The caller makes sure distanceSq < pDistancesSq[k - 1].
+__MXM_INLINE void MXMKnnInsert(_Inout_updates_(k) uint32_t *pIndices, _Inout_updates_(k) float *pDistancesSq, uint32_t k,
+                               uint32_t index, float distanceSq)
+{
+  uint32_t i = k - 1;
+  for (; i > 0 && pDistancesSq[i - 1] > distanceSq; --i) {
+    pIndices[i] = pIndices[i - 1];
+    pDistancesSq[i] = pDistancesSq[i - 1];
+  }
+  pIndices[i] = index;
+  pDistancesSq[i] = distanceSq;
+}
+
+//------------------------------------------------------------------------------
+// Single queries
+
+// Finds the k nearest points to point. pIndices and pDistancesSq receive the
+// original indices and squared distances sorted by distance, missing
+// neighbors are MXM_KDTREE_NONE and FLT_MAX. Returns the number found.
+inline uint32_t XM_CALLCONV MXMKdTreeNearest(const MXMKDTREE &tree, FXMVECTOR point, uint32_t k,
+                                             _Out_writes_(k) uint32_t *pIndices, _Out_writes_(k) float *pDistancesSq)
+{
+  for (uint32_t i = 0; i < k; ++i) {
+    pIndices[i] = MXM_KDTREE_NONE;
+    pDistancesSq[i] = FLT_MAX;
+  }
+  if (!k || tree.nodes.empty())
+    return 0;
+
+  XMFLOAT3 p;
+  XMStoreFloat3(&p, point);
+  const XMVECTOR px = XMVectorSplatX(point);
+  const XMVECTOR py = XMVectorSplatY(point);
+  const XMVECTOR pz = XMVectorSplatZ(point);
+
+  uint32_t stackNode[MXM_KDTREE_MAX_DEPTH + 1];
+  float stackBound[MXM_KDTREE_MAX_DEPTH + 1];
+  uint32_t stackSize = 0;
+  stackNode[stackSize] = 0;
+  stackBound[stackSize++] = 0.0f;
+
+  while (stackSize) {
+    --stackSize;
+    if (stackBound[stackSize] >= pDistancesSq[k - 1])
+      continue;
+
+    uint32_t n = stackNode[stackSize];
+    // descend to the leaf of the query, pushing the far sides
+    while (tree.nodes[n].axis != MXM_KDTREE_LEAF) {
+      const MXMKDNODE &node = tree.nodes[n];
+      const float d = (&p.x)[node.axis] - node.split;
+      stackNode[stackSize] = d < 0.0f ? node.second : node.first;
+      stackBound[stackSize++] = d * d;
+      n = d < 0.0f ? node.first : node.second;
+    }
+
+    const MXMKDNODE &leaf = tree.nodes[n];
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.second; i += 4) {
+      XMVECTOR dx = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&tree.x[i])), px);
+      XMVECTOR dy = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&tree.y[i])), py);
+      XMVECTOR dz = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&tree.z[i])), pz);
+      XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+      uint32_t mask = MXMVectorMoveMask(XMVectorLess(distSq, XMVectorReplicate(pDistancesSq[k - 1])));
+      if (!mask)
+        continue;
+
+      float distances[4];
+      XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(distances), distSq);
+      for (uint32_t lane = 0; lane < 4 && i + lane < leaf.first + leaf.second; ++lane) {
+        if ((mask & (1u << lane)) && distances[lane] < pDistancesSq[k - 1])
+          MXMKnnInsert(pIndices, pDistancesSq, k, tree.indices[i + lane], distances[lane]);
+      }
+    }
+  }
+
+  uint32_t found = 0;
+  while (found < k && pIndices[found] != MXM_KDTREE_NONE)
+    ++found;
+  return found;
+}
+
+//------------------------------------------------------------------------------
+// Batched queries
+
+// k nearest neighbors of four query points in SoA layout, traversing the tree
+// once for all of them. pIndices and pDistancesSq hold k entries per query.
+inline void XM_CALLCONV MXMKdTreeNearest4(const MXMKDTREE &tree, FXMVECTOR queryX, FXMVECTOR queryY, FXMVECTOR queryZ,
+                                          uint32_t k, _Out_writes_(4 * k) uint32_t *pIndices, _Out_writes_(4 * k) float *pDistancesSq)
+{
+  for (uint32_t i = 0; i < 4 * k; ++i) {
+    pIndices[i] = MXM_KDTREE_NONE;
+    pDistancesSq[i] = FLT_MAX;
+  }
+  if (!k || tree.nodes.empty())
+    return;
+
+  XMFLOAT4 queries[3];
+  XMStoreFloat4(&queries[0], queryX);
+  XMStoreFloat4(&queries[1], queryY);
+  XMStoreFloat4(&queries[2], queryZ);
+
+  // current search radius of every query
+  XMVECTOR radiusSq = XMVectorReplicate(FLT_MAX);
+
+  // lower bounds of the squared distance of every query to a pushed node
+  uint32_t stackNode[MXM_KDTREE_MAX_DEPTH * 2 + 1];
+  XMFLOAT4 stackBound[MXM_KDTREE_MAX_DEPTH * 2 + 1];
+  uint32_t stackSize = 0;
+  stackNode[stackSize] = 0;
+  XMStoreFloat4(&stackBound[stackSize++], XMVectorZero());
+
+  while (stackSize) {
+    --stackSize;
+    XMVECTOR bound = XMLoadFloat4(&stackBound[stackSize]);
+    if (!MXMVectorMoveMask(XMVectorLess(bound, radiusSq)))
+      continue;
+
+    const MXMKDNODE &node = tree.nodes[stackNode[stackSize]];
+    if (node.axis != MXM_KDTREE_LEAF) {
+      XMVECTOR d = XMVectorSubtract(XMLoadFloat4(&queries[node.axis]), XMVectorReplicate(node.split));
+      XMVECTOR dSq = XMVectorMultiply(d, d);
+      XMVECTOR below = XMVectorLess(d, XMVectorZero());
+
+      // a child keeps the bound of the node for queries on its side
+      XMVECTOR boundBelow = XMVectorSelect(XMVectorMax(bound, dSq), bound, below);
+      XMVECTOR boundAbove = XMVectorSelect(bound, XMVectorMax(bound, dSq), below);
+
+      // the side of most queries is visited first
+      const uint32_t belowMask = MXMVectorMoveMask(below);
+      const bool belowFirst = ((belowMask & 1) + ((belowMask >> 1) & 1) + ((belowMask >> 2) & 1) + (belowMask >> 3)) >= 2;
+      stackNode[stackSize] = belowFirst ? node.second : node.first;
+      XMStoreFloat4(&stackBound[stackSize++], belowFirst ? boundAbove : boundBelow);
+      stackNode[stackSize] = belowFirst ? node.first : node.second;
+      XMStoreFloat4(&stackBound[stackSize++], belowFirst ? boundBelow : boundAbove);
+      continue;
+    }
+
+    for (uint32_t i = node.first; i < node.first + node.second; ++i) {
+      XMVECTOR dx = XMVectorSubtract(queryX, XMVectorReplicate(tree.x[i]));
+      XMVECTOR dy = XMVectorSubtract(queryY, XMVectorReplicate(tree.y[i]));
+      XMVECTOR dz = XMVectorSubtract(queryZ, XMVectorReplicate(tree.z[i]));
+      XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+      uint32_t mask = MXMVectorMoveMask(XMVectorLess(distSq, radiusSq));
+      if (!mask)
+        continue;
+
+      float distances[4];
+      XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(distances), distSq);
+      for (uint32_t q = 0; q < 4; ++q) {
+        if (mask & (1u << q))
+          MXMKnnInsert(pIndices + q * k, pDistancesSq + q * k, k, tree.indices[i], distances[q]);
+      }
+      radiusSq = XMVectorSet(pDistancesSq[k - 1], pDistancesSq[2 * k - 1], pDistancesSq[3 * k - 1], pDistancesSq[4 * k - 1]);
+    }
+  }
+}
+
+// k nearest neighbors of count query points, four per traversal. Query i
+// writes k entries to pIndices + i * k and pDistancesSq + i * k. Queries close
+// to each other share more of their traversal, so spatially sorted queries
+// (see DirectXMathExtensionMorton.h) run faster.
+inline void MXMKdTreeNearest(const MXMKDTREE &tree, _In_reads_(count) const MXMFLOAT3 *pQueries, size_t count, uint32_t k,
+                             _Out_writes_(count * k) uint32_t *pIndices, _Out_writes_(count * k) float *pDistancesSq)
+{
+  std::vector<uint32_t> tailIndices(4 * k);
+  std::vector<float> tailDistancesSq(4 * k);
+
+  for (size_t i = 0; i < count; i += 4) {
+    MXMFLOAT3 tail[4];
+    const MXMFLOAT3 *queries = pQueries + i;
+    if (i + 4 > count) {
+      for (size_t q = 0; q < 4; ++q)
+        tail[q] = pQueries[i + q < count ? i + q : count - 1];
+      queries = tail;
+    }
+
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(queries, x, y, z);
+    if (i + 4 <= count) {
+      MXMKdTreeNearest4(tree, x, y, z, k, pIndices + i * k, pDistancesSq + i * k);
+    } else if (k) {
+      MXMKdTreeNearest4(tree, x, y, z, k, &tailIndices[0], &tailDistancesSq[0]);
+      std::copy(tailIndices.begin(), tailIndices.begin() + (count - i) * k, pIndices + i * k);
+      std::copy(tailDistancesSq.begin(), tailDistancesSq.begin() + (count - i) * k, pDistancesSq + i * k);
+    }
+  }
+}
+
+} //namespace DirectX
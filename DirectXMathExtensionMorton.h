@@ -0,0 +1,242 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Morton codes (Z-order) for MXMFLOAT3 positions and spatial ordering of MXM
+  arrays by them.
+
+  Positions are quantized relative to given bounds, to 10 bits per axis for
+  30 bit codes or 21 bits per axis for 63 bit codes. The bits of the three
+  axes are interleaved as ...x1y1z1 x0y0z0, x is the highest bit of every
+  triple.
+
+  Batch encoding loads four positions at a time into SoA registers and
+  quantizes them with XMVECTOR math. For 30 bit codes the bits of all four
+  lanes are then spread with SSE2 integer shifts. Single codes and 63 bit
+  codes use BMI2 pdep when the compiler targets it (__BMI2__ or /arch:AVX2),
+  and magic-number bit spreading otherwise.
+
+  MXMMortonOrder sorts the codes with MXMRadixSort and returns the sort
+  order. Apply it to every array of the object set with MXMApplyOrder.
+
+//------------------------------------------------------------------------------
+// Example
+
+    std::vector<uint32_t> order(count);
+    MXMMortonOrder(&positions[0], count, boundsMin, boundsMax, &order[0]);
+    MXMApplyOrder(&positions[0], &order[0], count);
+    MXMApplyOrder(&velocities[0], &order[0], count);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionRadixSort.h"
+
+#include <vector>
+#include <float.h>
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__)))
+# define _MXM_BMI2_INTRINSICS_
+# include <immintrin.h>
+#endif
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Single codes
+
+// Spreads the lower 10 bits of v to every third bit.
+__MXM_INLINE uint32_t MXMMortonSpread10(uint32_t v)
+{
+#ifdef _MXM_BMI2_INTRINSICS_
+  return _pdep_u32(v, 0x09249249u);
+#else
+  v &= 0x000003FFu;
+  v = (v | (v << 16)) & 0x030000FFu;
+  v = (v | (v << 8)) & 0x0300F00Fu;
+  v = (v | (v << 4)) & 0x030C30C3u;
+  v = (v | (v << 2)) & 0x09249249u;
+  return v;
+#endif
+}
+
+// Spreads the lower 21 bits of v to every third bit.
+__MXM_INLINE uint64_t MXMMortonSpread21(uint64_t v)
+{
+#if defined(_MXM_BMI2_INTRINSICS_) && (defined(_M_X64) || defined(__x86_64__))
+  return _pdep_u64(v, 0x1249249249249249ull);
+#else
+  v &= 0x00000000001FFFFFull;
+  v = (v | (v << 32)) & 0x001F00000000FFFFull;
+  v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+  v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+  v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+  v = (v | (v << 2)) & 0x1249249249249249ull;
+  return v;
+#endif
+}
+
+__MXM_INLINE uint32_t MXMMortonEncode30(uint32_t x, uint32_t y, uint32_t z)
+{
+  return (MXMMortonSpread10(x) << 2) | (MXMMortonSpread10(y) << 1) | MXMMortonSpread10(z);
+}
+
+__MXM_INLINE uint64_t MXMMortonEncode63(uint32_t x, uint32_t y, uint32_t z)
+{
+  return (MXMMortonSpread21(x) << 2) | (MXMMortonSpread21(y) << 1) | MXMMortonSpread21(z);
+}
+
+//------------------------------------------------------------------------------
+// Batch encoding
+
+// Quantizes the coordinates of four positions in SoA layout to [0, maxValue]
+// relative to boundsMin, with scale = maxValue / (boundsMax - boundsMin).
+__MXM_INLINE void XM_CALLCONV MXMMortonQuantize4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z,
+                                                 GXMVECTOR boundsMin, HXMVECTOR scale, HXMVECTOR maxValue,
+                                                 XMVECTOR &qx, XMVECTOR &qy, XMVECTOR &qz)
+{
+  const XMVECTOR zero = XMVectorZero();
+  qx = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(x, XMVectorSplatX(boundsMin)), XMVectorSplatX(scale)), zero, maxValue);
+  qy = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(y, XMVectorSplatY(boundsMin)), XMVectorSplatY(scale)), zero, maxValue);
+  qz = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(z, XMVectorSplatZ(boundsMin)), XMVectorSplatZ(scale)), zero, maxValue);
+  qx = XMConvertVectorFloatToUInt(qx, 0);
+  qy = XMConvertVectorFloatToUInt(qy, 0);
+  qz = XMConvertVectorFloatToUInt(qz, 0);
+}
+
+// MXMMortonSpread10 for the four integer components of v.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMMortonSpread10x4(FXMVECTOR v)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+  __m128i i = _mm_castps_si128(v);
+  i = _mm_and_si128(_mm_or_si128(i, _mm_slli_epi32(i, 16)), _mm_set1_epi32(0x030000FF));
+  i = _mm_and_si128(_mm_or_si128(i, _mm_slli_epi32(i, 8)), _mm_set1_epi32(0x0300F00F));
+  i = _mm_and_si128(_mm_or_si128(i, _mm_slli_epi32(i, 4)), _mm_set1_epi32(0x030C30C3));
+  i = _mm_and_si128(_mm_or_si128(i, _mm_slli_epi32(i, 2)), _mm_set1_epi32(0x09249249));
+  return _mm_castsi128_ps(i);
+#else
+  return XMVectorSetInt(MXMMortonSpread10(XMVectorGetIntX(v)), MXMMortonSpread10(XMVectorGetIntY(v)),
+                        MXMMortonSpread10(XMVectorGetIntZ(v)), MXMMortonSpread10(XMVectorGetIntW(v)));
+#endif
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMMortonEncode30x4(FXMVECTOR qx, FXMVECTOR qy, FXMVECTOR qz)
+{
+  XMVECTOR x = MXMMortonSpread10x4(qx);
+  XMVECTOR y = MXMMortonSpread10x4(qy);
+  XMVECTOR z = MXMMortonSpread10x4(qz);
+  // shifts by one and two as integer additions
+  XMVECTOR x2 = XMVectorAddInt(x, x);
+  return XMVectorOrInt(XMVectorOrInt(XMVectorAddInt(x2, x2), XMVectorAddInt(y, y)), z);
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMMortonScale(FXMVECTOR boundsMin, FXMVECTOR boundsMax, float maxValue)
+{
+  XMVECTOR extent = XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorReplicate(1e-30f));
+  return XMVectorDivide(XMVectorReplicate(maxValue), extent);
+}
+
+// Computes 30 bit Morton codes of count positions inside the given bounds.
+// Positions outside are clamped to the bounds.
+inline void XM_CALLCONV MXMMortonCodes30(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                                         FXMVECTOR boundsMin, FXMVECTOR boundsMax, _Out_writes_(count) uint32_t *pCodes)
+{
+  const XMVECTOR scale = MXMMortonScale(boundsMin, boundsMax, 1023.0f);
+  const XMVECTOR maxValue = XMVectorReplicate(1023.0f);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(pPositions + i, x, y, z);
+    MXMMortonQuantize4(x, y, z, boundsMin, scale, maxValue, x, y, z);
+    XMStoreInt4(pCodes + i, MXMMortonEncode30x4(x, y, z));
+  }
+
+  if (i < count) {
+    MXMFLOAT3 tail[4];
+    uint32_t codes[4];
+    for (size_t k = 0; k < 4; ++k)
+      tail[k] = pPositions[i + k < count ? i + k : count - 1];
+
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(tail, x, y, z);
+    MXMMortonQuantize4(x, y, z, boundsMin, scale, maxValue, x, y, z);
+    XMStoreInt4(codes, MXMMortonEncode30x4(x, y, z));
+    for (size_t k = 0; i + k < count; ++k)
+      pCodes[i + k] = codes[k];
+  }
+}
+
+// Computes 63 bit Morton codes of count positions inside the given bounds.
+inline void XM_CALLCONV MXMMortonCodes63(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                                         FXMVECTOR boundsMin, FXMVECTOR boundsMax, _Out_writes_(count) uint64_t *pCodes)
+{
+  // 2^21 - 1 is exactly representable, the conversion truncates
+  const XMVECTOR scale = MXMMortonScale(boundsMin, boundsMax, 2097151.0f);
+  const XMVECTOR maxValue = XMVectorReplicate(2097151.0f);
+
+  for (size_t i = 0; i < count; i += 4) {
+    MXMFLOAT3 tail[4];
+    const MXMFLOAT3 *positions = pPositions + i;
+    if (i + 4 > count) {
+      for (size_t k = 0; k < 4; ++k)
+        tail[k] = pPositions[i + k < count ? i + k : count - 1];
+      positions = tail;
+    }
+
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(positions, x, y, z);
+    MXMMortonQuantize4(x, y, z, boundsMin, scale, maxValue, x, y, z);
+
+    uint32_t qx[4], qy[4], qz[4];
+    XMStoreInt4(qx, x);
+    XMStoreInt4(qy, y);
+    XMStoreInt4(qz, z);
+    for (size_t k = 0; k < 4 && i + k < count; ++k)
+      pCodes[i + k] = MXMMortonEncode63(qx[k], qy[k], qz[k]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Spatial ordering
+
+// Writes the order that sorts the positions along the Morton curve through the
+// given bounds into pOrder, to be applied with MXMApplyOrder. The 30 bit
+// codes take four sort passes at most and are precise enough for up to about
+// a million elements, the 63 bit codes are used with wide == true.
+inline void XM_CALLCONV MXMMortonOrder(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                                       FXMVECTOR boundsMin, FXMVECTOR boundsMax, _Out_writes_(count) uint32_t *pOrder,
+                                       bool wide = false)
+{
+  for (size_t i = 0; i < count; ++i)
+    pOrder[i] = (uint32_t)i;
+  if (count < 2)
+    return;
+
+  if (wide) {
+    std::vector<uint64_t> codes(count);
+    MXMMortonCodes63(pPositions, count, boundsMin, boundsMax, &codes[0]);
+    MXMRadixSort(&codes[0], pOrder, count, 63);
+  } else {
+    std::vector<uint32_t> codes(count);
+    MXMMortonCodes30(pPositions, count, boundsMin, boundsMax, &codes[0]);
+    MXMRadixSort(&codes[0], pOrder, count, 30);
+  }
+}
+
+// Same as above with the bounds computed from the positions.
+inline void MXMMortonOrder(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                           _Out_writes_(count) uint32_t *pOrder, bool wide = false)
+{
+  XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+  XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+  for (size_t i = 0; i < count; ++i) {
+    XMVECTOR p = pPositions[i];
+    boundsMin = XMVectorMin(boundsMin, p);
+    boundsMax = XMVectorMax(boundsMax, p);
+  }
+  MXMMortonOrder(pPositions, count, boundsMin, boundsMax, pOrder, wide);
+}
+
+} //namespace DirectX
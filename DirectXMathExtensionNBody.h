@@ -0,0 +1,335 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Gravitational accelerations of bodies stored as MXMFLOAT4 (position xyz,
+  mass w), a = gravity * sum(m_j * d / (|d|^2 + softening^2)^(3/2)).
+
+  The direct O(N^2) kernel works on a SoA copy of the bodies (MXMNBODYSOA).
+  Bodies are processed in blocks of MXM_NBODY_BLOCK_SIZE receivers; every
+  block walks the sources in tiles of MXM_NBODY_TILE_SIZE bodies, small
+  enough to stay in the L1 cache while all receivers of the block use them.
+  Four sources are handled per step with a reciprocal square root estimate
+  refined by one Newton-Raphson step. Pairs at distance zero (a body with
+  itself when softening is zero) contribute nothing.
+
+  For large N, MXMBARNESHUTTREE approximates far away groups of bodies by
+  their center of mass (Barnes-Hut). A cell of edge length s at distance d is
+  approximated when s < theta * d; theta = 0 gives the exact sum, 0.5 is a
+  common trade-off.
+
+  Both paths compute the accelerations of a range of bodies and only write
+  that range, so ranges can be distributed over threads.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMNBODYSOA soa;
+    MXMNBodyLoad(soa, &bodies[0], bodyCount);
+    MXMNBodyAccelerations(soa, 0, bodyCount, G, 0.01f, &accelerations[0]);
+
+    MXMBARNESHUTTREE tree;
+    MXMBarnesHutBuild(tree, &bodies[0], bodyCount);
+    MXMBarnesHutAccelerations(tree, &bodies[0], 0, bodyCount, G, 0.01f, 0.5f, &accelerations[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionReduce.h"
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+
+namespace DirectX
+{
+
+#define MXM_NBODY_TILE_SIZE          512
+#define MXM_NBODY_BLOCK_SIZE         64
+#define MXM_BARNES_HUT_MAX_DEPTH     32
+
+//------------------------------------------------------------------------------
+// Kernels
+
+// 1 / sqrt(x) from the estimate and one Newton-Raphson step.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorReciprocalSqrtNewton(FXMVECTOR x)
+{
+  const XMVECTOR estimate = XMVectorReciprocalSqrtEst(x);
+  const XMVECTOR halfX = XMVectorMultiply(x, XMVectorReplicate(0.5f));
+  const XMVECTOR square = XMVectorMultiply(estimate, estimate);
+  return XMVectorMultiply(estimate, XMVectorSubtract(XMVectorReplicate(1.5f), XMVectorMultiply(halfX, square)));
+}
+
+// Acceleration (without gravity) of position by one body (xyz, mass w).
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMNBodyInteraction(FXMVECTOR position, FXMVECTOR body, FXMVECTOR softeningSq)
+{
+  const XMVECTOR d = XMVectorSubtract(body, position);
+  const XMVECTOR distanceSq = XMVectorAdd(XMVector3Dot(d, d), softeningSq);
+  const XMVECTOR inverse = MXMVectorReciprocalSqrtNewton(distanceSq);
+  XMVECTOR s = XMVectorMultiply(XMVectorSplatW(body), XMVectorMultiply(inverse, XMVectorMultiply(inverse, inverse)));
+  s = XMVectorSelect(s, XMVectorZero(), XMVectorEqual(distanceSq, XMVectorZero()));
+  return XMVectorMultiply(d, s);
+}
+
+//------------------------------------------------------------------------------
+// Direct summation
+
+struct MXMNBODYSOA
+{
+  std::vector<float> x, y, z, mass; // padded to a multiple of four with massless bodies
+  size_t count;
+};
+
+inline void MXMNBodyLoad(MXMNBODYSOA &soa, _In_reads_(count) const MXMFLOAT4 *pBodies, size_t count)
+{
+  const size_t padded = (count + 3) & ~(size_t)3;
+  soa.count = count;
+  soa.x.assign(padded, 0.0f);
+  soa.y.assign(padded, 0.0f);
+  soa.z.assign(padded, 0.0f);
+  soa.mass.assign(padded, 0.0f);
+  for (size_t i = 0; i < count; ++i) {
+    soa.x[i] = pBodies[i].x;
+    soa.y[i] = pBodies[i].y;
+    soa.z[i] = pBodies[i].z;
+    soa.mass[i] = pBodies[i].w;
+  }
+}
+
+// Accelerations of the bodies [first, first + count) by all bodies, written
+// to pAccelerations[first, first + count).
+inline void MXMNBodyAccelerations(const MXMNBODYSOA &bodies, size_t first, size_t count, float gravity, float softening,
+                                  _Out_ MXMFLOAT3 *pAccelerations)
+{
+  const size_t padded = bodies.x.size();
+  const float *x = padded ? &bodies.x[0] : NULL;
+  const float *y = padded ? &bodies.y[0] : NULL;
+  const float *z = padded ? &bodies.z[0] : NULL;
+  const float *mass = padded ? &bodies.mass[0] : NULL;
+  const XMVECTOR softeningSq = XMVectorReplicate(softening * softening);
+  const size_t end = first + count;
+
+  XMVECTOR ax[MXM_NBODY_BLOCK_SIZE], ay[MXM_NBODY_BLOCK_SIZE], az[MXM_NBODY_BLOCK_SIZE];
+  for (size_t blockFirst = first; blockFirst < end; blockFirst += MXM_NBODY_BLOCK_SIZE) {
+    const size_t blockCount = std::min(end - blockFirst, (size_t)MXM_NBODY_BLOCK_SIZE);
+    for (size_t b = 0; b < blockCount; ++b)
+      ax[b] = ay[b] = az[b] = XMVectorZero();
+
+    for (size_t tile = 0; tile < padded; tile += MXM_NBODY_TILE_SIZE) {
+      const size_t tileEnd = std::min(tile + MXM_NBODY_TILE_SIZE, padded);
+      for (size_t b = 0; b < blockCount; ++b) {
+        const size_t i = blockFirst + b;
+        const XMVECTOR px = XMVectorReplicate(x[i]);
+        const XMVECTOR py = XMVectorReplicate(y[i]);
+        const XMVECTOR pz = XMVectorReplicate(z[i]);
+        XMVECTOR sx = ax[b], sy = ay[b], sz = az[b];
+        for (size_t j = tile; j < tileEnd; j += 4) {
+          const XMVECTOR dx = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x + j)), px);
+          const XMVECTOR dy = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(y + j)), py);
+          const XMVECTOR dz = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(z + j)), pz);
+          const XMVECTOR distanceSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiplyAdd(dz, dz, softeningSq)));
+          const XMVECTOR inverse = MXMVectorReciprocalSqrtNewton(distanceSq);
+          XMVECTOR s = XMVectorMultiply(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(mass + j)),
+                                        XMVectorMultiply(inverse, XMVectorMultiply(inverse, inverse)));
+          s = XMVectorSelect(s, XMVectorZero(), XMVectorEqual(distanceSq, XMVectorZero()));
+          sx = XMVectorMultiplyAdd(dx, s, sx);
+          sy = XMVectorMultiplyAdd(dy, s, sy);
+          sz = XMVectorMultiplyAdd(dz, s, sz);
+        }
+        ax[b] = sx;
+        ay[b] = sy;
+        az[b] = sz;
+      }
+    }
+
+    const XMVECTOR g = XMVectorReplicate(gravity);
+    for (size_t b = 0; b < blockCount; ++b)
+      pAccelerations[blockFirst + b] = XMVectorMultiply(MXMVectorHorizontalSum3(ax[b], ay[b], az[b]), g);
+  }
+}
+
+// Accelerations of all bodies.
+inline void MXMNBodyAccelerations(_In_reads_(count) const MXMFLOAT4 *pBodies, size_t count, float gravity, float softening,
+                                  _Out_writes_(count) MXMFLOAT3 *pAccelerations)
+{
+  MXMNBODYSOA soa;
+  MXMNBodyLoad(soa, pBodies, count);
+  MXMNBodyAccelerations(soa, 0, count, gravity, softening, pAccelerations);
+}
+
+//------------------------------------------------------------------------------
+// Barnes-Hut
+
+// Inner nodes have count children starting at nodes[first], leaves hold the
+// sorted bodies [first, first + count).
+struct MXMBARNESHUTNODE
+{
+  MXMFLOAT4 massCenter;              // center of mass xyz, total mass w
+  float size;                        // edge length of the cell
+  uint32_t leaf;
+  uint32_t first;
+  uint32_t count;
+};
+
+struct MXMBARNESHUTTREE
+{
+  std::vector<MXMBARNESHUTNODE> nodes; // nodes[0] is the root
+  std::vector<uint32_t> indices;     // original index of every sorted body
+  std::vector<MXMFLOAT4> bodies;     // bodies in leaf order
+};
+
+struct MXMBARNESHUTBUILDER
+{
+  const MXMFLOAT4 *pBodies;
+  uint32_t leafSize;
+  MXMBARNESHUTTREE *pTree;
+  std::vector<uint32_t> scratch;
+
+  void Build(uint32_t index, uint32_t first, uint32_t count, XMFLOAT3 center, float size, uint32_t depth) {
+    std::vector<MXMBARNESHUTNODE> &nodes = pTree->nodes;
+    std::vector<uint32_t> &indices = pTree->indices;
+    nodes[index].size = size;
+
+    if (count <= leafSize || depth >= MXM_BARNES_HUT_MAX_DEPTH) {
+      XMVECTOR sum = XMVectorZero();
+      float mass = 0.0f;
+      for (uint32_t i = first; i < first + count; ++i) {
+        const MXMFLOAT4 &body = pBodies[indices[i]];
+        sum = XMVectorAdd(sum, XMVectorScale(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&body)), body.w));
+        mass += body.w;
+      }
+      nodes[index].massCenter = XMVectorSetW(mass > 0.0f ? XMVectorScale(sum, 1.0f / mass) : XMLoadFloat3(&center), mass);
+      nodes[index].leaf = 1;
+      nodes[index].first = first;
+      nodes[index].count = count;
+      return;
+    }
+
+    // counting sort of the bodies into the eight octants
+    uint32_t octantCount[8] = { 0 }, octantFirst[8];
+    for (uint32_t i = first; i < first + count; ++i) {
+      const MXMFLOAT4 &body = pBodies[indices[i]];
+      ++octantCount[(body.x >= center.x ? 1 : 0) | (body.y >= center.y ? 2 : 0) | (body.z >= center.z ? 4 : 0)];
+    }
+    uint32_t offset = first, childCount = 0;
+    for (uint32_t o = 0; o < 8; ++o) {
+      octantFirst[o] = offset;
+      offset += octantCount[o];
+      childCount += octantCount[o] ? 1 : 0;
+    }
+    for (uint32_t i = first; i < first + count; ++i) {
+      const MXMFLOAT4 &body = pBodies[indices[i]];
+      scratch[octantFirst[(body.x >= center.x ? 1 : 0) | (body.y >= center.y ? 2 : 0) | (body.z >= center.z ? 4 : 0)]++] = indices[i];
+    }
+    std::copy(scratch.begin() + first, scratch.begin() + first + count, indices.begin() + first);
+
+    const uint32_t firstChild = (uint32_t)nodes.size();
+    nodes.resize(nodes.size() + childCount);
+    nodes[index].leaf = 0;
+    nodes[index].first = firstChild;
+    nodes[index].count = childCount;
+
+    const float quarter = size * 0.25f;
+    uint32_t child = firstChild;
+    offset = first;
+    for (uint32_t o = 0; o < 8; ++o) {
+      if (!octantCount[o])
+        continue;
+      XMFLOAT3 childCenter(center.x + (o & 1 ? quarter : -quarter),
+                           center.y + (o & 2 ? quarter : -quarter),
+                           center.z + (o & 4 ? quarter : -quarter));
+      Build(child++, offset, octantCount[o], childCenter, size * 0.5f, depth + 1);
+      offset += octantCount[o];
+    }
+
+    XMVECTOR sum = XMVectorZero();
+    float mass = 0.0f;
+    for (uint32_t c = firstChild; c < firstChild + childCount; ++c) {
+      const MXMFLOAT4 &massCenter = nodes[c].massCenter;
+      sum = XMVectorAdd(sum, XMVectorScale(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&massCenter)), massCenter.w));
+      mass += massCenter.w;
+    }
+    nodes[index].massCenter = XMVectorSetW(mass > 0.0f ? XMVectorScale(sum, 1.0f / mass) : XMLoadFloat3(&center), mass);
+  }
+};
+
+inline void MXMBarnesHutBuild(MXMBARNESHUTTREE &tree, _In_reads_(count) const MXMFLOAT4 *pBodies, size_t count, uint32_t leafSize = 8)
+{
+  tree.nodes.clear();
+  tree.bodies.clear();
+  tree.indices.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    tree.indices[i] = (uint32_t)i;
+  if (!count)
+    return;
+
+  XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX), boundsMax = XMVectorReplicate(-FLT_MAX);
+  for (size_t i = 0; i < count; ++i) {
+    const XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pBodies[i]));
+    boundsMin = XMVectorMin(boundsMin, p);
+    boundsMax = XMVectorMax(boundsMax, p);
+  }
+  const XMVECTOR extent = XMVectorSubtract(boundsMax, boundsMin);
+  XMFLOAT3 center;
+  XMStoreFloat3(&center, XMVectorMultiply(XMVectorAdd(boundsMin, boundsMax), XMVectorReplicate(0.5f)));
+  const float size = std::max(XMVectorGetX(extent), std::max(XMVectorGetY(extent), XMVectorGetZ(extent)));
+
+  MXMBARNESHUTBUILDER builder;
+  builder.pBodies = pBodies;
+  builder.leafSize = leafSize ? leafSize : 1;
+  builder.pTree = &tree;
+  builder.scratch.resize(count);
+  tree.nodes.resize(1);
+  builder.Build(0, 0, (uint32_t)count, center, size, 0);
+
+  tree.bodies.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    tree.bodies[i] = pBodies[tree.indices[i]];
+}
+
+// Acceleration (without gravity) at position.
+inline XMVECTOR XM_CALLCONV MXMBarnesHutAcceleration(const MXMBARNESHUTTREE &tree, FXMVECTOR position, float softening, float theta)
+{
+  XMVECTOR acceleration = XMVectorZero();
+  if (tree.nodes.empty())
+    return acceleration;
+
+  const XMVECTOR softeningSq = XMVectorReplicate(softening * softening);
+  const float thetaSq = theta * theta;
+
+  uint32_t stack[8 * MXM_BARNES_HUT_MAX_DEPTH + 1];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize) {
+    const MXMBARNESHUTNODE &node = tree.nodes[stack[--stackSize]];
+    if (node.leaf) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i)
+        acceleration = XMVectorAdd(acceleration, MXMNBodyInteraction(position, tree.bodies[i], softeningSq));
+      continue;
+    }
+
+    const XMVECTOR massCenter = node.massCenter;
+    const float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(massCenter, position)));
+    if (node.size * node.size < thetaSq * distanceSq) {
+      acceleration = XMVectorAdd(acceleration, MXMNBodyInteraction(position, massCenter, softeningSq));
+      continue;
+    }
+    for (uint32_t c = node.first; c < node.first + node.count; ++c)
+      stack[stackSize++] = c;
+  }
+  return acceleration;
+}
+
+// Accelerations of the bodies [first, first + count), written to
+// pAccelerations[first, first + count).
+inline void MXMBarnesHutAccelerations(const MXMBARNESHUTTREE &tree, _In_ const MXMFLOAT4 *pBodies, size_t first, size_t count,
+                                      float gravity, float softening, float theta, _Out_ MXMFLOAT3 *pAccelerations)
+{
+  const XMVECTOR g = XMVectorReplicate(gravity);
+  for (size_t i = first; i < first + count; ++i) {
+    const XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pBodies[i]));
+    pAccelerations[i] = XMVectorMultiply(MXMBarnesHutAcceleration(tree, position, softening, theta), g);
+  }
+}
+
+} //namespace DirectX
@@ -0,0 +1,434 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Occlusion culling with a small software rasterized depth buffer.
+
+  Occluders are low-poly indexed triangle meshes (MXMFLOAT3 vertices). They
+  are transformed by their world matrix and the view-projection matrix of the
+  buffer, set up once and binned into screen tiles of 32x32 pixels. Every tile
+  is then rasterized on its own: the edge functions of a triangle are
+  evaluated for four pixels at once as XMVECTORs and the nearest depth is
+  kept. Afterwards the tile builds its part of a max-depth pyramid, so tiles
+  can be processed from different threads without any synchronization.
+
+  Occludees are axis aligned boxes (MXMFLOAT3 min and max arrays). The eight
+  corners are projected, and the nearest depth of the box is compared to the
+  farthest depth of the pyramid level on which the screen rectangle of the
+  box covers at most 2x2 texels. Boxes crossing the near plane are always
+  reported as visible.
+
+  Depth follows Direct3D conventions (0 = near, 1 = far), the buffer is
+  cleared to 1. Triangles touching the near plane are dropped as occluders,
+  which keeps the result conservative.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMOCCLUSIONBUFFER buffer(256, 128);
+
+    MXMOcclusionBeginFrame(buffer, view * projection);
+    for (each occluder)
+      MXMOcclusionAddOccluder(buffer, vertices, vertexCount, indices, indexCount, world);
+
+    // one call per tile, possibly from several threads
+    for (uint32_t tile = 0; tile < buffer.TileCount(); ++tile)
+      MXMOcclusionRasterizeTile(buffer, tile);
+
+    MXMOcclusionTestBoxes(buffer, boxMin, boxMax, 0, count, visibleMask);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <math.h>
+
+namespace DirectX
+{
+
+#define MXM_OCCLUSION_TILE_SHIFT 5
+#define MXM_OCCLUSION_TILE_SIZE  (1u << MXM_OCCLUSION_TILE_SHIFT)
+
+// Triangle after setup: three edge functions and the depth plane, each as
+// a * x + b * y + c in pixel coordinates, plus the pixel bounds.
+struct MXMOCCLUSIONTRIANGLE
+{
+  float edgeA[3], edgeB[3], edgeC[3];
+  float depthA, depthB, depthC;
+  int32_t minX, minY, maxX, maxY;
+};
+
+struct MXMOCCLUSIONBUFFER
+{
+  uint32_t width, height;               // multiples of MXM_OCCLUSION_TILE_SIZE
+  uint32_t tilesX, tilesY;
+  MXMFLOAT4X4 viewProjection;
+
+  std::vector<std::vector<float> > levels;  // depth pyramid, levels[0] = depth buffer
+  std::vector<MXMOCCLUSIONTRIANGLE> triangles;
+  std::vector<std::vector<uint32_t> > bins;  // triangle indices per tile
+  std::vector<MXMFLOAT4> screen;             // vertices of the current occluder, reused between occluders
+
+  MXMOCCLUSIONBUFFER() : width(0), height(0), tilesX(0), tilesY(0) {}
+  MXMOCCLUSIONBUFFER(uint32_t _width, uint32_t _height) {
+    Resize(_width, _height);
+  }
+
+  void Resize(uint32_t _width, uint32_t _height) {
+    tilesX = (_width + MXM_OCCLUSION_TILE_SIZE - 1) >> MXM_OCCLUSION_TILE_SHIFT;
+    tilesY = (_height + MXM_OCCLUSION_TILE_SIZE - 1) >> MXM_OCCLUSION_TILE_SHIFT;
+    width = tilesX << MXM_OCCLUSION_TILE_SHIFT;
+    height = tilesY << MXM_OCCLUSION_TILE_SHIFT;
+
+    levels.resize(MXM_OCCLUSION_TILE_SHIFT + 1);
+    for (uint32_t l = 0; l <= MXM_OCCLUSION_TILE_SHIFT; ++l)
+      levels[l].assign((width >> l) * (height >> l), 1.0f);
+    bins.assign(tilesX * tilesY, std::vector<uint32_t>());
+    triangles.clear();
+  }
+
+  uint32_t TileCount() const {
+    return tilesX * tilesY;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Occluders
+
+// Starts a new frame: drops all occluders of the last frame.
+inline void XM_CALLCONV MXMOcclusionBeginFrame(MXMOCCLUSIONBUFFER &buffer, FXMMATRIX viewProjection)
+{
+  buffer.viewProjection = viewProjection;
+  buffer.triangles.clear();
+  for (size_t i = 0; i < buffer.bins.size(); ++i)
+    buffer.bins[i].clear();
+}
+
+// Sets up a screen space triangle and adds it to the bins of all tiles its
+// bounds touch. The vertices hold pixel x, y and depth.
+inline void XM_CALLCONV MXMOcclusionAddTriangle(MXMOCCLUSIONBUFFER &buffer, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2)
+{
+  XMFLOAT3 a, b, c;
+  XMStoreFloat3(&a, v0);
+  XMStoreFloat3(&b, v1);
+  XMStoreFloat3(&c, v2);
+
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (area == 0.0f)
+    return;
+  if (area < 0.0f) {
+    // occluders are rendered double sided, flip to a positive area
+    XMFLOAT3 t = b; b = c; c = t;
+    area = -area;
+  }
+
+  XMVECTOR vMin = XMVectorMin(XMVectorMin(v0, v1), v2);
+  XMVECTOR vMax = XMVectorMax(XMVectorMax(v0, v1), v2);
+  int32_t minX = (int32_t)XMVectorGetX(XMVectorFloor(vMin));
+  int32_t minY = (int32_t)XMVectorGetY(XMVectorFloor(vMin));
+  int32_t maxX = (int32_t)XMVectorGetX(XMVectorCeiling(vMax));
+  int32_t maxY = (int32_t)XMVectorGetY(XMVectorCeiling(vMax));
+  if (minX < 0) minX = 0;
+  if (minY < 0) minY = 0;
+  if (maxX > (int32_t)buffer.width - 1) maxX = (int32_t)buffer.width - 1;
+  if (maxY > (int32_t)buffer.height - 1) maxY = (int32_t)buffer.height - 1;
+  if (minX > maxX || minY > maxY)
+    return;
+
+  MXMOCCLUSIONTRIANGLE tri;
+  const XMFLOAT3 *v[3] = { &a, &b, &c };
+  for (int e = 0; e < 3; ++e) {
+    const XMFLOAT3 &p = *v[e];
+    const XMFLOAT3 &q = *v[(e + 1) % 3];
+    tri.edgeA[e] = p.y - q.y;
+    tri.edgeB[e] = q.x - p.x;
+    tri.edgeC[e] = -tri.edgeA[e] * p.x - tri.edgeB[e] * p.y;
+  }
+
+  // depth plane from the barycentric weights (edge e is opposite of vertex e + 2)
+  const float invArea = 1.0f / area;
+  tri.depthA = (tri.edgeA[1] * a.z + tri.edgeA[2] * b.z + tri.edgeA[0] * c.z) * invArea;
+  tri.depthB = (tri.edgeB[1] * a.z + tri.edgeB[2] * b.z + tri.edgeB[0] * c.z) * invArea;
+  tri.depthC = (tri.edgeC[1] * a.z + tri.edgeC[2] * b.z + tri.edgeC[0] * c.z) * invArea;
+  tri.minX = minX;
+  tri.minY = minY;
+  tri.maxX = maxX;
+  tri.maxY = maxY;
+
+  const uint32_t index = (uint32_t)buffer.triangles.size();
+  buffer.triangles.push_back(tri);
+  for (int32_t ty = minY >> MXM_OCCLUSION_TILE_SHIFT; ty <= (maxY >> MXM_OCCLUSION_TILE_SHIFT); ++ty) {
+    for (int32_t tx = minX >> MXM_OCCLUSION_TILE_SHIFT; tx <= (maxX >> MXM_OCCLUSION_TILE_SHIFT); ++tx)
+      buffer.bins[ty * buffer.tilesX + tx].push_back(index);
+  }
+}
+
+// Transforms an indexed occluder mesh and adds its triangles. Vertices are
+// transformed four at a time; triangles with a vertex in front of the near
+// plane (clip z < 0) or close to the camera plane (clip w near 0) are skipped.
+inline void XM_CALLCONV MXMOcclusionAddOccluder(MXMOCCLUSIONBUFFER &buffer,
+                                                _In_reads_(vertexCount) const MXMFLOAT3 *pVertices, size_t vertexCount,
+                                                _In_reads_(indexCount) const uint32_t *pIndices, size_t indexCount,
+                                                FXMMATRIX world)
+{
+  XMMATRIX m = XMMatrixMultiply(world, buffer.viewProjection);
+
+  // screen space vertices, w < 0 marks vertices in front of the near plane
+  std::vector<MXMFLOAT4> &screen = buffer.screen;
+  screen.resize(vertexCount);
+  const XMVECTOR scale = XMVectorSet(0.5f * buffer.width, -0.5f * buffer.height, 1.0f, 0.0f);
+  const XMVECTOR offset = XMVectorSet(0.5f * buffer.width, 0.5f * buffer.height, 0.0f, 0.0f);
+  const XMVECTOR epsilon = XMVectorReplicate(1e-5f);
+
+  size_t i = 0;
+  for (; i + 4 <= vertexCount; i += 4) {
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(pVertices + i, x, y, z);
+
+    XMVECTOR cx = XMVectorMultiplyAdd(x, XMVectorSplatX(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatX(m.r[1]),
+                  XMVectorMultiplyAdd(z, XMVectorSplatX(m.r[2]), XMVectorSplatX(m.r[3]))));
+    XMVECTOR cy = XMVectorMultiplyAdd(x, XMVectorSplatY(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatY(m.r[1]),
+                  XMVectorMultiplyAdd(z, XMVectorSplatY(m.r[2]), XMVectorSplatY(m.r[3]))));
+    XMVECTOR cz = XMVectorMultiplyAdd(x, XMVectorSplatZ(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatZ(m.r[1]),
+                  XMVectorMultiplyAdd(z, XMVectorSplatZ(m.r[2]), XMVectorSplatZ(m.r[3]))));
+    XMVECTOR cw = XMVectorMultiplyAdd(x, XMVectorSplatW(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatW(m.r[1]),
+                  XMVectorMultiplyAdd(z, XMVectorSplatW(m.r[2]), XMVectorSplatW(m.r[3]))));
+
+    XMVECTOR front = XMVectorOrInt(XMVectorLess(cz, XMVectorZero()), XMVectorLess(cw, epsilon));
+    XMVECTOR invW = XMVectorReciprocal(XMVectorSelect(cw, XMVectorSplatOne(), front));
+    XMVECTOR sx = XMVectorMultiplyAdd(XMVectorMultiply(cx, invW), XMVectorSplatX(scale), XMVectorSplatX(offset));
+    XMVECTOR sy = XMVectorMultiplyAdd(XMVectorMultiply(cy, invW), XMVectorSplatY(scale), XMVectorSplatY(offset));
+    XMVECTOR sz = XMVectorMultiply(cz, invW);
+    XMVECTOR sw = XMVectorSelect(XMVectorSplatOne(), XMVectorNegate(XMVectorSplatOne()), front);
+
+    XMMATRIX soa(sx, sy, sz, sw);
+    soa = XMMatrixTranspose(soa);
+    screen[i + 0] = soa.r[0];
+    screen[i + 1] = soa.r[1];
+    screen[i + 2] = soa.r[2];
+    screen[i + 3] = soa.r[3];
+  }
+  for (; i < vertexCount; ++i) {
+    XMVECTOR c = XMVector4Transform(XMVectorSetW(pVertices[i], 1.0f), m);
+    float w = XMVectorGetW(c);
+    if (XMVectorGetZ(c) < 0.0f || w < 1e-5f) {
+      screen[i] = XMVectorSet(0.0f, 0.0f, 0.0f, -1.0f);
+    } else {
+      XMVECTOR s = XMVectorMultiplyAdd(XMVectorScale(c, 1.0f / w), scale, offset);
+      screen[i] = XMVectorSetW(s, 1.0f);
+    }
+  }
+
+  for (size_t t = 0; t + 3 <= indexCount; t += 3) {
+    const MXMFLOAT4 &a = screen[pIndices[t]];
+    const MXMFLOAT4 &b = screen[pIndices[t + 1]];
+    const MXMFLOAT4 &c = screen[pIndices[t + 2]];
+    if (a.w < 0.0f || b.w < 0.0f || c.w < 0.0f)
+      continue;
+    MXMOcclusionAddTriangle(buffer, a, b, c);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Rasterization
+
+// Clears one tile, rasterizes all triangles binned to it and builds the
+// pyramid levels of the tile. Different tiles may be rasterized concurrently.
+inline void MXMOcclusionRasterizeTile(MXMOCCLUSIONBUFFER &buffer, uint32_t tile)
+{
+  const int32_t tileX = (int32_t)((tile % buffer.tilesX) << MXM_OCCLUSION_TILE_SHIFT);
+  const int32_t tileY = (int32_t)((tile / buffer.tilesX) << MXM_OCCLUSION_TILE_SHIFT);
+  const int32_t tileSize = (int32_t)MXM_OCCLUSION_TILE_SIZE;
+  const size_t pitch = buffer.width;
+  float *pDepth = &buffer.levels[0][0];
+
+  for (int32_t y = tileY; y < tileY + tileSize; ++y) {
+    for (int32_t x = tileX; x < tileX + tileSize; x += 4)
+      XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDepth + y * pitch + x), XMVectorSplatOne());
+  }
+
+  const XMVECTOR laneOffset = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+  const std::vector<uint32_t> &bin = buffer.bins[tile];
+  for (size_t b = 0; b < bin.size(); ++b) {
+    const MXMOCCLUSIONTRIANGLE &tri = buffer.triangles[bin[b]];
+
+    const int32_t minX = (tri.minX > tileX ? tri.minX : tileX) & ~3;
+    const int32_t maxX = tri.maxX < tileX + tileSize - 1 ? tri.maxX : tileX + tileSize - 1;
+    const int32_t minY = tri.minY > tileY ? tri.minY : tileY;
+    const int32_t maxY = tri.maxY < tileY + tileSize - 1 ? tri.maxY : tileY + tileSize - 1;
+
+    const XMVECTOR a0 = XMVectorReplicate(tri.edgeA[0]), b0 = XMVectorReplicate(tri.edgeB[0]), c0 = XMVectorReplicate(tri.edgeC[0]);
+    const XMVECTOR a1 = XMVectorReplicate(tri.edgeA[1]), b1 = XMVectorReplicate(tri.edgeB[1]), c1 = XMVectorReplicate(tri.edgeC[1]);
+    const XMVECTOR a2 = XMVectorReplicate(tri.edgeA[2]), b2 = XMVectorReplicate(tri.edgeB[2]), c2 = XMVectorReplicate(tri.edgeC[2]);
+    const XMVECTOR da = XMVectorReplicate(tri.depthA), db = XMVectorReplicate(tri.depthB), dc = XMVectorReplicate(tri.depthC);
+    const XMVECTOR stepX = XMVectorReplicate(4.0f);
+
+    const XMVECTOR px0 = XMVectorAdd(XMVectorReplicate((float)minX), laneOffset);
+    for (int32_t y = minY; y <= maxY; ++y) {
+      const XMVECTOR py = XMVectorReplicate((float)y + 0.5f);
+
+      // edge functions and depth at the first four pixels of the row
+      XMVECTOR e0 = XMVectorMultiplyAdd(a0, px0, XMVectorMultiplyAdd(b0, py, c0));
+      XMVECTOR e1 = XMVectorMultiplyAdd(a1, px0, XMVectorMultiplyAdd(b1, py, c1));
+      XMVECTOR e2 = XMVectorMultiplyAdd(a2, px0, XMVectorMultiplyAdd(b2, py, c2));
+      XMVECTOR z = XMVectorMultiplyAdd(da, px0, XMVectorMultiplyAdd(db, py, dc));
+      const XMVECTOR step0 = XMVectorMultiply(a0, stepX);
+      const XMVECTOR step1 = XMVectorMultiply(a1, stepX);
+      const XMVECTOR step2 = XMVectorMultiply(a2, stepX);
+      const XMVECTOR stepZ = XMVectorMultiply(da, stepX);
+
+      float *pRow = pDepth + y * pitch;
+      for (int32_t x = minX; x <= maxX; x += 4) {
+        XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(XMVectorGreater(e0, XMVectorZero()),
+                                                        XMVectorGreater(e1, XMVectorZero())),
+                                         XMVectorGreater(e2, XMVectorZero()));
+        if (MXMVectorMoveMask(inside)) {
+          XMFLOAT4 *pPixels = reinterpret_cast<XMFLOAT4*>(pRow + x);
+          XMVECTOR depth = XMLoadFloat4(pPixels);
+          XMStoreFloat4(pPixels, XMVectorSelect(depth, XMVectorMin(depth, z), inside));
+        }
+        e0 = XMVectorAdd(e0, step0);
+        e1 = XMVectorAdd(e1, step1);
+        e2 = XMVectorAdd(e2, step2);
+        z = XMVectorAdd(z, stepZ);
+      }
+    }
+  }
+
+  // max-depth pyramid inside of the tile
+  for (uint32_t l = 1; l <= MXM_OCCLUSION_TILE_SHIFT; ++l) {
+    const float *pSrc = &buffer.levels[l - 1][0];
+    float *pDst = &buffer.levels[l][0];
+    const size_t srcPitch = buffer.width >> (l - 1);
+    const size_t dstPitch = buffer.width >> l;
+    const int32_t size = tileSize >> l;
+    const int32_t x0 = tileX >> l;
+    const int32_t y0 = tileY >> l;
+    for (int32_t y = y0; y < y0 + size; ++y) {
+      for (int32_t x = x0; x < x0 + size; ++x) {
+        const float *p = pSrc + 2 * y * srcPitch + 2 * x;
+        float d = p[0] > p[1] ? p[0] : p[1];
+        d = d > p[srcPitch] ? d : p[srcPitch];
+        d = d > p[srcPitch + 1] ? d : p[srcPitch + 1];
+        pDst[y * dstPitch + x] = d;
+      }
+    }
+  }
+}
+
+// Rasterizes all tiles on the calling thread.
+inline void MXMOcclusionRasterize(MXMOCCLUSIONBUFFER &buffer)
+{
+  for (uint32_t tile = 0; tile < buffer.TileCount(); ++tile)
+    MXMOcclusionRasterizeTile(buffer, tile);
+}
+
+//------------------------------------------------------------------------------
+// Occludees
+
+// Returns false if the box is completely hidden behind the occluders or
+// outside of the screen.
+inline bool XM_CALLCONV MXMOcclusionTestBox(const MXMOCCLUSIONBUFFER &buffer, FXMVECTOR boxMin, FXMVECTOR boxMax)
+{
+  XMMATRIX m = buffer.viewProjection;
+
+  // the eight corners as two groups of four
+  XMVECTOR x = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_1X, XM_PERMUTE_0X, XM_PERMUTE_1X>(boxMin, boxMax);
+  XMVECTOR y = XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_0Y, XM_PERMUTE_1Y, XM_PERMUTE_1Y>(boxMin, boxMax);
+  XMVECTOR zNear = XMVectorSplatZ(boxMin);
+  XMVECTOR zFar = XMVectorSplatZ(boxMax);
+
+  XMVECTOR baseX = XMVectorMultiplyAdd(x, XMVectorSplatX(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatX(m.r[1]), XMVectorSplatX(m.r[3])));
+  XMVECTOR baseY = XMVectorMultiplyAdd(x, XMVectorSplatY(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatY(m.r[1]), XMVectorSplatY(m.r[3])));
+  XMVECTOR baseZ = XMVectorMultiplyAdd(x, XMVectorSplatZ(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatZ(m.r[1]), XMVectorSplatZ(m.r[3])));
+  XMVECTOR baseW = XMVectorMultiplyAdd(x, XMVectorSplatW(m.r[0]), XMVectorMultiplyAdd(y, XMVectorSplatW(m.r[1]), XMVectorSplatW(m.r[3])));
+
+  XMVECTOR cx[2], cy[2], cz[2], cw[2];
+  const XMVECTOR zs[2] = { zNear, zFar };
+  for (int k = 0; k < 2; ++k) {
+    cx[k] = XMVectorMultiplyAdd(zs[k], XMVectorSplatX(m.r[2]), baseX);
+    cy[k] = XMVectorMultiplyAdd(zs[k], XMVectorSplatY(m.r[2]), baseY);
+    cz[k] = XMVectorMultiplyAdd(zs[k], XMVectorSplatZ(m.r[2]), baseZ);
+    cw[k] = XMVectorMultiplyAdd(zs[k], XMVectorSplatW(m.r[2]), baseW);
+  }
+
+  // corners in front of the near plane (clip z < 0) or close to the camera
+  // plane (clip w near 0) can not be projected
+  const XMVECTOR epsilon = XMVectorReplicate(1e-5f);
+  const XMVECTOR front = XMVectorOrInt(XMVectorOrInt(XMVectorLess(cz[0], XMVectorZero()), XMVectorLess(cz[1], XMVectorZero())),
+                                       XMVectorOrInt(XMVectorLess(cw[0], epsilon), XMVectorLess(cw[1], epsilon)));
+  if (MXMVectorMoveMask(front))
+    return true;
+
+  XMVECTOR sMin = XMVectorSplatInfinity();
+  XMVECTOR sMax = XMVectorNegate(sMin);
+  XMVECTOR zMin = sMin;
+  for (int k = 0; k < 2; ++k) {
+    XMVECTOR invW = XMVectorReciprocal(cw[k]);
+    XMVECTOR sx = XMVectorMultiply(cx[k], invW);
+    XMVECTOR sy = XMVectorMultiply(cy[k], invW);
+    // x and y in the first two lanes after the merge, per corner pair
+    XMVECTOR xy0 = XMVectorMergeXY(sx, sy);
+    XMVECTOR xy1 = XMVectorMergeZW(sx, sy);
+    sMin = XMVectorMin(sMin, XMVectorMin(xy0, xy1));
+    sMax = XMVectorMax(sMax, XMVectorMax(xy0, xy1));
+    zMin = XMVectorMin(zMin, XMVectorMultiply(cz[k], invW));
+  }
+  sMin = XMVectorMin(sMin, XMVectorSwizzle<2, 3, 0, 1>(sMin));
+  sMax = XMVectorMax(sMax, XMVectorSwizzle<2, 3, 0, 1>(sMax));
+  zMin = XMVectorMin(zMin, XMVectorSwizzle<2, 3, 0, 1>(zMin));
+  zMin = XMVectorMin(zMin, XMVectorSwizzle<1, 0, 3, 2>(zMin));
+
+  // normalized device coordinates to pixels, y flipped
+  const float w = (float)buffer.width;
+  const float h = (float)buffer.height;
+  int32_t x0 = (int32_t)floorf((XMVectorGetX(sMin) * 0.5f + 0.5f) * w);
+  int32_t x1 = (int32_t)floorf((XMVectorGetX(sMax) * 0.5f + 0.5f) * w);
+  int32_t y0 = (int32_t)floorf((0.5f - XMVectorGetY(sMax) * 0.5f) * h);
+  int32_t y1 = (int32_t)floorf((0.5f - XMVectorGetY(sMin) * 0.5f) * h);
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > (int32_t)buffer.width - 1) x1 = (int32_t)buffer.width - 1;
+  if (y1 > (int32_t)buffer.height - 1) y1 = (int32_t)buffer.height - 1;
+  if (x0 > x1 || y0 > y1)
+    return false;
+
+  // coarsest level on which the rectangle touches at most 2x2 texels
+  uint32_t level = 0;
+  while (level < MXM_OCCLUSION_TILE_SHIFT && (((x1 >> level) - (x0 >> level)) > 1 || ((y1 >> level) - (y0 >> level)) > 1))
+    ++level;
+
+  const float nearest = XMVectorGetX(zMin);
+  const float *pLevel = &buffer.levels[level][0];
+  const size_t pitch = buffer.width >> level;
+  for (int32_t y = y0 >> level; y <= (y1 >> level); ++y) {
+    for (int32_t x = x0 >> level; x <= (x1 >> level); ++x) {
+      if (pLevel[y * pitch + x] >= nearest)
+        return true;
+    }
+  }
+  return false;
+}
+
+// Writes visibility bits for the boxes [first, first + count) into pMask,
+// following the mask layout of MXMCullBoxesMask. first has to be a multiple
+// of 32. Can be called concurrently once all tiles are rasterized.
+inline void MXMOcclusionTestBoxes(const MXMOCCLUSIONBUFFER &buffer,
+                                  _In_ const MXMFLOAT3 *pMin, _In_ const MXMFLOAT3 *pMax,
+                                  size_t first, size_t count, _Out_ uint32_t *pMask)
+{
+  const size_t end = first + count;
+  for (size_t i = first; i < end; i += 32) {
+    const size_t wordEnd = (end - i) < 32 ? end : i + 32;
+    uint32_t word = 0;
+    for (size_t j = i; j < wordEnd; ++j) {
+      if (MXMOcclusionTestBox(buffer, pMin[j], pMax[j]))
+        word |= 1u << (j - i);
+    }
+    pMask[i >> 5] = word;
+  }
+}
+
+} //namespace DirectX
@@ -0,0 +1,216 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Camera relative rebasing and floating origin shifts.
+
+  World positions are either stored in double precision (MXMDOUBLE3,
+  MXMDOUBLE4X4) or in float relative to a double precision world origin
+  (float + offset). Every frame the positions and transforms are converted to
+  float arrays relative to the camera:
+
+    double         MXMRebasePositions / MXMRebaseMatrices of the double header
+    float + offset the offset origin - camera is computed in double once and
+                   added to every element in float
+
+  When the camera moves far away from the world origin, the float data loses
+  precision and the origin has to move. MXMORIGINSHIFT rewrites the stored
+  float data to the new origin incrementally: elements below the cursor are
+  relative to the new origin, the others still to the previous one. Each
+  frame MXMOriginShiftAdvance hands out the next range of at most a budget of
+  elements, which can be split further and shifted concurrently. Rebasing
+  through the MXMORIGINSHIFT picks the matching origin for both parts, so
+  rendering stays correct while the shift is spread over several frames.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMORIGINSHIFT shift;
+    MXMOriginShiftInit(shift, MXMDOUBLE3(0.0, 0.0, 0.0), count);
+
+    // every frame
+    if (MXMOriginShiftNeeded(shift, cameraPosition, 4096.0))
+      MXMOriginShiftBegin(shift, cameraPosition);
+
+    size_t first, rangeCount;
+    if (MXMOriginShiftAdvance(shift, 65536, first, rangeCount))
+      MXMOriginShiftMatrices(shift, &transforms[first], rangeCount);
+
+    MXMOriginShiftRebaseMatrices(shift, &transforms[0], 0, count, cameraPosition, &relative[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionDouble.h"
+
+#include <math.h>
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Float + offset rebasing
+
+// Returns from - to rounded to float, the offset that moves positions
+// relative to from into positions relative to to.
+__MXM_INLINE XMVECTOR MXMOriginOffset(const MXMDOUBLE3 &from, const MXMDOUBLE3 &to)
+{
+  return MXMVectorDRelative(from, to);
+}
+
+// Adds offset to count positions, four positions per step. pPositions and
+// pRelative may be the same array.
+inline void XM_CALLCONV MXMRebasePositions(_In_reads_(count) const MXMFLOAT3 *pPositions, size_t count,
+                                           FXMVECTOR offset, _Out_writes_(count) MXMFLOAT3 *pRelative)
+{
+  // four MXMFLOAT3 are twelve consecutive floats: xyzx yzxy zxyz
+  const XMVECTOR o0 = XMVectorSwizzle<0, 1, 2, 0>(offset);
+  const XMVECTOR o1 = XMVectorSwizzle<1, 2, 0, 1>(offset);
+  const XMVECTOR o2 = XMVectorSwizzle<2, 0, 1, 2>(offset);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float *pSource = &pPositions[i].x;
+    float *pDestination = &pRelative[i].x;
+    const XMVECTOR a = XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource)), o0);
+    const XMVECTOR b = XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource + 4)), o1);
+    const XMVECTOR c = XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource + 8)), o2);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination), a);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 4), b);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 8), c);
+  }
+  for (; i < count; ++i)
+    pRelative[i] = XMVectorAdd(pPositions[i], offset);
+}
+
+// Adds offset to the translations of count matrices. pMatrices and pRelative
+// may be the same array.
+inline void XM_CALLCONV MXMRebaseMatrices(_In_reads_(count) const MXMFLOAT4X3 *pMatrices, size_t count,
+                                          FXMVECTOR offset, _Out_writes_(count) MXMFLOAT4X3 *pRelative)
+{
+  // the translation is stored in the last three of the twelve floats
+  const XMVECTOR o = XMVectorPermute<XM_PERMUTE_1X, XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z>(offset, XMVectorZero());
+  for (size_t i = 0; i < count; ++i) {
+    const float *pSource = &pMatrices[i].m[0][0];
+    float *pDestination = &pRelative[i].m[0][0];
+    const XMVECTOR a = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource));
+    const XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource + 4));
+    const XMVECTOR c = XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource + 8)), o);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination), a);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 4), b);
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pDestination + 8), c);
+  }
+}
+
+// Converts count double precision world matrices to MXMFLOAT4X3 relative to origin.
+inline void MXMRebaseMatrices(_In_reads_(count) const MXMDOUBLE4X4 *pMatrices, size_t count, const MXMDOUBLE3 &origin,
+                              _Out_writes_(count) MXMFLOAT4X3 *pRelative)
+{
+  const MXMVECTORD o = origin;
+  for (size_t i = 0; i < count; ++i)
+    pRelative[i] = MXMMatrixDRelative(pMatrices[i], o);
+}
+
+//------------------------------------------------------------------------------
+// Origin shifts
+
+struct MXMORIGINSHIFT
+{
+  MXMDOUBLE3 origin;         // origin of the elements [0, cursor)
+  MXMDOUBLE3 previousOrigin; // origin of the elements [cursor, count)
+  size_t cursor;
+  size_t count;
+
+  MXMORIGINSHIFT() : cursor(0), count(0) {}
+
+  bool Shifting() const { return cursor < count; }
+};
+
+__MXM_INLINE void MXMOriginShiftInit(MXMORIGINSHIFT &shift, const MXMDOUBLE3 &origin, size_t count)
+{
+  shift.origin = shift.previousOrigin = origin;
+  shift.cursor = shift.count = count;
+}
+
+// Returns whether the camera is more than distance away from the origin
+// along any axis and no shift is in progress.
+__MXM_INLINE bool MXMOriginShiftNeeded(const MXMORIGINSHIFT &shift, const MXMDOUBLE3 &camera, double distance)
+{
+  if (shift.Shifting())
+    return false;
+  return fabs(camera.x - shift.origin.x) > distance || fabs(camera.y - shift.origin.y) > distance ||
+         fabs(camera.z - shift.origin.z) > distance;
+}
+
+// Starts moving all elements to newOrigin. Returns false and does nothing
+// while the previous shift is in progress.
+__MXM_INLINE bool MXMOriginShiftBegin(MXMORIGINSHIFT &shift, const MXMDOUBLE3 &newOrigin)
+{
+  if (shift.Shifting())
+    return false;
+  shift.previousOrigin = shift.origin;
+  shift.origin = newOrigin;
+  shift.cursor = 0;
+  return true;
+}
+
+// Hands out the next range [first, first + count) of at most budget elements
+// to shift this frame and moves the cursor past it. Returns false when no
+// shift is in progress. The range has to be shifted before the next rebase.
+__MXM_INLINE bool MXMOriginShiftAdvance(MXMORIGINSHIFT &shift, size_t budget, size_t &first, size_t &count)
+{
+  first = shift.cursor;
+  count = shift.count - shift.cursor < budget ? shift.count - shift.cursor : budget;
+  shift.cursor += count;
+  return count != 0;
+}
+
+// Returns the origin of element index.
+__MXM_INLINE const MXMDOUBLE3& MXMOriginShiftOriginOf(const MXMORIGINSHIFT &shift, size_t index)
+{
+  return index < shift.cursor ? shift.origin : shift.previousOrigin;
+}
+
+// Moves count positions from the previous to the current origin in place.
+// Disjoint ranges can be shifted concurrently.
+__MXM_INLINE void MXMOriginShiftPositions(const MXMORIGINSHIFT &shift, _Inout_updates_(count) MXMFLOAT3 *pPositions,
+                                          size_t count)
+{
+  MXMRebasePositions(pPositions, count, MXMOriginOffset(shift.previousOrigin, shift.origin), pPositions);
+}
+
+// Moves the translations of count matrices from the previous to the current
+// origin in place. Disjoint ranges can be shifted concurrently.
+__MXM_INLINE void MXMOriginShiftMatrices(const MXMORIGINSHIFT &shift, _Inout_updates_(count) MXMFLOAT4X3 *pMatrices,
+                                         size_t count)
+{
+  MXMRebaseMatrices(pMatrices, count, MXMOriginOffset(shift.previousOrigin, shift.origin), pMatrices);
+}
+
+// Converts the stored positions [first, first + count) to positions relative
+// to camera, using the origin matching each element. pRelative receives count
+// elements.
+inline void MXMOriginShiftRebasePositions(const MXMORIGINSHIFT &shift, _In_reads_(_Inexpressible_(first + count)) const MXMFLOAT3 *pPositions,
+                                          size_t first, size_t count, const MXMDOUBLE3 &camera,
+                                          _Out_writes_(count) MXMFLOAT3 *pRelative)
+{
+  const size_t split = first + count < shift.cursor ? first + count : (first > shift.cursor ? first : shift.cursor);
+  MXMRebasePositions(pPositions + first, split - first, MXMOriginOffset(shift.origin, camera), pRelative);
+  MXMRebasePositions(pPositions + split, first + count - split, MXMOriginOffset(shift.previousOrigin, camera),
+                     pRelative + (split - first));
+}
+
+// Converts the stored matrices [first, first + count) to matrices relative to
+// camera, using the origin matching each element. pRelative receives count
+// elements.
+inline void MXMOriginShiftRebaseMatrices(const MXMORIGINSHIFT &shift, _In_reads_(_Inexpressible_(first + count)) const MXMFLOAT4X3 *pMatrices,
+                                         size_t first, size_t count, const MXMDOUBLE3 &camera,
+                                         _Out_writes_(count) MXMFLOAT4X3 *pRelative)
+{
+  const size_t split = first + count < shift.cursor ? first + count : (first > shift.cursor ? first : shift.cursor);
+  MXMRebaseMatrices(pMatrices + first, split - first, MXMOriginOffset(shift.origin, camera), pRelative);
+  MXMRebaseMatrices(pMatrices + split, first + count - split, MXMOriginOffset(shift.previousOrigin, camera),
+                    pRelative + (split - first));
+}
+
+} //namespace DirectX
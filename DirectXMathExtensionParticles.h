@@ -0,0 +1,316 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Particle storage in SoA layout with 4-wide integrators, the PlayerCat
+  update of the README scaled to millions of particles.
+
+  MXMPARTICLES keeps one float array per component: position, velocity,
+  previous position (for Verlet), age and lifetime. The arrays are padded to
+  a multiple of four, so every kernel works on whole groups of four and the
+  padding lanes are computed but never read back.
+
+  Integrators, aging and removal work on ranges. The first index of a range
+  has to be a multiple of MXM_PARTICLES_ALIGNMENT (32, one word of the
+  expired masks) and only the last range may end inside a group of four,
+  for example chunks of MXM_PARTICLES_CHUNK_SIZE; such chunks never share
+  data and can be updated from different threads.
+
+  Spawned particles are appended. Removing particles compacts the arrays
+  stably, the surviving particles keep their relative order.
+
+  Single particles are read and written as MXMFLOAT3A, for code written
+  against MXMFLOAT3A members like MPlayerCat.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMPARTICLES particles;
+    MXMParticlesSpawn(particles, &positions[0], &velocities[0], &lifetimes[0], spawnCount);
+
+    // every frame, chunks can be distributed over threads
+    const XMVECTOR gravity = XMVectorSet(0.0f, -9.81f, 0.0f, 0.0f);
+    std::vector<uint32_t> expired(MXMParticlesMaskSize(particles));
+    for (size_t c = 0; c < MXMParticlesChunkCount(particles); ++c) {
+      size_t first, count;
+      MXMParticlesChunkRange(particles, c, first, count);
+      MXMParticlesIntegrateSemiImplicit(particles, first, count, gravity, 0.99f, dt);
+      MXMParticlesAdvanceAge(particles, first, count, dt, &expired[0]);
+    }
+    MXMParticlesRemove(particles, &expired[0]);
+
+    MXMFLOAT3A position = MXMParticlesGetPosition(particles, 0);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+
+namespace DirectX
+{
+
+#define MXM_PARTICLES_ALIGNMENT  32
+#define MXM_PARTICLES_CHUNK_SIZE 4096
+#define MXM_PARTICLES_STREAMS    11
+
+//------------------------------------------------------------------------------
+// Storage
+
+struct MXMPARTICLES
+{
+  std::vector<float> x, y, z;        // positions
+  std::vector<float> vx, vy, vz;     // velocities
+  std::vector<float> px, py, pz;     // previous positions, used by Verlet
+  std::vector<float> age, lifetime;
+  size_t count;
+
+  MXMPARTICLES() : count(0) {}
+};
+
+// All component arrays, in declaration order.
+__MXM_INLINE void MXMParticlesStreams(MXMPARTICLES &particles, _Out_writes_(MXM_PARTICLES_STREAMS) std::vector<float> **ppStreams)
+{
+  ppStreams[0] = &particles.x;
+  ppStreams[1] = &particles.y;
+  ppStreams[2] = &particles.z;
+  ppStreams[3] = &particles.vx;
+  ppStreams[4] = &particles.vy;
+  ppStreams[5] = &particles.vz;
+  ppStreams[6] = &particles.px;
+  ppStreams[7] = &particles.py;
+  ppStreams[8] = &particles.pz;
+  ppStreams[9] = &particles.age;
+  ppStreams[10] = &particles.lifetime;
+}
+
+// Resizes all arrays to hold count particles plus padding.
+inline void MXMParticlesResize(MXMPARTICLES &particles, size_t count)
+{
+  std::vector<float> *streams[MXM_PARTICLES_STREAMS];
+  MXMParticlesStreams(particles, streams);
+  const size_t padded = (count + 3) & ~(size_t)3;
+  for (int s = 0; s < MXM_PARTICLES_STREAMS; ++s)
+    streams[s]->resize(padded, 0.0f);
+  particles.count = count;
+}
+
+// Appends count particles with age zero and returns the index of the first.
+// The previous positions are set for a Verlet step with the given velocity
+// and time step dt.
+inline size_t MXMParticlesSpawn(MXMPARTICLES &particles, _In_reads_(count) const MXMFLOAT3 *pPositions,
+                                _In_reads_(count) const MXMFLOAT3 *pVelocities, _In_reads_(count) const float *pLifetimes,
+                                size_t count, float dt = 0.0f)
+{
+  const size_t first = particles.count;
+  MXMParticlesResize(particles, first + count);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t j = first + i;
+    particles.x[j] = pPositions[i].x;
+    particles.y[j] = pPositions[i].y;
+    particles.z[j] = pPositions[i].z;
+    particles.vx[j] = pVelocities[i].x;
+    particles.vy[j] = pVelocities[i].y;
+    particles.vz[j] = pVelocities[i].z;
+    particles.px[j] = pPositions[i].x - pVelocities[i].x * dt;
+    particles.py[j] = pPositions[i].y - pVelocities[i].y * dt;
+    particles.pz[j] = pPositions[i].z - pVelocities[i].z * dt;
+    particles.age[j] = 0.0f;
+    particles.lifetime[j] = pLifetimes[i];
+  }
+  return first;
+}
+
+//------------------------------------------------------------------------------
+// Single particles
+
+__MXM_INLINE MXMFLOAT3A MXMParticlesGetPosition(const MXMPARTICLES &particles, size_t i)
+{
+  return MXMFLOAT3A(particles.x[i], particles.y[i], particles.z[i]);
+}
+
+__MXM_INLINE MXMFLOAT3A MXMParticlesGetVelocity(const MXMPARTICLES &particles, size_t i)
+{
+  return MXMFLOAT3A(particles.vx[i], particles.vy[i], particles.vz[i]);
+}
+
+// Moves a particle, its previous position is moved along for Verlet.
+__MXM_INLINE void XM_CALLCONV MXMParticlesSetPosition(MXMPARTICLES &particles, size_t i, FXMVECTOR position)
+{
+  MXMFLOAT3A p(position);
+  particles.px[i] += p.x - particles.x[i];
+  particles.py[i] += p.y - particles.y[i];
+  particles.pz[i] += p.z - particles.z[i];
+  particles.x[i] = p.x;
+  particles.y[i] = p.y;
+  particles.z[i] = p.z;
+}
+
+__MXM_INLINE void XM_CALLCONV MXMParticlesSetVelocity(MXMPARTICLES &particles, size_t i, FXMVECTOR velocity)
+{
+  MXMFLOAT3A v(velocity);
+  particles.vx[i] = v.x;
+  particles.vy[i] = v.y;
+  particles.vz[i] = v.z;
+}
+
+//------------------------------------------------------------------------------
+// Chunks
+
+__MXM_INLINE size_t MXMParticlesChunkCount(const MXMPARTICLES &particles)
+{
+  return (particles.count + MXM_PARTICLES_CHUNK_SIZE - 1) / MXM_PARTICLES_CHUNK_SIZE;
+}
+
+__MXM_INLINE void MXMParticlesChunkRange(const MXMPARTICLES &particles, size_t chunk, size_t &first, size_t &count)
+{
+  first = chunk * MXM_PARTICLES_CHUNK_SIZE;
+  count = particles.count - first < MXM_PARTICLES_CHUNK_SIZE ? particles.count - first : MXM_PARTICLES_CHUNK_SIZE;
+}
+
+// Number of uint32_t words of an expired mask.
+__MXM_INLINE size_t MXMParticlesMaskSize(const MXMPARTICLES &particles)
+{
+  return (particles.count + 31) / 32;
+}
+
+//------------------------------------------------------------------------------
+// Integrators
+
+// All integrators update the particles [first, first + count) with a
+// constant acceleration; damping scales the velocity every step like the
+// friction of the README.
+
+#define MXM_PARTICLES_LOAD(stream, i)         XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&particles.stream[i]))
+#define MXM_PARTICLES_STORE(stream, i, value) XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&particles.stream[i]), value)
+
+// Explicit Euler: position += velocity * dt, velocity = (velocity + acceleration * dt) * damping.
+inline void XM_CALLCONV MXMParticlesIntegrateEuler(MXMPARTICLES &particles, size_t first, size_t count,
+                                                   FXMVECTOR acceleration, float damping, float dt)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  const XMVECTOR d = XMVectorReplicate(damping);
+  const XMVECTOR ax = XMVectorSplatX(XMVectorScale(acceleration, dt));
+  const XMVECTOR ay = XMVectorSplatY(XMVectorScale(acceleration, dt));
+  const XMVECTOR az = XMVectorSplatZ(XMVectorScale(acceleration, dt));
+  for (size_t i = first; i < first + count; i += 4) {
+    const XMVECTOR vx = MXM_PARTICLES_LOAD(vx, i);
+    const XMVECTOR vy = MXM_PARTICLES_LOAD(vy, i);
+    const XMVECTOR vz = MXM_PARTICLES_LOAD(vz, i);
+    MXM_PARTICLES_STORE(x, i, XMVectorMultiplyAdd(vx, step, MXM_PARTICLES_LOAD(x, i)));
+    MXM_PARTICLES_STORE(y, i, XMVectorMultiplyAdd(vy, step, MXM_PARTICLES_LOAD(y, i)));
+    MXM_PARTICLES_STORE(z, i, XMVectorMultiplyAdd(vz, step, MXM_PARTICLES_LOAD(z, i)));
+    MXM_PARTICLES_STORE(vx, i, XMVectorMultiply(XMVectorAdd(vx, ax), d));
+    MXM_PARTICLES_STORE(vy, i, XMVectorMultiply(XMVectorAdd(vy, ay), d));
+    MXM_PARTICLES_STORE(vz, i, XMVectorMultiply(XMVectorAdd(vz, az), d));
+  }
+}
+
+// Semi-implicit Euler: velocity = (velocity + acceleration * dt) * damping, position += velocity * dt.
+inline void XM_CALLCONV MXMParticlesIntegrateSemiImplicit(MXMPARTICLES &particles, size_t first, size_t count,
+                                                          FXMVECTOR acceleration, float damping, float dt)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  const XMVECTOR d = XMVectorReplicate(damping);
+  const XMVECTOR ax = XMVectorSplatX(XMVectorScale(acceleration, dt));
+  const XMVECTOR ay = XMVectorSplatY(XMVectorScale(acceleration, dt));
+  const XMVECTOR az = XMVectorSplatZ(XMVectorScale(acceleration, dt));
+  for (size_t i = first; i < first + count; i += 4) {
+    const XMVECTOR vx = XMVectorMultiply(XMVectorAdd(MXM_PARTICLES_LOAD(vx, i), ax), d);
+    const XMVECTOR vy = XMVectorMultiply(XMVectorAdd(MXM_PARTICLES_LOAD(vy, i), ay), d);
+    const XMVECTOR vz = XMVectorMultiply(XMVectorAdd(MXM_PARTICLES_LOAD(vz, i), az), d);
+    MXM_PARTICLES_STORE(vx, i, vx);
+    MXM_PARTICLES_STORE(vy, i, vy);
+    MXM_PARTICLES_STORE(vz, i, vz);
+    MXM_PARTICLES_STORE(x, i, XMVectorMultiplyAdd(vx, step, MXM_PARTICLES_LOAD(x, i)));
+    MXM_PARTICLES_STORE(y, i, XMVectorMultiplyAdd(vy, step, MXM_PARTICLES_LOAD(y, i)));
+    MXM_PARTICLES_STORE(z, i, XMVectorMultiplyAdd(vz, step, MXM_PARTICLES_LOAD(z, i)));
+  }
+}
+
+// Position Verlet: position += (position - previous) * damping + acceleration * dt^2.
+// Velocities are derived from the step taken.
+inline void XM_CALLCONV MXMParticlesIntegrateVerlet(MXMPARTICLES &particles, size_t first, size_t count,
+                                                    FXMVECTOR acceleration, float damping, float dt)
+{
+  const XMVECTOR d = XMVectorReplicate(damping);
+  const XMVECTOR inverseStep = XMVectorReplicate(dt > 0.0f ? 1.0f / dt : 0.0f);
+  const XMVECTOR ax = XMVectorSplatX(XMVectorScale(acceleration, dt * dt));
+  const XMVECTOR ay = XMVectorSplatY(XMVectorScale(acceleration, dt * dt));
+  const XMVECTOR az = XMVectorSplatZ(XMVectorScale(acceleration, dt * dt));
+  for (size_t i = first; i < first + count; i += 4) {
+    const XMVECTOR x = MXM_PARTICLES_LOAD(x, i);
+    const XMVECTOR y = MXM_PARTICLES_LOAD(y, i);
+    const XMVECTOR z = MXM_PARTICLES_LOAD(z, i);
+    const XMVECTOR sx = XMVectorMultiplyAdd(XMVectorSubtract(x, MXM_PARTICLES_LOAD(px, i)), d, ax);
+    const XMVECTOR sy = XMVectorMultiplyAdd(XMVectorSubtract(y, MXM_PARTICLES_LOAD(py, i)), d, ay);
+    const XMVECTOR sz = XMVectorMultiplyAdd(XMVectorSubtract(z, MXM_PARTICLES_LOAD(pz, i)), d, az);
+    MXM_PARTICLES_STORE(px, i, x);
+    MXM_PARTICLES_STORE(py, i, y);
+    MXM_PARTICLES_STORE(pz, i, z);
+    MXM_PARTICLES_STORE(x, i, XMVectorAdd(x, sx));
+    MXM_PARTICLES_STORE(y, i, XMVectorAdd(y, sy));
+    MXM_PARTICLES_STORE(z, i, XMVectorAdd(z, sz));
+    MXM_PARTICLES_STORE(vx, i, XMVectorMultiply(sx, inverseStep));
+    MXM_PARTICLES_STORE(vy, i, XMVectorMultiply(sy, inverseStep));
+    MXM_PARTICLES_STORE(vz, i, XMVectorMultiply(sz, inverseStep));
+  }
+}
+
+// Adds dt to the ages of [first, first + count) and writes a bit for every
+// particle reaching its lifetime into pExpiredMask (bit i = particle i). Bits
+// past the end of the range in the last mask word are cleared.
+inline void MXMParticlesAdvanceAge(MXMPARTICLES &particles, size_t first, size_t count, float dt, _Out_ uint32_t *pExpiredMask)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  const size_t end = first + count;
+  for (size_t word = first; word < end; word += 32) {
+    uint32_t bits = 0;
+    for (size_t i = word; i < end && i < word + 32; i += 4) {
+      const XMVECTOR age = XMVectorAdd(MXM_PARTICLES_LOAD(age, i), step);
+      MXM_PARTICLES_STORE(age, i, age);
+      bits |= MXMVectorMoveMask(XMVectorGreaterOrEqual(age, MXM_PARTICLES_LOAD(lifetime, i))) << (i - word);
+    }
+    if (end - word < 32)
+      bits &= (1u << (end - word)) - 1u;
+    pExpiredMask[word >> 5] = bits;
+  }
+}
+
+#undef MXM_PARTICLES_LOAD
+#undef MXM_PARTICLES_STORE
+
+//------------------------------------------------------------------------------
+// Removal
+
+// Removes the particles whose bit is set in pRemoveMask, keeping the order of
+// the others. Returns the number of removed particles.
+inline size_t MXMParticlesRemove(MXMPARTICLES &particles, _In_ const uint32_t *pRemoveMask)
+{
+  std::vector<float> *streams[MXM_PARTICLES_STREAMS];
+  MXMParticlesStreams(particles, streams);
+
+  size_t write = 0;
+  for (size_t i = 0; i < particles.count; ++i) {
+    // nothing to move before the first removal
+    if (write == i && !(i & 31) && !pRemoveMask[i >> 5]) {
+      write = i + 32 < particles.count ? i + 32 : particles.count;
+      i = write - 1;
+      continue;
+    }
+    if (pRemoveMask[i >> 5] & (1u << (i & 31)))
+      continue;
+    if (write != i) {
+      for (int s = 0; s < MXM_PARTICLES_STREAMS; ++s)
+        (*streams[s])[write] = (*streams[s])[i];
+    }
+    ++write;
+  }
+
+  const size_t removed = particles.count - write;
+  MXMParticlesResize(particles, write);
+  return removed;
+}
+
+} //namespace DirectX
@@ -0,0 +1,180 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Rotation part of batches of 3x3 matrices, e.g. deformation gradients of FEM
+  elements or the moment matrices of shape matching.
+
+  Matrices use the DirectXMath row vector convention. A matrix M is split
+  into M = S * XMMatrixRotationQuaternion(q), where S is the (approximately)
+  symmetric stretch and q the closest rotation as quaternion.
+
+  The rotation is extracted iteratively (Mueller et al., "A Robust Method to
+  Extract the Rotational Part of Deformations"): every iteration rotates q
+  towards the rows of M by the angular velocity that aligns them. The method
+  never produces reflections, handles degenerate and inverted matrices
+  gracefully and converges in very few iterations when q is warm started
+  with the rotation of the previous simulation step.
+
+  Four matrices are processed at once in MXMFLOAT3X3SOA packets with their
+  quaternions in SoA lanes. A packet stops iterating as soon as all four
+  lanes converged.
+
+//------------------------------------------------------------------------------
+// Example
+
+    // rotations[] holds the rotations of the last step, identity at the start
+    MXMPolarDecomposition(&deformations[0], elementCount, &rotations[0]);
+
+    // additionally writes rotation matrices and stretches
+    MXMPolarDecomposition(&deformations[0], elementCount, &rotations[0],
+                          &rotationMatrices[0], &stretches[0], 20);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <stddef.h>
+
+namespace DirectX
+{
+
+#define MXM_POLAR_DEFAULT_ITERATIONS 10
+
+// Rotation angle in radians below which a lane counts as converged.
+#define MXM_POLAR_TOLERANCE 1.0e-6f
+
+//------------------------------------------------------------------------------
+// Kernels
+
+// Rows of the rotation matrices of four quaternions given in SoA lanes.
+__MXM_INLINE void XM_CALLCONV MXMQuaternionToMatrixSoA(FXMVECTOR qx, FXMVECTOR qy, FXMVECTOR qz, GXMVECTOR qw, MXMFLOAT3X3SOA &rotations)
+{
+  const XMVECTOR one = XMVectorSplatOne();
+  const XMVECTOR x2 = XMVectorAdd(qx, qx);
+  const XMVECTOR y2 = XMVectorAdd(qy, qy);
+  const XMVECTOR z2 = XMVectorAdd(qz, qz);
+  const XMVECTOR xx = XMVectorMultiply(qx, x2), yy = XMVectorMultiply(qy, y2), zz = XMVectorMultiply(qz, z2);
+  const XMVECTOR xy = XMVectorMultiply(qx, y2), xz = XMVectorMultiply(qx, z2), yz = XMVectorMultiply(qy, z2);
+  const XMVECTOR wx = XMVectorMultiply(qw, x2), wy = XMVectorMultiply(qw, y2), wz = XMVectorMultiply(qw, z2);
+
+  rotations.m[0][0] = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+  rotations.m[0][1] = XMVectorAdd(xy, wz);
+  rotations.m[0][2] = XMVectorSubtract(xz, wy);
+  rotations.m[1][0] = XMVectorSubtract(xy, wz);
+  rotations.m[1][1] = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+  rotations.m[1][2] = XMVectorAdd(yz, wx);
+  rotations.m[2][0] = XMVectorAdd(xz, wy);
+  rotations.m[2][1] = XMVectorSubtract(yz, wx);
+  rotations.m[2][2] = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+}
+
+// Iterates the rotations (qx, qy, qz, qw) of four matrices towards their
+// rotation parts. Returns the number of iterations done.
+inline uint32_t MXMPolarRotationSoA(const MXMFLOAT3X3SOA &matrices, XMVECTOR &qx, XMVECTOR &qy, XMVECTOR &qz, XMVECTOR &qw,
+                                    uint32_t iterations = MXM_POLAR_DEFAULT_ITERATIONS)
+{
+  const XMVECTOR epsilon = XMVectorReplicate(1.0e-9f);
+  const XMVECTOR tolerance = XMVectorReplicate(MXM_POLAR_TOLERANCE);
+  const XMVECTOR half = XMVectorReplicate(0.5f);
+
+  for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+    MXMFLOAT3X3SOA r;
+    MXMQuaternionToMatrixSoA(qx, qy, qz, qw, r);
+
+    // omega = sum(r_i x a_i) / (|sum(r_i . a_i)| + epsilon), r_i and a_i rows
+    XMVECTOR ox = XMVectorZero(), oy = XMVectorZero(), oz = XMVectorZero(), dot = XMVectorZero();
+    for (int i = 0; i < 3; ++i) {
+      const XMVECTOR *ri = r.m[i];
+      const XMVECTOR *ai = matrices.m[i];
+      ox = XMVectorAdd(ox, XMVectorSubtract(XMVectorMultiply(ri[1], ai[2]), XMVectorMultiply(ri[2], ai[1])));
+      oy = XMVectorAdd(oy, XMVectorSubtract(XMVectorMultiply(ri[2], ai[0]), XMVectorMultiply(ri[0], ai[2])));
+      oz = XMVectorAdd(oz, XMVectorSubtract(XMVectorMultiply(ri[0], ai[1]), XMVectorMultiply(ri[1], ai[0])));
+      dot = XMVectorAdd(dot, XMVectorAdd(XMVectorMultiply(ri[0], ai[0]), XMVectorAdd(XMVectorMultiply(ri[1], ai[1]), XMVectorMultiply(ri[2], ai[2]))));
+    }
+    const XMVECTOR scale = XMVectorReciprocal(XMVectorAdd(XMVectorAbs(dot), epsilon));
+    ox = XMVectorMultiply(ox, scale);
+    oy = XMVectorMultiply(oy, scale);
+    oz = XMVectorMultiply(oz, scale);
+
+    const XMVECTOR angle = XMVectorSqrt(XMVectorAdd(XMVectorMultiply(ox, ox), XMVectorAdd(XMVectorMultiply(oy, oy), XMVectorMultiply(oz, oz))));
+    const XMVECTOR converged = XMVectorLess(angle, tolerance);
+    if (MXMVectorMoveMask(converged) == 0xf)
+      return iteration;
+
+    // e = exp(omega), q = e * q
+    XMVECTOR sine, cosine;
+    XMVectorSinCos(&sine, &cosine, XMVectorMultiply(angle, half));
+    sine = XMVectorSelect(XMVectorDivide(sine, angle), XMVectorZero(), converged);
+    cosine = XMVectorSelect(cosine, XMVectorSplatOne(), converged);
+    const XMVECTOR ex = XMVectorMultiply(ox, sine);
+    const XMVECTOR ey = XMVectorMultiply(oy, sine);
+    const XMVECTOR ez = XMVectorMultiply(oz, sine);
+
+    XMVECTOR nx = XMVectorAdd(XMVectorAdd(XMVectorMultiply(cosine, qx), XMVectorMultiply(qw, ex)), XMVectorSubtract(XMVectorMultiply(ey, qz), XMVectorMultiply(ez, qy)));
+    XMVECTOR ny = XMVectorAdd(XMVectorAdd(XMVectorMultiply(cosine, qy), XMVectorMultiply(qw, ey)), XMVectorSubtract(XMVectorMultiply(ez, qx), XMVectorMultiply(ex, qz)));
+    XMVECTOR nz = XMVectorAdd(XMVectorAdd(XMVectorMultiply(cosine, qz), XMVectorMultiply(qw, ez)), XMVectorSubtract(XMVectorMultiply(ex, qy), XMVectorMultiply(ey, qx)));
+    XMVECTOR nw = XMVectorSubtract(XMVectorMultiply(cosine, qw), XMVectorAdd(XMVectorMultiply(ex, qx), XMVectorAdd(XMVectorMultiply(ey, qy), XMVectorMultiply(ez, qz))));
+
+    const XMVECTOR length = XMVectorReciprocalSqrt(XMVectorAdd(XMVectorAdd(XMVectorMultiply(nx, nx), XMVectorMultiply(ny, ny)),
+                                                               XMVectorAdd(XMVectorMultiply(nz, nz), XMVectorMultiply(nw, nw))));
+    qx = XMVectorMultiply(nx, length);
+    qy = XMVectorMultiply(ny, length);
+    qz = XMVectorMultiply(nz, length);
+    qw = XMVectorMultiply(nw, length);
+  }
+  return iterations;
+}
+
+//------------------------------------------------------------------------------
+// Batches
+
+// Polar decomposition of count matrices. pRotations are read as the initial
+// guesses and overwritten with the rotations. Rotation matrices and
+// stretches (M * transpose(rotation)) are only written when not NULL.
+inline void MXMPolarDecomposition(_In_reads_(count) const MXMFLOAT3X3 *pMatrices, size_t count,
+                                  _Inout_updates_(count) MXMFLOAT4 *pRotations,
+                                  _Out_writes_opt_(count) MXMFLOAT3X3 *pRotationMatrices, _Out_writes_opt_(count) MXMFLOAT3X3 *pStretches,
+                                  uint32_t iterations = MXM_POLAR_DEFAULT_ITERATIONS)
+{
+  for (size_t i = 0; i < count; i += 4) {
+    const size_t n = count - i < 4 ? count - i : 4;
+    MXMFLOAT3X3 matrices[4];
+    MXMFLOAT4 rotations[4];
+    for (size_t k = 0; k < 4; ++k) {
+      matrices[k] = pMatrices[i + (k < n ? k : n - 1)];
+      rotations[k] = pRotations[i + (k < n ? k : n - 1)];
+    }
+
+    MXMFLOAT3X3SOA packet;
+    MXMLoadFloat3x3SoA(matrices, packet);
+    XMMATRIX q(XMLoadFloat4(&rotations[0]), XMLoadFloat4(&rotations[1]), XMLoadFloat4(&rotations[2]), XMLoadFloat4(&rotations[3]));
+    q = XMMatrixTranspose(q);
+    MXMPolarRotationSoA(packet, q.r[0], q.r[1], q.r[2], q.r[3], iterations);
+
+    MXMFLOAT3X3SOA rotationMatrices;
+    if (pRotationMatrices || pStretches) {
+      MXMQuaternionToMatrixSoA(q.r[0], q.r[1], q.r[2], q.r[3], rotationMatrices);
+      MXMStoreFloat3x3SoA(matrices, rotationMatrices);
+    }
+    q = XMMatrixTranspose(q);
+
+    for (size_t k = 0; k < n; ++k) {
+      XMStoreFloat4(&pRotations[i + k], q.r[k]);
+      if (pRotationMatrices)
+        pRotationMatrices[i + k] = matrices[k];
+      if (pStretches)
+        pStretches[i + k] = XMMatrixMultiply(pMatrices[i + k], XMMatrixTranspose(matrices[k]));
+    }
+  }
+}
+
+// Rotations only, see above.
+inline void MXMPolarDecomposition(_In_reads_(count) const MXMFLOAT3X3 *pMatrices, size_t count,
+                                  _Inout_updates_(count) MXMFLOAT4 *pRotations, uint32_t iterations = MXM_POLAR_DEFAULT_ITERATIONS)
+{
+  MXMPolarDecomposition(pMatrices, count, pRotations, NULL, NULL, iterations);
+}
+
+} //namespace DirectX
@@ -0,0 +1,191 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Stable LSD radix sort of 32 or 64 bit unsigned keys with a uint32_t value
+  per key, usually the index of the element the key was computed from.
+
+  The keys are sorted in 8 bit digits. The histograms of all digits are built
+  in a single pass over the keys, and passes in which every key has the same
+  digit are skipped. So sorting 30 bit Morton codes or depth keys that only
+  use a few of their bits takes fewer passes.
+
+  Sort order arrays produced here can be applied to MXM arrays with
+  MXMApplyOrder.
+
+  Large arrays can be sorted from several threads with the chunk functions.
+  Every pass counts the digits of each chunk into its own histogram, turns
+  all histograms into scatter offsets and then scatters each chunk; counting
+  and scattering of different chunks are independent.
+
+//------------------------------------------------------------------------------
+// Example
+
+    std::vector<uint32_t> keys(count), order(count);
+    // ... fill keys, order[i] = i ... //
+    MXMRadixSort(&keys[0], &order[0], count);
+    MXMApplyOrder(&positions[0], &order[0], count);
+
+    // chunked, the iterations of both chunk loops may run concurrently and
+    // the sorted keys end in the buffers pKeys and pValues point to last
+    for (uint32_t pass = 0; pass < MXMRadixSortPassCount(keyBits); ++pass) {
+      for (size_t c = 0; c < chunkCount; ++c)
+        MXMRadixSortHistogram(pKeys, chunkFirst[c], chunkSize[c], pass, &histograms[c * MXM_RADIX_BUCKETS]);
+      if (!MXMRadixSortPrefix(&histograms[0], chunkCount))
+        continue;
+      for (size_t c = 0; c < chunkCount; ++c)
+        MXMRadixSortScatter(pKeys, pValues, chunkFirst[c], chunkSize[c], pass, &histograms[c * MXM_RADIX_BUCKETS],
+                            pTempKeys, pTempValues);
+      std::swap(pKeys, pTempKeys);
+      std::swap(pValues, pTempValues);
+    }
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+namespace DirectX
+{
+
+#define MXM_RADIX_BITS    8
+#define MXM_RADIX_BUCKETS (1 << MXM_RADIX_BITS)
+
+// Sorts count keys and their values ascending. pTempKeys and pTempValues are
+// scratch buffers of count elements. The sorted result is always written back
+// to pKeys and pValues. keyBits limits the sort to the lower bits of the keys.
+template<typename KEY>
+inline void MXMRadixSort(_Inout_updates_(count) KEY *pKeys, _Inout_updates_(count) uint32_t *pValues, size_t count,
+                         _Out_writes_(count) KEY *pTempKeys, _Out_writes_(count) uint32_t *pTempValues,
+                         uint32_t keyBits = sizeof(KEY) * 8)
+{
+  const uint32_t passCount = (keyBits + MXM_RADIX_BITS - 1) / MXM_RADIX_BITS;
+  size_t histograms[sizeof(KEY) * 8 / MXM_RADIX_BITS][MXM_RADIX_BUCKETS];
+  memset(histograms, 0, sizeof(histograms));
+
+  for (size_t i = 0; i < count; ++i) {
+    KEY key = pKeys[i];
+    for (uint32_t pass = 0; pass < passCount; ++pass)
+      ++histograms[pass][(key >> (pass * MXM_RADIX_BITS)) & (MXM_RADIX_BUCKETS - 1)];
+  }
+
+  KEY *pSrcKeys = pKeys, *pDstKeys = pTempKeys;
+  uint32_t *pSrcValues = pValues, *pDstValues = pTempValues;
+  for (uint32_t pass = 0; pass < passCount; ++pass) {
+    size_t *histogram = histograms[pass];
+
+    // all keys share this digit, the pass would not move anything
+    if (count == 0 || histogram[(pSrcKeys[0] >> (pass * MXM_RADIX_BITS)) & (MXM_RADIX_BUCKETS - 1)] == count)
+      continue;
+
+    size_t offset = 0;
+    for (uint32_t b = 0; b < MXM_RADIX_BUCKETS; ++b) {
+      size_t bucketCount = histogram[b];
+      histogram[b] = offset;
+      offset += bucketCount;
+    }
+
+    const uint32_t shift = pass * MXM_RADIX_BITS;
+    for (size_t i = 0; i < count; ++i) {
+      KEY key = pSrcKeys[i];
+      size_t target = histogram[(key >> shift) & (MXM_RADIX_BUCKETS - 1)]++;
+      pDstKeys[target] = key;
+      pDstValues[target] = pSrcValues[i];
+    }
+
+    std::swap(pSrcKeys, pDstKeys);
+    std::swap(pSrcValues, pDstValues);
+  }
+
+  if (pSrcKeys != pKeys) {
+    memcpy(pKeys, pSrcKeys, count * sizeof(KEY));
+    memcpy(pValues, pSrcValues, count * sizeof(uint32_t));
+  }
+}
+
+// Same as above with internally allocated scratch buffers.
+template<typename KEY>
+inline void MXMRadixSort(_Inout_updates_(count) KEY *pKeys, _Inout_updates_(count) uint32_t *pValues, size_t count,
+                         uint32_t keyBits = sizeof(KEY) * 8)
+{
+  if (count < 2)
+    return;
+  std::vector<KEY> tempKeys(count);
+  std::vector<uint32_t> tempValues(count);
+  MXMRadixSort(pKeys, pValues, count, &tempKeys[0], &tempValues[0], keyBits);
+}
+
+//------------------------------------------------------------------------------
+// Chunked sorting
+
+__MXM_INLINE uint32_t MXMRadixSortPassCount(uint32_t keyBits)
+{
+  return (keyBits + MXM_RADIX_BITS - 1) / MXM_RADIX_BITS;
+}
+
+// Counts the digits of pass for the keys [first, first + count).
+template<typename KEY>
+inline void MXMRadixSortHistogram(_In_reads_(_Inexpressible_(first + count)) const KEY *pKeys, size_t first, size_t count,
+                                  uint32_t pass, _Out_writes_(MXM_RADIX_BUCKETS) size_t *pHistogram)
+{
+  memset(pHistogram, 0, MXM_RADIX_BUCKETS * sizeof(size_t));
+  const uint32_t shift = pass * MXM_RADIX_BITS;
+  for (size_t i = first; i < first + count; ++i)
+    ++pHistogram[(pKeys[i] >> shift) & (MXM_RADIX_BUCKETS - 1)];
+}
+
+// Turns the histograms of chunkCount consecutive chunks into the scatter
+// offsets of every chunk. Returns false if all keys share the digit, the
+// pass is skipped then.
+inline bool MXMRadixSortPrefix(_Inout_updates_(chunkCount * MXM_RADIX_BUCKETS) size_t *pHistograms, size_t chunkCount)
+{
+  size_t total = 0;
+  size_t largestBucket = 0;
+  for (uint32_t b = 0; b < MXM_RADIX_BUCKETS; ++b) {
+    size_t bucketCount = 0;
+    for (size_t c = 0; c < chunkCount; ++c) {
+      size_t &entry = pHistograms[c * MXM_RADIX_BUCKETS + b];
+      const size_t chunkBucketCount = entry;
+      entry = total + bucketCount;
+      bucketCount += chunkBucketCount;
+    }
+    total += bucketCount;
+    largestBucket = std::max(largestBucket, bucketCount);
+  }
+  return largestBucket != total;
+}
+
+// Scatters the keys [first, first + count) and their values by the digit of
+// pass to the offsets of their chunk.
+template<typename KEY>
+inline void MXMRadixSortScatter(_In_reads_(_Inexpressible_(first + count)) const KEY *pSrcKeys,
+                                _In_reads_(_Inexpressible_(first + count)) const uint32_t *pSrcValues,
+                                size_t first, size_t count, uint32_t pass,
+                                _Inout_updates_(MXM_RADIX_BUCKETS) size_t *pOffsets,
+                                _Out_writes_(_Inexpressible_(all keys)) KEY *pDstKeys,
+                                _Out_writes_(_Inexpressible_(all keys)) uint32_t *pDstValues)
+{
+  const uint32_t shift = pass * MXM_RADIX_BITS;
+  for (size_t i = first; i < first + count; ++i) {
+    const KEY key = pSrcKeys[i];
+    const size_t target = pOffsets[(key >> shift) & (MXM_RADIX_BUCKETS - 1)]++;
+    pDstKeys[target] = key;
+    pDstValues[target] = pSrcValues[i];
+  }
+}
+
+// Reorders an array so that pArray[i] becomes the former pArray[pOrder[i]].
+// Works for any copyable element type, e.g. all MXM memory-types.
+template<typename T>
+inline void MXMApplyOrder(_Inout_updates_(count) T *pArray, _In_reads_(count) const uint32_t *pOrder, size_t count)
+{
+  std::vector<T> source(pArray, pArray + count);
+  for (size_t i = 0; i < count; ++i)
+    pArray[i] = source[pOrder[i]];
+}
+
+} //namespace DirectX
@@ -0,0 +1,323 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Rays and ray packets for the spatial structures of the extension headers.
+
+  A single ray is an origin and a direction XMVECTOR. MXMRAYPACKET4 holds four
+  rays in SoA layout (one XMVECTOR per component) together with the reciprocal
+  directions and the current maximum distance of every ray, so a packet can be
+  tested against one box or triangle with straight XMVECTOR math.
+
+  Packets of 8 and 16 rays (MXMRAYPACKET8, MXMRAYPACKET16) are groups of four
+  ray packets. Triangles are splatted once into a MXMRAYTRIANGLE4 and then
+  tested against all groups, which amortizes the triangle setup.
+
+  Two query modes exist for lists of triangles:
+  - closest hit: shrinks tMax of every ray and records the hit triangle
+  - any hit: returns which rays hit anything and stops as soon as all did
+
+  Rays with tMax < 0 never hit and are used to pad partially filled packets.
+  DirectXMathExtensionRayBenchmark.cpp compares the packet closest hit query
+  with per-ray TriangleTests::Intersects.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMRAYPACKET16 packet;
+    MXMRayPacketLoad(packet, origins + i, directions + i, rayCount - i, maxDistance);
+
+    uint32_t hitTriangles[16];
+    uint32_t hitMask = MXMRayPacketIntersectTriangles(packet, vertices, triangleCount, hitTriangles);
+
+    uint32_t occludedMask = MXMRayPacketOccluded(packet, vertices, triangleCount);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+namespace DirectX
+{
+
+//------------------------------------------------------------------------------
+// Single rays
+
+// Moeller-Trumbore intersection of a ray with a triangle. Returns true and the
+// distance in t if the ray hits the triangle in front of its origin. Both
+// faces are hit.
+__MXM_INLINE bool XM_CALLCONV MXMRayIntersectTriangle(FXMVECTOR origin, FXMVECTOR direction,
+                                                      FXMVECTOR v0, GXMVECTOR v1, HXMVECTOR v2, float &t)
+{
+  XMVECTOR e1 = XMVectorSubtract(v1, v0);
+  XMVECTOR e2 = XMVectorSubtract(v2, v0);
+  XMVECTOR p = XMVector3Cross(direction, e2);
+  float det = XMVectorGetX(XMVector3Dot(e1, p));
+  if (det > -1e-12f && det < 1e-12f)
+    return false;
+
+  float invDet = 1.0f / det;
+  XMVECTOR s = XMVectorSubtract(origin, v0);
+  float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+  if (u < 0.0f || u > 1.0f)
+    return false;
+
+  XMVECTOR q = XMVector3Cross(s, e1);
+  float v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+  if (v < 0.0f || u + v > 1.0f)
+    return false;
+
+  t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+  return t >= 0.0f;
+}
+
+//------------------------------------------------------------------------------
+// Ray packets
+
+struct MXMRAYPACKET4
+{
+  XMVECTOR originX, originY, originZ;
+  XMVECTOR directionX, directionY, directionZ;
+  XMVECTOR invDirectionX, invDirectionY, invDirectionZ;
+  XMVECTOR tMax;                        // maximum distance, shrinks on hits
+
+  __MXM_INLINE MXMRAYPACKET4() {}
+};
+
+// Loads four rays from MXMFLOAT3 arrays into a packet.
+__MXM_INLINE void MXMRayPacketLoad(MXMRAYPACKET4 &packet,
+                                   _In_reads_(4) const MXMFLOAT3 *pOrigins, _In_reads_(4) const MXMFLOAT3 *pDirections,
+                                   float tMax)
+{
+  MXMLoadFloat3SoA(pOrigins, packet.originX, packet.originY, packet.originZ);
+  MXMLoadFloat3SoA(pDirections, packet.directionX, packet.directionY, packet.directionZ);
+  packet.invDirectionX = XMVectorReciprocal(packet.directionX);
+  packet.invDirectionY = XMVectorReciprocal(packet.directionY);
+  packet.invDirectionZ = XMVectorReciprocal(packet.directionZ);
+  packet.tMax = XMVectorReplicate(tMax);
+}
+
+// Loads up to four rays. Missing rays repeat the last one with tMax = -1 and
+// never hit anything.
+inline void MXMRayPacketLoad(MXMRAYPACKET4 &packet,
+                             _In_reads_(rayCount) const MXMFLOAT3 *pOrigins, _In_reads_(rayCount) const MXMFLOAT3 *pDirections,
+                             size_t rayCount, float tMax)
+{
+  if (rayCount >= 4) {
+    MXMRayPacketLoad(packet, pOrigins, pDirections, tMax);
+    return;
+  }
+
+  MXMFLOAT3 origins[4], directions[4];
+  float distances[4];
+  for (size_t r = 0; r < 4; ++r) {
+    const size_t i = r < rayCount ? r : (rayCount ? rayCount - 1 : 0);
+    origins[r] = rayCount ? pOrigins[i] : MXMFLOAT3(0.0f, 0.0f, 0.0f);
+    directions[r] = rayCount ? pDirections[i] : MXMFLOAT3(0.0f, 0.0f, 1.0f);
+    distances[r] = r < rayCount ? tMax : -1.0f;
+  }
+  MXMRayPacketLoad(packet, origins, directions, tMax);
+  packet.tMax = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(distances));
+}
+
+// Slab test of the four rays of a packet against one box. Returns a mask with
+// all bits set for the rays entering the box before their tMax.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMRayPacketIntersectBox(const MXMRAYPACKET4 &packet, FXMVECTOR boxMin, FXMVECTOR boxMax)
+{
+  XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatX(boxMin), packet.originX), packet.invDirectionX);
+  XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatX(boxMax), packet.originX), packet.invDirectionX);
+  XMVECTOR tNear = XMVectorMin(t0, t1);
+  XMVECTOR tFar = XMVectorMax(t0, t1);
+
+  t0 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatY(boxMin), packet.originY), packet.invDirectionY);
+  t1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatY(boxMax), packet.originY), packet.invDirectionY);
+  tNear = XMVectorMax(tNear, XMVectorMin(t0, t1));
+  tFar = XMVectorMin(tFar, XMVectorMax(t0, t1));
+
+  t0 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatZ(boxMin), packet.originZ), packet.invDirectionZ);
+  t1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatZ(boxMax), packet.originZ), packet.invDirectionZ);
+  tNear = XMVectorMax(tNear, XMVectorMin(t0, t1));
+  tFar = XMVectorMin(tFar, XMVectorMax(t0, t1));
+
+  tNear = XMVectorMax(tNear, XMVectorZero());
+  tFar = XMVectorMin(tFar, packet.tMax);
+  return XMVectorLessOrEqual(tNear, tFar);
+}
+
+//------------------------------------------------------------------------------
+// Ray packet vs. triangle
+
+// Triangle with its first vertex and both edges splatted into all components,
+// prepared once and tested against any number of ray packets.
+struct MXMRAYTRIANGLE4
+{
+  XMVECTOR v0X, v0Y, v0Z;
+  XMVECTOR e1X, e1Y, e1Z;
+  XMVECTOR e2X, e2Y, e2Z;
+
+  __MXM_INLINE MXMRAYTRIANGLE4() {}
+};
+
+__MXM_INLINE void XM_CALLCONV MXMRayTriangleLoad(MXMRAYTRIANGLE4 &triangle, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2)
+{
+  XMVECTOR e1 = XMVectorSubtract(v1, v0);
+  XMVECTOR e2 = XMVectorSubtract(v2, v0);
+  triangle.v0X = XMVectorSplatX(v0); triangle.v0Y = XMVectorSplatY(v0); triangle.v0Z = XMVectorSplatZ(v0);
+  triangle.e1X = XMVectorSplatX(e1); triangle.e1Y = XMVectorSplatY(e1); triangle.e1Z = XMVectorSplatZ(e1);
+  triangle.e2X = XMVectorSplatX(e2); triangle.e2Y = XMVectorSplatY(e2); triangle.e2Z = XMVectorSplatZ(e2);
+}
+
+// Moeller-Trumbore intersection of the four rays of a packet with one
+// triangle. Returns a mask with all bits set for the rays hitting the triangle
+// in [0, tMax) and their distances in t.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMRayPacketIntersectTriangle(const MXMRAYPACKET4 &packet, const MXMRAYTRIANGLE4 &triangle, XMVECTOR &t)
+{
+  // p = direction x e2
+  XMVECTOR pX = XMVectorSubtract(XMVectorMultiply(packet.directionY, triangle.e2Z), XMVectorMultiply(packet.directionZ, triangle.e2Y));
+  XMVECTOR pY = XMVectorSubtract(XMVectorMultiply(packet.directionZ, triangle.e2X), XMVectorMultiply(packet.directionX, triangle.e2Z));
+  XMVECTOR pZ = XMVectorSubtract(XMVectorMultiply(packet.directionX, triangle.e2Y), XMVectorMultiply(packet.directionY, triangle.e2X));
+  XMVECTOR det = XMVectorMultiplyAdd(triangle.e1X, pX, XMVectorMultiplyAdd(triangle.e1Y, pY, XMVectorMultiply(triangle.e1Z, pZ)));
+  XMVECTOR invDet = XMVectorReciprocal(det);
+
+  XMVECTOR sX = XMVectorSubtract(packet.originX, triangle.v0X);
+  XMVECTOR sY = XMVectorSubtract(packet.originY, triangle.v0Y);
+  XMVECTOR sZ = XMVectorSubtract(packet.originZ, triangle.v0Z);
+  XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(sX, pX, XMVectorMultiplyAdd(sY, pY, XMVectorMultiply(sZ, pZ))), invDet);
+
+  // q = s x e1
+  XMVECTOR qX = XMVectorSubtract(XMVectorMultiply(sY, triangle.e1Z), XMVectorMultiply(sZ, triangle.e1Y));
+  XMVECTOR qY = XMVectorSubtract(XMVectorMultiply(sZ, triangle.e1X), XMVectorMultiply(sX, triangle.e1Z));
+  XMVECTOR qZ = XMVectorSubtract(XMVectorMultiply(sX, triangle.e1Y), XMVectorMultiply(sY, triangle.e1X));
+  XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(packet.directionX, qX, XMVectorMultiplyAdd(packet.directionY, qY, XMVectorMultiply(packet.directionZ, qZ))), invDet);
+  t = XMVectorMultiply(XMVectorMultiplyAdd(triangle.e2X, qX, XMVectorMultiplyAdd(triangle.e2Y, qY, XMVectorMultiply(triangle.e2Z, qZ))), invDet);
+
+  const XMVECTOR zero = XMVectorZero();
+  XMVECTOR hit = XMVectorGreater(XMVectorAbs(det), XMVectorReplicate(1e-12f));
+  hit = XMVectorAndInt(hit, XMVectorGreaterOrEqual(u, zero));
+  hit = XMVectorAndInt(hit, XMVectorGreaterOrEqual(v, zero));
+  hit = XMVectorAndInt(hit, XMVectorLessOrEqual(XMVectorAdd(u, v), XMVectorSplatOne()));
+  hit = XMVectorAndInt(hit, XMVectorGreaterOrEqual(t, zero));
+  return XMVectorAndInt(hit, XMVectorLess(t, packet.tMax));
+}
+
+// Closest hit update for one triangle: rays hitting it move their tMax to the
+// hit distance and get index written into hitTriangles (one uint32_t per ray).
+// Returns the mask of updated rays.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMRayPacketClosestHit(MXMRAYPACKET4 &packet, const MXMRAYTRIANGLE4 &triangle,
+                                                         uint32_t index, XMVECTOR &hitTriangles)
+{
+  XMVECTOR t;
+  XMVECTOR hit = MXMRayPacketIntersectTriangle(packet, triangle, t);
+  packet.tMax = XMVectorSelect(packet.tMax, t, hit);
+  hitTriangles = XMVectorSelect(hitTriangles, XMVectorReplicateInt(index), hit);
+  return hit;
+}
+
+// Closest hits of a packet against a list of triangles with three vertices
+// each. pHitTriangles receives the triangle index per ray, 0xFFFFFFFF for
+// misses, packet.tMax the hit distances. Returns a bitmask of the rays hit.
+inline uint32_t MXMRayPacketIntersectTriangles(MXMRAYPACKET4 &packet, _In_reads_(triangleCount * 3) const MXMFLOAT3 *pVertices,
+                                               size_t triangleCount, _Out_writes_(4) uint32_t *pHitTriangles)
+{
+  XMVECTOR hitTriangles = XMVectorTrueInt();
+  XMVECTOR hitMask = XMVectorFalseInt();
+  for (size_t i = 0; i < triangleCount; ++i) {
+    MXMRAYTRIANGLE4 triangle;
+    MXMRayTriangleLoad(triangle, pVertices[i * 3], pVertices[i * 3 + 1], pVertices[i * 3 + 2]);
+    hitMask = XMVectorOrInt(hitMask, MXMRayPacketClosestHit(packet, triangle, (uint32_t)i, hitTriangles));
+  }
+  XMStoreInt4(pHitTriangles, hitTriangles);
+  return MXMVectorMoveMask(hitMask);
+}
+
+// Any hit of a packet against a list of triangles. Returns a bitmask of the
+// rays hitting at least one triangle before their tMax.
+inline uint32_t MXMRayPacketOccluded(const MXMRAYPACKET4 &packet, _In_reads_(triangleCount * 3) const MXMFLOAT3 *pVertices,
+                                     size_t triangleCount)
+{
+  const uint32_t active = MXMVectorMoveMask(XMVectorGreater(packet.tMax, XMVectorZero()));
+  uint32_t hitMask = 0;
+  for (size_t i = 0; i < triangleCount && hitMask != active; ++i) {
+    MXMRAYTRIANGLE4 triangle;
+    MXMRayTriangleLoad(triangle, pVertices[i * 3], pVertices[i * 3 + 1], pVertices[i * 3 + 2]);
+    XMVECTOR t;
+    hitMask |= MXMVectorMoveMask(MXMRayPacketIntersectTriangle(packet, triangle, t));
+  }
+  return hitMask;
+}
+
+//------------------------------------------------------------------------------
+// Packets of 8 and 16 rays
+
+template<size_t GROUPS>
+struct MXMRAYPACKETGROUP
+{
+  MXMRAYPACKET4 packets[GROUPS];
+};
+
+typedef MXMRAYPACKETGROUP<2> MXMRAYPACKET8;
+typedef MXMRAYPACKETGROUP<4> MXMRAYPACKET16;
+
+// Loads up to 4 * GROUPS rays, missing rays never hit.
+template<size_t GROUPS>
+inline void MXMRayPacketLoad(MXMRAYPACKETGROUP<GROUPS> &packet,
+                             _In_reads_(rayCount) const MXMFLOAT3 *pOrigins, _In_reads_(rayCount) const MXMFLOAT3 *pDirections,
+                             size_t rayCount, float tMax)
+{
+  for (size_t g = 0; g < GROUPS; ++g) {
+    const size_t first = g * 4 < rayCount ? g * 4 : (rayCount ? rayCount - 1 : 0);
+    const size_t count = g * 4 < rayCount ? rayCount - g * 4 : 0;
+    MXMRayPacketLoad(packet.packets[g], pOrigins + first, pDirections + first, count, tMax);
+  }
+}
+
+// Closest hits of all rays of the group, see the four ray version.
+// pHitTriangles receives 4 * GROUPS indices, bit i of the result is ray i.
+template<size_t GROUPS>
+inline uint32_t MXMRayPacketIntersectTriangles(MXMRAYPACKETGROUP<GROUPS> &packet, _In_reads_(triangleCount * 3) const MXMFLOAT3 *pVertices,
+                                               size_t triangleCount, _Out_writes_(GROUPS * 4) uint32_t *pHitTriangles)
+{
+  XMVECTOR hitTriangles[GROUPS];
+  XMVECTOR hitMask[GROUPS];
+  for (size_t g = 0; g < GROUPS; ++g) {
+    hitTriangles[g] = XMVectorTrueInt();
+    hitMask[g] = XMVectorFalseInt();
+  }
+
+  for (size_t i = 0; i < triangleCount; ++i) {
+    MXMRAYTRIANGLE4 triangle;
+    MXMRayTriangleLoad(triangle, pVertices[i * 3], pVertices[i * 3 + 1], pVertices[i * 3 + 2]);
+    for (size_t g = 0; g < GROUPS; ++g)
+      hitMask[g] = XMVectorOrInt(hitMask[g], MXMRayPacketClosestHit(packet.packets[g], triangle, (uint32_t)i, hitTriangles[g]));
+  }
+
+  uint32_t result = 0;
+  for (size_t g = 0; g < GROUPS; ++g) {
+    XMStoreInt4(pHitTriangles + g * 4, hitTriangles[g]);
+    result |= MXMVectorMoveMask(hitMask[g]) << (g * 4);
+  }
+  return result;
+}
+
+// Any hits of all rays of the group, bit i of the result is ray i.
+template<size_t GROUPS>
+inline uint32_t MXMRayPacketOccluded(const MXMRAYPACKETGROUP<GROUPS> &packet, _In_reads_(triangleCount * 3) const MXMFLOAT3 *pVertices,
+                                     size_t triangleCount)
+{
+  uint32_t active = 0;
+  for (size_t g = 0; g < GROUPS; ++g)
+    active |= MXMVectorMoveMask(XMVectorGreater(packet.packets[g].tMax, XMVectorZero())) << (g * 4);
+
+  uint32_t hitMask = 0;
+  for (size_t i = 0; i < triangleCount && hitMask != active; ++i) {
+    MXMRAYTRIANGLE4 triangle;
+    MXMRayTriangleLoad(triangle, pVertices[i * 3], pVertices[i * 3 + 1], pVertices[i * 3 + 2]);
+    for (size_t g = 0; g < GROUPS; ++g) {
+      XMVECTOR t;
+      hitMask |= MXMVectorMoveMask(MXMRayPacketIntersectTriangle(packet.packets[g], triangle, t)) << (g * 4);
+    }
+  }
+  return hitMask;
+}
+
+} //namespace DirectX
@@ -0,0 +1,95 @@
+/*------------------------------------------------------------------------------
+// INFO
+
+  Minimal timing program for DirectXMathExtensionRay.h.
+
+  Closest hits of a set of random rays against a list of random triangles,
+  once per ray with TriangleTests::Intersects of DirectXCollision.h and once
+  with MXMRayPacketIntersectTriangles on packets of 16 rays. Both runs have
+  to find the same number of hits; the ray-triangle tests per second of both
+  and the speedup of the packets are printed.
+
+  Build with optimizations, e.g.
+    g++ -O2 -msse2 DirectXMathExtensionRayBenchmark.cpp
+  and run with optional ray and triangle counts (default 4096 and 256).
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionRay.h"
+
+#include <DirectXCollision.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+using namespace DirectX;
+
+static float Random()
+{
+  return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+int main(int argc, char **argv)
+{
+  const size_t rayCount = argc > 1 ? (size_t)atoi(argv[1]) : 4096;
+  const size_t triangleCount = argc > 2 ? (size_t)atoi(argv[2]) : 256;
+  const float tMax = 1000.0f;
+
+  // triangles scattered in a box in front of rays starting around the origin
+  srand(1);
+  std::vector<MXMFLOAT3> vertices(triangleCount * 3);
+  for (size_t i = 0; i < triangleCount; ++i) {
+    const XMVECTOR center = XMVectorSet(Random() * 10.0f, Random() * 10.0f, 20.0f + Random() * 10.0f, 0.0f);
+    for (size_t k = 0; k < 3; ++k)
+      vertices[i * 3 + k] = XMVectorAdd(center, XMVectorSet(Random() * 2.0f, Random() * 2.0f, Random() * 2.0f, 0.0f));
+  }
+
+  // TriangleTests::Intersects expects normalized directions
+  std::vector<MXMFLOAT3> origins(rayCount), directions(rayCount);
+  for (size_t i = 0; i < rayCount; ++i) {
+    origins[i] = XMVectorSet(Random(), Random(), Random(), 0.0f);
+    directions[i] = XMVector3Normalize(XMVectorSet(Random() * 0.4f, Random() * 0.4f, 1.0f, 0.0f));
+  }
+
+  // per ray
+  size_t singleHits = 0;
+  clock_t start = clock();
+  for (size_t r = 0; r < rayCount; ++r) {
+    const XMVECTOR origin = origins[r], direction = directions[r];
+    float closest = tMax;
+    bool hit = false;
+    for (size_t i = 0; i < triangleCount; ++i) {
+      float t;
+      if (TriangleTests::Intersects(origin, direction, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2], t) &&
+          t < closest) {
+        closest = t;
+        hit = true;
+      }
+    }
+    singleHits += hit ? 1 : 0;
+  }
+  const double singleSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  // packets of 16 rays
+  size_t packetHits = 0;
+  start = clock();
+  for (size_t r = 0; r < rayCount; r += 16) {
+    MXMRAYPACKET16 packet;
+    MXMRayPacketLoad(packet, &origins[r], &directions[r], rayCount - r, tMax);
+    uint32_t hitTriangles[16];
+    for (uint32_t mask = MXMRayPacketIntersectTriangles(packet, &vertices[0], triangleCount, hitTriangles); mask; mask &= mask - 1)
+      ++packetHits;
+  }
+  const double packetSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  const double tests = (double)rayCount * (double)triangleCount;
+  printf("%u rays, %u triangles\n", (unsigned)rayCount, (unsigned)triangleCount);
+  printf("TriangleTests::Intersects       %7.1f M tests/s, %u hits\n",
+         tests / singleSeconds * 1.0e-6, (unsigned)singleHits);
+  printf("MXMRayPacketIntersectTriangles  %7.1f M tests/s, %u hits\n",
+         tests / packetSeconds * 1.0e-6, (unsigned)packetHits);
+  printf("packet speedup                  %7.2fx\n", singleSeconds / packetSeconds);
+  return singleHits == packetHits ? 0 : 1;
+}
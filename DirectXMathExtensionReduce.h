@@ -0,0 +1,335 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Reductions over MXMFLOAT3 arrays: bounds, centroid and covariance.
+
+  The kernels load four points at a time into SoA registers and keep
+  separate XMVECTOR accumulators per quantity and lane, so consecutive
+  additions do not wait on each other. Bounds and centroid additionally work
+  on eight points per step with two sets of accumulators.
+
+  MXMPOINTSTATS collects bounds, sums and sums of products of a range of
+  points in one pass. The sums are taken relative to a shift, usually the
+  first point, so the covariance does not suffer from cancellation far from
+  the origin. Stats of different ranges with the same shift are merged by
+  adding them up.
+
+  MXMComputePointStats splits the array into chunks of fixed size and merges
+  the chunk results pairwise in a fixed tree (MXMReduceTree). The result only
+  depends on the chunk size, never on how the chunks are distributed, so the
+  chunks may be computed concurrently while staying deterministic. Pairwise
+  summation also keeps the rounding error of large arrays small.
+
+//------------------------------------------------------------------------------
+// Example
+
+    XMVECTOR boundsMin, boundsMax;
+    MXMComputeBounds(&points[0], count, boundsMin, boundsMax);
+
+    XMVECTOR centroid;
+    MXMFLOAT3X3 covariance;
+    MXMComputeCovariance(&points[0], count, centroid, covariance);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <float.h>
+
+namespace DirectX
+{
+
+#define MXM_REDUCE_CHUNK_SIZE 4096
+
+//------------------------------------------------------------------------------
+// Horizontal reductions
+
+// Returns the minimum, maximum or sum of the four components in all components.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalMin(FXMVECTOR v)
+{
+  XMVECTOR t = XMVectorMin(v, XMVectorSwizzle<2, 3, 0, 1>(v));
+  return XMVectorMin(t, XMVectorSwizzle<1, 0, 3, 2>(t));
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalMax(FXMVECTOR v)
+{
+  XMVECTOR t = XMVectorMax(v, XMVectorSwizzle<2, 3, 0, 1>(v));
+  return XMVectorMax(t, XMVectorSwizzle<1, 0, 3, 2>(t));
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalSum(FXMVECTOR v)
+{
+  XMVECTOR t = XMVectorAdd(v, XMVectorSwizzle<2, 3, 0, 1>(v));
+  return XMVectorAdd(t, XMVectorSwizzle<1, 0, 3, 2>(t));
+}
+
+// Combines three SoA accumulators into the x, y and z components of one vector.
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalMin3(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+  return XMVectorSelect(XMVectorSelect(MXMVectorHorizontalMin(x), MXMVectorHorizontalMin(y), g_XMSelect0101),
+                        MXMVectorHorizontalMin(z), g_XMSelect0011);
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalMax3(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+  return XMVectorSelect(XMVectorSelect(MXMVectorHorizontalMax(x), MXMVectorHorizontalMax(y), g_XMSelect0101),
+                        MXMVectorHorizontalMax(z), g_XMSelect0011);
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMVectorHorizontalSum3(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+  return XMVectorSelect(XMVectorSelect(MXMVectorHorizontalSum(x), MXMVectorHorizontalSum(y), g_XMSelect0101),
+                        MXMVectorHorizontalSum(z), g_XMSelect0011);
+}
+
+//------------------------------------------------------------------------------
+// Reduction tree
+
+// Merges count partial results pairwise in a fixed tree, the result ends up in
+// pPartials[0]. merge(a, b) returns the merged result of a and b. The tree
+// only depends on count, so equal partials always give a bit-identical result.
+template<typename T, typename MERGE>
+inline void MXMReduceTree(_Inout_updates_(count) T *pPartials, size_t count, const MERGE &merge)
+{
+  for (size_t step = 1; step < count; step *= 2) {
+    for (size_t i = 0; i + step < count; i += step * 2)
+      pPartials[i] = merge(pPartials[i], pPartials[i + step]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Bounds and centroid
+
+inline void XM_CALLCONV MXMComputeBounds(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count,
+                                         XMVECTOR &boundsMin, XMVECTOR &boundsMax)
+{
+  XMVECTOR minX0 = XMVectorReplicate(FLT_MAX), minY0 = minX0, minZ0 = minX0;
+  XMVECTOR maxX0 = XMVectorReplicate(-FLT_MAX), maxY0 = maxX0, maxZ0 = maxX0;
+  XMVECTOR minX1 = minX0, minY1 = minX0, minZ1 = minX0;
+  XMVECTOR maxX1 = maxX0, maxY1 = maxX0, maxZ1 = maxX0;
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    XMVECTOR x0, y0, z0, x1, y1, z1;
+    MXMLoadFloat3SoA(pPoints + i, x0, y0, z0);
+    MXMLoadFloat3SoA(pPoints + i + 4, x1, y1, z1);
+    minX0 = XMVectorMin(minX0, x0); maxX0 = XMVectorMax(maxX0, x0);
+    minY0 = XMVectorMin(minY0, y0); maxY0 = XMVectorMax(maxY0, y0);
+    minZ0 = XMVectorMin(minZ0, z0); maxZ0 = XMVectorMax(maxZ0, z0);
+    minX1 = XMVectorMin(minX1, x1); maxX1 = XMVectorMax(maxX1, x1);
+    minY1 = XMVectorMin(minY1, y1); maxY1 = XMVectorMax(maxY1, y1);
+    minZ1 = XMVectorMin(minZ1, z1); maxZ1 = XMVectorMax(maxZ1, z1);
+  }
+
+  boundsMin = MXMVectorHorizontalMin3(XMVectorMin(minX0, minX1), XMVectorMin(minY0, minY1), XMVectorMin(minZ0, minZ1));
+  boundsMax = MXMVectorHorizontalMax3(XMVectorMax(maxX0, maxX1), XMVectorMax(maxY0, maxY1), XMVectorMax(maxZ0, maxZ1));
+  for (; i < count; ++i) {
+    XMVECTOR p = pPoints[i];
+    boundsMin = XMVectorMin(boundsMin, p);
+    boundsMax = XMVectorMax(boundsMax, p);
+  }
+}
+
+// Returns the sum of count points, summed in lanes and chunks to keep the
+// rounding error low.
+inline XMVECTOR MXMComputeSum(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count)
+{
+  XMVECTOR sumX0 = XMVectorZero(), sumY0 = sumX0, sumZ0 = sumX0;
+  XMVECTOR sumX1 = sumX0, sumY1 = sumX0, sumZ1 = sumX0;
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    XMVECTOR x0, y0, z0, x1, y1, z1;
+    MXMLoadFloat3SoA(pPoints + i, x0, y0, z0);
+    MXMLoadFloat3SoA(pPoints + i + 4, x1, y1, z1);
+    sumX0 = XMVectorAdd(sumX0, x0); sumY0 = XMVectorAdd(sumY0, y0); sumZ0 = XMVectorAdd(sumZ0, z0);
+    sumX1 = XMVectorAdd(sumX1, x1); sumY1 = XMVectorAdd(sumY1, y1); sumZ1 = XMVectorAdd(sumZ1, z1);
+  }
+
+  XMVECTOR sum = MXMVectorHorizontalSum3(XMVectorAdd(sumX0, sumX1), XMVectorAdd(sumY0, sumY1), XMVectorAdd(sumZ0, sumZ1));
+  for (; i < count; ++i)
+    sum = XMVectorAdd(sum, pPoints[i]);
+  return sum;
+}
+
+struct MXMREDUCEFLOAT3ADD
+{
+  MXMFLOAT3 operator()(const MXMFLOAT3 &a, const MXMFLOAT3 &b) const { return XMVectorAdd(a, b); }
+};
+
+inline XMVECTOR MXMComputeCentroid(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count)
+{
+  if (!count)
+    return XMVectorZero();
+
+  const size_t chunkCount = (count + MXM_REDUCE_CHUNK_SIZE - 1) / MXM_REDUCE_CHUNK_SIZE;
+  std::vector<MXMFLOAT3> sums(chunkCount);
+  for (size_t c = 0; c < chunkCount; ++c) {
+    const size_t first = c * MXM_REDUCE_CHUNK_SIZE;
+    const size_t chunk = count - first < MXM_REDUCE_CHUNK_SIZE ? count - first : MXM_REDUCE_CHUNK_SIZE;
+    sums[c] = MXMComputeSum(pPoints + first, chunk);
+  }
+
+  MXMReduceTree(&sums[0], chunkCount, MXMREDUCEFLOAT3ADD());
+  return XMVectorScale(sums[0], 1.0f / (float)count);
+}
+
+//------------------------------------------------------------------------------
+// Bounds, centroid and covariance in one pass
+
+struct MXMPOINTSTATS
+{
+  MXMFLOAT3 boundsMin, boundsMax;
+  MXMFLOAT3 shift;                   // all sums are relative to this point
+  MXMFLOAT3 sum;                     // sum of (p - shift)
+  float sumXX, sumXY, sumXZ;         // sums of products of (p - shift)
+  float sumYY, sumYZ, sumZZ;
+  size_t count;
+
+  MXMPOINTSTATS() : boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+                    shift(0.0f, 0.0f, 0.0f), sum(0.0f, 0.0f, 0.0f),
+                    sumXX(0.0f), sumXY(0.0f), sumXZ(0.0f), sumYY(0.0f), sumYZ(0.0f), sumZZ(0.0f), count(0) {}
+};
+
+// Stats of the points [first, first + count) relative to shift.
+inline MXMPOINTSTATS XM_CALLCONV MXMComputePointStatsRange(_In_ const MXMFLOAT3 *pPoints, size_t first, size_t count, FXMVECTOR shift)
+{
+  const XMVECTOR shiftX = XMVectorSplatX(shift), shiftY = XMVectorSplatY(shift), shiftZ = XMVectorSplatZ(shift);
+  XMVECTOR minX = XMVectorReplicate(FLT_MAX), minY = minX, minZ = minX;
+  XMVECTOR maxX = XMVectorReplicate(-FLT_MAX), maxY = maxX, maxZ = maxX;
+  XMVECTOR sX = XMVectorZero(), sY = sX, sZ = sX;
+  XMVECTOR sXX = sX, sXY = sX, sXZ = sX, sYY = sX, sYZ = sX, sZZ = sX;
+
+  const MXMFLOAT3 *p = pPoints + first;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    XMVECTOR x, y, z;
+    MXMLoadFloat3SoA(p + i, x, y, z);
+    minX = XMVectorMin(minX, x); maxX = XMVectorMax(maxX, x);
+    minY = XMVectorMin(minY, y); maxY = XMVectorMax(maxY, y);
+    minZ = XMVectorMin(minZ, z); maxZ = XMVectorMax(maxZ, z);
+
+    x = XMVectorSubtract(x, shiftX);
+    y = XMVectorSubtract(y, shiftY);
+    z = XMVectorSubtract(z, shiftZ);
+    sX = XMVectorAdd(sX, x);
+    sY = XMVectorAdd(sY, y);
+    sZ = XMVectorAdd(sZ, z);
+    sXX = XMVectorAdd(sXX, XMVectorMultiply(x, x));
+    sXY = XMVectorAdd(sXY, XMVectorMultiply(x, y));
+    sXZ = XMVectorAdd(sXZ, XMVectorMultiply(x, z));
+    sYY = XMVectorAdd(sYY, XMVectorMultiply(y, y));
+    sYZ = XMVectorAdd(sYZ, XMVectorMultiply(y, z));
+    sZZ = XMVectorAdd(sZZ, XMVectorMultiply(z, z));
+  }
+
+  MXMPOINTSTATS stats;
+  stats.shift = shift;
+  stats.count = count;
+  XMVECTOR boundsMin = MXMVectorHorizontalMin3(minX, minY, minZ);
+  XMVECTOR boundsMax = MXMVectorHorizontalMax3(maxX, maxY, maxZ);
+  XMVECTOR s = MXMVectorHorizontalSum3(sX, sY, sZ);
+  XMFLOAT4 products0, products1;
+  XMStoreFloat4(&products0, MXMVectorHorizontalSum3(sXX, sXY, sXZ));
+  XMStoreFloat4(&products1, MXMVectorHorizontalSum3(sYY, sYZ, sZZ));
+
+  for (; i < count; ++i) {
+    XMVECTOR point = p[i];
+    boundsMin = XMVectorMin(boundsMin, point);
+    boundsMax = XMVectorMax(boundsMax, point);
+    XMVECTOR d = XMVectorSubtract(point, shift);
+    s = XMVectorAdd(s, d);
+
+    XMFLOAT3 v;
+    XMStoreFloat3(&v, d);
+    products0.x += v.x * v.x; products0.y += v.x * v.y; products0.z += v.x * v.z;
+    products1.x += v.y * v.y; products1.y += v.y * v.z; products1.z += v.z * v.z;
+  }
+
+  stats.boundsMin = boundsMin;
+  stats.boundsMax = boundsMax;
+  stats.sum = s;
+  stats.sumXX = products0.x; stats.sumXY = products0.y; stats.sumXZ = products0.z;
+  stats.sumYY = products1.x; stats.sumYZ = products1.y; stats.sumZZ = products1.z;
+  return stats;
+}
+
+// Merges the stats of two ranges computed with the same shift.
+inline MXMPOINTSTATS MXMMergePointStats(const MXMPOINTSTATS &a, const MXMPOINTSTATS &b)
+{
+  MXMPOINTSTATS stats;
+  stats.boundsMin = XMVectorMin(a.boundsMin, b.boundsMin);
+  stats.boundsMax = XMVectorMax(a.boundsMax, b.boundsMax);
+  stats.shift = a.shift;
+  stats.sum = XMVectorAdd(a.sum, b.sum);
+  stats.sumXX = a.sumXX + b.sumXX; stats.sumXY = a.sumXY + b.sumXY; stats.sumXZ = a.sumXZ + b.sumXZ;
+  stats.sumYY = a.sumYY + b.sumYY; stats.sumYZ = a.sumYZ + b.sumYZ; stats.sumZZ = a.sumZZ + b.sumZZ;
+  stats.count = a.count + b.count;
+  return stats;
+}
+
+struct MXMPOINTSTATSMERGE
+{
+  MXMPOINTSTATS operator()(const MXMPOINTSTATS &a, const MXMPOINTSTATS &b) const { return MXMMergePointStats(a, b); }
+};
+
+// Stats of all points, computed in chunks of chunkSize points relative to the
+// first point and merged with MXMReduceTree. A chunkSize of 0 is treated as 1.
+inline MXMPOINTSTATS MXMComputePointStats(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count,
+                                          size_t chunkSize = MXM_REDUCE_CHUNK_SIZE)
+{
+  if (!count)
+    return MXMPOINTSTATS();
+
+  if (!chunkSize)
+    chunkSize = 1;
+
+  const XMVECTOR shift = pPoints[0];
+  const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+  std::vector<MXMPOINTSTATS> partials(chunkCount);
+  for (size_t c = 0; c < chunkCount; ++c) {
+    const size_t first = c * chunkSize;
+    partials[c] = MXMComputePointStatsRange(pPoints, first, count - first < chunkSize ? count - first : chunkSize, shift);
+  }
+  MXMReduceTree(&partials[0], chunkCount, MXMPOINTSTATSMERGE());
+  return partials[0];
+}
+
+inline XMVECTOR MXMPointStatsCentroid(const MXMPOINTSTATS &stats)
+{
+  if (!stats.count)
+    return XMVectorZero();
+  return XMVectorAdd(stats.shift, XMVectorScale(stats.sum, 1.0f / (float)stats.count));
+}
+
+// Population covariance of the points.
+inline MXMFLOAT3X3 MXMPointStatsCovariance(const MXMPOINTSTATS &stats)
+{
+  if (!stats.count)
+    return MXMFLOAT3X3(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+
+  const float invCount = 1.0f / (float)stats.count;
+  const float mx = stats.sum.x * invCount, my = stats.sum.y * invCount, mz = stats.sum.z * invCount;
+  const float xx = stats.sumXX * invCount - mx * mx;
+  const float xy = stats.sumXY * invCount - mx * my;
+  const float xz = stats.sumXZ * invCount - mx * mz;
+  const float yy = stats.sumYY * invCount - my * my;
+  const float yz = stats.sumYZ * invCount - my * mz;
+  const float zz = stats.sumZZ * invCount - mz * mz;
+  return MXMFLOAT3X3(xx, xy, xz,
+                     xy, yy, yz,
+                     xz, yz, zz);
+}
+
+inline void MXMComputeCovariance(_In_reads_(count) const MXMFLOAT3 *pPoints, size_t count,
+                                 XMVECTOR &centroid, MXMFLOAT3X3 &covariance)
+{
+  MXMPOINTSTATS stats = MXMComputePointStats(pPoints, count);
+  centroid = MXMPointStatsCentroid(stats);
+  covariance = MXMPointStatsCovariance(stats);
+}
+
+} //namespace DirectX
@@ -0,0 +1,279 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Batch integration of rigid bodies whose state lives in MXM arrays:
+  positions (MXMFLOAT3), orientations (MXMFLOAT4 quaternions), linear and
+  angular velocities (MXMFLOAT3), inverse masses (float) and inverse inertia
+  tensors in body space (MXMFLOAT3X3). MXMRIGIDBODIES bundles the arrays.
+
+  A step is split in two like in most solvers, so constraints can be solved
+  in between:
+
+    MXMRigidBodyIntegrateVelocities applies forces, torques and gravity and
+    writes the inverse inertia tensors in world space,
+    R * inverseInertia * transpose(R), needed by the constraint solver.
+
+    MXMRigidBodyIntegratePositions moves the bodies with their velocities,
+    integrates the quaternions (q += 0.5 * (w, 0) * q * dt), renormalizes them
+    and rebuilds the MXMFLOAT4X3 world transforms (DirectXMath row vector
+    convention, translation in the last row).
+
+  Four bodies are processed per iteration in SoA registers, gathered from and
+  scattered back to the arrays. Gyroscopic torques are not integrated.
+
+  Both functions work on ranges of bodies that only touch their own
+  elements; islands stored as contiguous ranges can be integrated from
+  different threads.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMRIGIDBODIES bodies = { &positions[0], &orientations[0], &linearVelocities[0],
+                              &angularVelocities[0], &inverseMasses[0], &inverseInertias[0],
+                              &inverseWorldInertias[0] };
+
+    MXMRigidBodyIntegrateVelocities(bodies, 0, bodyCount, &forces[0], &torques[0], gravity, 0.999f, 0.99f, dt);
+    // ... solve constraints ...
+    MXMRigidBodyIntegratePositions(bodies, 0, bodyCount, dt, &transforms[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionPolar.h"
+
+namespace DirectX
+{
+
+struct MXMRIGIDBODIES
+{
+  MXMFLOAT3 *pPositions;
+  MXMFLOAT4 *pOrientations;
+  MXMFLOAT3 *pLinearVelocities;
+  MXMFLOAT3 *pAngularVelocities;
+  const float *pInverseMasses;
+  const MXMFLOAT3X3 *pInverseInertias;         // body space
+  MXMFLOAT3X3 *pInverseWorldInertias;          // written by MXMRigidBodyIntegrateVelocities, may be NULL
+};
+
+//------------------------------------------------------------------------------
+// Gather and scatter
+
+// Returns four consecutive elements starting at i, copied into pTail with the
+// last one repeated when fewer than four are left.
+template<typename T>
+__MXM_INLINE const T *MXMRigidBodyGather(_In_ const T *pArray, size_t i, size_t n, _Out_writes_(4) T *pTail)
+{
+  if (n == 4)
+    return pArray + i;
+  for (size_t k = 0; k < 4; ++k)
+    pTail[k] = pArray[i + (k < n ? k : n - 1)];
+  return pTail;
+}
+
+// Returns the destination for four elements starting at i, pTail when fewer
+// than four are left. MXMRigidBodyScatter copies the tail back.
+template<typename T>
+__MXM_INLINE T *MXMRigidBodyTarget(_In_ T *pArray, size_t i, size_t n, _In_reads_(4) T *pTail)
+{
+  return n == 4 ? pArray + i : pTail;
+}
+
+template<typename T>
+__MXM_INLINE void MXMRigidBodyScatter(_Out_ T *pArray, size_t i, size_t n, _In_reads_(4) const T *pTail)
+{
+  if (n == 4)
+    return;
+  for (size_t k = 0; k < n; ++k)
+    pArray[i + k] = pTail[k];
+}
+
+// Loads four quaternions into SoA lanes.
+__MXM_INLINE void MXMLoadQuaternionSoA(_In_reads_(4) const MXMFLOAT4 *pSource, XMVECTOR &qx, XMVECTOR &qy, XMVECTOR &qz, XMVECTOR &qw)
+{
+  XMMATRIX q(XMLoadFloat4(&pSource[0]), XMLoadFloat4(&pSource[1]), XMLoadFloat4(&pSource[2]), XMLoadFloat4(&pSource[3]));
+  q = XMMatrixTranspose(q);
+  qx = q.r[0];
+  qy = q.r[1];
+  qz = q.r[2];
+  qw = q.r[3];
+}
+
+__MXM_INLINE void XM_CALLCONV MXMStoreQuaternionSoA(_Out_writes_(4) MXMFLOAT4 *pDestination, FXMVECTOR qx, FXMVECTOR qy, FXMVECTOR qz, GXMVECTOR qw)
+{
+  XMMATRIX q(qx, qy, qz, qw);
+  q = XMMatrixTranspose(q);
+  XMStoreFloat4(&pDestination[0], q.r[0]);
+  XMStoreFloat4(&pDestination[1], q.r[1]);
+  XMStoreFloat4(&pDestination[2], q.r[2]);
+  XMStoreFloat4(&pDestination[3], q.r[3]);
+}
+
+//------------------------------------------------------------------------------
+// Integration
+
+// Inverse inertia in world space of four bodies, transpose(M) * inverseInertia * M
+// with the row vector rotation matrices M.
+inline void MXMRigidBodyWorldInertiaSoA(const MXMFLOAT3X3SOA &rotations, const MXMFLOAT3X3SOA &inverseInertias, MXMFLOAT3X3SOA &world)
+{
+  XMVECTOR t[3][3];
+  for (int k = 0; k < 3; ++k) {
+    for (int j = 0; j < 3; ++j) {
+      t[k][j] = XMVectorMultiplyAdd(inverseInertias.m[k][0], rotations.m[0][j],
+                XMVectorMultiplyAdd(inverseInertias.m[k][1], rotations.m[1][j],
+                XMVectorMultiply(inverseInertias.m[k][2], rotations.m[2][j])));
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      world.m[i][j] = XMVectorMultiplyAdd(rotations.m[0][i], t[0][j],
+                      XMVectorMultiplyAdd(rotations.m[1][i], t[1][j],
+                      XMVectorMultiply(rotations.m[2][i], t[2][j])));
+    }
+  }
+}
+
+// velocity = (velocity + (force * inverseMass + gravity) * dt) * linearDamping,
+// angularVelocity = (angularVelocity + inverseWorldInertia * torque * dt) * angularDamping
+// for the bodies [first, first + count). pTorques may be NULL.
+inline void XM_CALLCONV MXMRigidBodyIntegrateVelocities(const MXMRIGIDBODIES &bodies, size_t first, size_t count,
+                                                        _In_ const MXMFLOAT3 *pForces, _In_opt_ const MXMFLOAT3 *pTorques,
+                                                        FXMVECTOR gravity, float linearDamping, float angularDamping, float dt)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  const XMVECTOR linear = XMVectorReplicate(linearDamping);
+  const XMVECTOR angular = XMVectorReplicate(angularDamping);
+  const XMVECTOR gx = XMVectorSplatX(gravity);
+  const XMVECTOR gy = XMVectorSplatY(gravity);
+  const XMVECTOR gz = XMVectorSplatZ(gravity);
+
+  for (size_t i = first; i < first + count; i += 4) {
+    const size_t n = first + count - i < 4 ? first + count - i : 4;
+    MXMFLOAT3 forceTail[4], torqueTail[4], linearTail[4], angularTail[4];
+    MXMFLOAT4 orientationTail[4];
+    MXMFLOAT3X3 inertiaTail[4], worldTail[4];
+    float massTail[4];
+
+    // linear velocities
+    XMVECTOR fx, fy, fz, vx, vy, vz;
+    MXMLoadFloat3SoA(MXMRigidBodyGather(pForces, i, n, forceTail), fx, fy, fz);
+    MXMLoadFloat3SoA(MXMRigidBodyGather(bodies.pLinearVelocities, i, n, linearTail), vx, vy, vz);
+    const XMVECTOR inverseMass = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(MXMRigidBodyGather(bodies.pInverseMasses, i, n, massTail)));
+    vx = XMVectorMultiply(XMVectorMultiplyAdd(XMVectorMultiplyAdd(fx, inverseMass, gx), step, vx), linear);
+    vy = XMVectorMultiply(XMVectorMultiplyAdd(XMVectorMultiplyAdd(fy, inverseMass, gy), step, vy), linear);
+    vz = XMVectorMultiply(XMVectorMultiplyAdd(XMVectorMultiplyAdd(fz, inverseMass, gz), step, vz), linear);
+    MXMStoreFloat3SoA(MXMRigidBodyTarget(bodies.pLinearVelocities, i, n, linearTail), vx, vy, vz);
+    MXMRigidBodyScatter(bodies.pLinearVelocities, i, n, linearTail);
+
+    if (!pTorques && !bodies.pInverseWorldInertias) {
+      for (size_t k = 0; k < n; ++k)
+        bodies.pAngularVelocities[i + k] = XMVectorScale(bodies.pAngularVelocities[i + k], angularDamping);
+      continue;
+    }
+
+    // world inertia from the current orientation
+    XMVECTOR qx, qy, qz, qw;
+    MXMLoadQuaternionSoA(MXMRigidBodyGather(bodies.pOrientations, i, n, orientationTail), qx, qy, qz, qw);
+    MXMFLOAT3X3SOA rotations, inertia, world;
+    MXMQuaternionToMatrixSoA(qx, qy, qz, qw, rotations);
+    MXMLoadFloat3x3SoA(MXMRigidBodyGather(bodies.pInverseInertias, i, n, inertiaTail), inertia);
+    MXMRigidBodyWorldInertiaSoA(rotations, inertia, world);
+    if (bodies.pInverseWorldInertias) {
+      MXMStoreFloat3x3SoA(MXMRigidBodyTarget(bodies.pInverseWorldInertias, i, n, worldTail), world);
+      MXMRigidBodyScatter(bodies.pInverseWorldInertias, i, n, worldTail);
+    }
+
+    XMVECTOR wx, wy, wz;
+    MXMLoadFloat3SoA(MXMRigidBodyGather(bodies.pAngularVelocities, i, n, angularTail), wx, wy, wz);
+    if (pTorques) {
+      XMVECTOR tx, ty, tz;
+      MXMLoadFloat3SoA(MXMRigidBodyGather(pTorques, i, n, torqueTail), tx, ty, tz);
+      tx = XMVectorMultiply(tx, step);
+      ty = XMVectorMultiply(ty, step);
+      tz = XMVectorMultiply(tz, step);
+      wx = XMVectorMultiplyAdd(world.m[0][0], tx, XMVectorMultiplyAdd(world.m[0][1], ty, XMVectorMultiplyAdd(world.m[0][2], tz, wx)));
+      wy = XMVectorMultiplyAdd(world.m[1][0], tx, XMVectorMultiplyAdd(world.m[1][1], ty, XMVectorMultiplyAdd(world.m[1][2], tz, wy)));
+      wz = XMVectorMultiplyAdd(world.m[2][0], tx, XMVectorMultiplyAdd(world.m[2][1], ty, XMVectorMultiplyAdd(world.m[2][2], tz, wz)));
+    }
+    MXMStoreFloat3SoA(MXMRigidBodyTarget(bodies.pAngularVelocities, i, n, angularTail),
+                      XMVectorMultiply(wx, angular), XMVectorMultiply(wy, angular), XMVectorMultiply(wz, angular));
+    MXMRigidBodyScatter(bodies.pAngularVelocities, i, n, angularTail);
+  }
+}
+
+// position += velocity * dt, orientation = normalize(orientation + 0.5 * (angularVelocity, 0) * orientation * dt)
+// for the bodies [first, first + count). pTransforms may be NULL.
+inline void MXMRigidBodyIntegratePositions(const MXMRIGIDBODIES &bodies, size_t first, size_t count, float dt,
+                                           _Out_opt_ MXMFLOAT4X3 *pTransforms)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  const XMVECTOR halfStep = XMVectorReplicate(0.5f * dt);
+
+  for (size_t i = first; i < first + count; i += 4) {
+    const size_t n = first + count - i < 4 ? first + count - i : 4;
+    MXMFLOAT3 positionTail[4], linearTail[4], angularTail[4];
+    MXMFLOAT4 orientationTail[4];
+
+    XMVECTOR px, py, pz, vx, vy, vz;
+    MXMLoadFloat3SoA(MXMRigidBodyGather(bodies.pPositions, i, n, positionTail), px, py, pz);
+    MXMLoadFloat3SoA(MXMRigidBodyGather(bodies.pLinearVelocities, i, n, linearTail), vx, vy, vz);
+    px = XMVectorMultiplyAdd(vx, step, px);
+    py = XMVectorMultiplyAdd(vy, step, py);
+    pz = XMVectorMultiplyAdd(vz, step, pz);
+    MXMStoreFloat3SoA(MXMRigidBodyTarget(bodies.pPositions, i, n, positionTail), px, py, pz);
+    MXMRigidBodyScatter(bodies.pPositions, i, n, positionTail);
+
+    XMVECTOR wx, wy, wz, qx, qy, qz, qw;
+    MXMLoadFloat3SoA(MXMRigidBodyGather(bodies.pAngularVelocities, i, n, angularTail), wx, wy, wz);
+    MXMLoadQuaternionSoA(MXMRigidBodyGather(bodies.pOrientations, i, n, orientationTail), qx, qy, qz, qw);
+    wx = XMVectorMultiply(wx, halfStep);
+    wy = XMVectorMultiply(wy, halfStep);
+    wz = XMVectorMultiply(wz, halfStep);
+
+    // q += (w, 0) * q * dt / 2
+    XMVECTOR nx = XMVectorAdd(qx, XMVectorAdd(XMVectorMultiply(qw, wx), XMVectorSubtract(XMVectorMultiply(wy, qz), XMVectorMultiply(wz, qy))));
+    XMVECTOR ny = XMVectorAdd(qy, XMVectorAdd(XMVectorMultiply(qw, wy), XMVectorSubtract(XMVectorMultiply(wz, qx), XMVectorMultiply(wx, qz))));
+    XMVECTOR nz = XMVectorAdd(qz, XMVectorAdd(XMVectorMultiply(qw, wz), XMVectorSubtract(XMVectorMultiply(wx, qy), XMVectorMultiply(wy, qx))));
+    XMVECTOR nw = XMVectorSubtract(qw, XMVectorAdd(XMVectorMultiply(wx, qx), XMVectorAdd(XMVectorMultiply(wy, qy), XMVectorMultiply(wz, qz))));
+    const XMVECTOR length = XMVectorReciprocalSqrt(XMVectorAdd(XMVectorAdd(XMVectorMultiply(nx, nx), XMVectorMultiply(ny, ny)),
+                                                               XMVectorAdd(XMVectorMultiply(nz, nz), XMVectorMultiply(nw, nw))));
+    qx = XMVectorMultiply(nx, length);
+    qy = XMVectorMultiply(ny, length);
+    qz = XMVectorMultiply(nz, length);
+    qw = XMVectorMultiply(nw, length);
+    MXMStoreQuaternionSoA(MXMRigidBodyTarget(bodies.pOrientations, i, n, orientationTail), qx, qy, qz, qw);
+    MXMRigidBodyScatter(bodies.pOrientations, i, n, orientationTail);
+
+    if (!pTransforms)
+      continue;
+    MXMFLOAT3X3SOA rotations;
+    MXMQuaternionToMatrixSoA(qx, qy, qz, qw, rotations);
+    MXMFLOAT3X3 rotationTail[4];
+    MXMFLOAT3 translationTail[4];
+    MXMStoreFloat3x3SoA(rotationTail, rotations);
+    MXMStoreFloat3SoA(translationTail, px, py, pz);
+    for (size_t k = 0; k < n; ++k) {
+      MXMFLOAT4X3 &transform = pTransforms[i + k];
+      for (int r = 0; r < 3; ++r) {
+        transform.m[r][0] = rotationTail[k].m[r][0];
+        transform.m[r][1] = rotationTail[k].m[r][1];
+        transform.m[r][2] = rotationTail[k].m[r][2];
+      }
+      transform.m[3][0] = translationTail[k].x;
+      transform.m[3][1] = translationTail[k].y;
+      transform.m[3][2] = translationTail[k].z;
+    }
+  }
+}
+
+// Both halves of a step without constraints in between.
+inline void XM_CALLCONV MXMRigidBodyIntegrate(const MXMRIGIDBODIES &bodies, size_t first, size_t count,
+                                              _In_ const MXMFLOAT3 *pForces, _In_opt_ const MXMFLOAT3 *pTorques,
+                                              FXMVECTOR gravity, float linearDamping, float angularDamping, float dt,
+                                              _Out_opt_ MXMFLOAT4X3 *pTransforms)
+{
+  MXMRigidBodyIntegrateVelocities(bodies, first, count, pForces, pTorques, gravity, linearDamping, angularDamping, dt);
+  MXMRigidBodyIntegratePositions(bodies, first, count, dt, pTransforms);
+}
+
+} //namespace DirectX
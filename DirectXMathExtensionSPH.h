@@ -0,0 +1,314 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Smoothed particle hydrodynamics (Mueller et al., "Particle-Based Fluid
+  Simulation for Interactive Applications") over MXMFLOAT3 positions and
+  velocities.
+
+  Every step builds an MXMHASHGRID with the smoothing length as cell size,
+  which sorts the positions cell by cell into SoA arrays. The velocities are
+  gathered into the same sorted layout, so all particles of a neighbor cell
+  are one contiguous range and the kernels evaluate four neighbors per
+  XMVECTOR:
+
+    density    poly6 kernel           rho_i = m * sum W(r_ij)
+    pressure   spiky kernel gradient  p_i = max(0, k * (rho_i - rho_0))
+    viscosity  viscosity laplacian
+
+  Densities and accelerations are computed over ranges of sorted particles
+  which only read shared data, so ranges can run concurrently. All densities
+  have to be computed before the first accelerations.
+
+  The grid is bucket sorted, so neighbor cells lie scattered in memory while
+  the particles inside a bucket keep their input order. Reordering the input
+  arrays along a Morton curve every few steps keeps spatially close particles
+  close in memory, which speeds up the gathers and the scattered writes of
+  the accelerations.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMSPH sph;
+    sph.smoothingLength = 0.1f;
+    sph.particleMass = 0.02f;
+    sph.restDensity = 1000.0f;
+    sph.stiffness = 3.0f;
+    sph.viscosity = 3.5f;
+
+    // every frame
+    if (frame % 32 == 0)
+      MXMSPHReorder(&positions[0], &velocities[0], count, &order[0]);
+    MXMSPHStep(sph, &positions[0], &velocities[0], count, gravity, dt);
+
+    // or with ranges run concurrently
+    MXMSPHBuild(sph, &positions[0], &velocities[0], count);
+    MXMSPHComputeDensities(sph, first, rangeCount);
+    // wait for all ranges
+    MXMSPHComputeAccelerations(sph, first, rangeCount, &accelerations[0]);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionHashGrid.h"
+#include "DirectXMathExtensionMorton.h"
+#include "DirectXMathExtensionReduce.h"
+
+#include <vector>
+#include <math.h>
+
+namespace DirectX
+{
+
+struct MXMSPH
+{
+  float smoothingLength;             // kernel radius h, also the grid cell size
+  float particleMass;
+  float restDensity;
+  float stiffness;                   // gas constant k of the pressure
+  float viscosity;
+
+  MXMHASHGRID grid;                  // sorted positions of the current step
+  std::vector<float> vx, vy, vz;     // sorted velocities, padded by three entries for 4-wide loads
+  std::vector<float> density;        // sorted densities, padded
+  std::vector<float> pressure;       // sorted pressures, padded
+  std::vector<MXMFLOAT3> accelerations; // accelerations in input order, written by MXMSPHStep
+
+  MXMSPH() : smoothingLength(1.0f), particleMass(1.0f), restDensity(1.0f), stiffness(1.0f), viscosity(0.0f) {}
+
+  size_t Size() const { return grid.Size(); }
+};
+
+//------------------------------------------------------------------------------
+// Build
+
+// Builds the cell sorted layout of the current positions and velocities.
+inline void MXMSPHBuild(MXMSPH &sph, _In_reads_(count) const MXMFLOAT3 *pPositions,
+                        _In_reads_(count) const MXMFLOAT3 *pVelocities, size_t count)
+{
+  MXMHashGridBuild(sph.grid, pPositions, count, sph.smoothingLength);
+
+  sph.vx.resize(count + 3);
+  sph.vy.resize(count + 3);
+  sph.vz.resize(count + 3);
+  for (size_t i = 0; i < count; ++i) {
+    const MXMFLOAT3 &v = pVelocities[sph.grid.indices[i]];
+    sph.vx[i] = v.x;
+    sph.vy[i] = v.y;
+    sph.vz[i] = v.z;
+  }
+  for (size_t i = count; i < count + 3; ++i)
+    sph.vx[i] = sph.vy[i] = sph.vz[i] = 0.0f;
+
+  // padding densities are one so masked lanes never divide by zero
+  sph.density.assign(count + 3, 1.0f);
+  sph.pressure.assign(count + 3, 0.0f);
+}
+
+// Writes the distinct non-empty buckets of the 27 cells around cell and
+// returns their count.
+inline uint32_t MXMSPHNeighborBuckets(const MXMHASHGRID &grid, const MXMINT3 &cell, _Out_writes_(27) uint32_t *pBuckets)
+{
+  uint32_t bucketCount = 0;
+  for (int32_t cz = cell.z - 1; cz <= cell.z + 1; ++cz) {
+    for (int32_t cy = cell.y - 1; cy <= cell.y + 1; ++cy) {
+      for (int32_t cx = cell.x - 1; cx <= cell.x + 1; ++cx) {
+        const uint32_t bucket = MXMHashGridHash(cx, cy, cz) & grid.bucketMask;
+        if (grid.bucketStart[bucket] == grid.bucketStart[bucket + 1])
+          continue;
+        bool seen = false;
+        for (uint32_t b = 0; b < bucketCount && !seen; ++b)
+          seen = pBuckets[b] == bucket;
+        if (!seen)
+          pBuckets[bucketCount++] = bucket;
+      }
+    }
+  }
+  return bucketCount;
+}
+
+__MXM_INLINE XMVECTOR XM_CALLCONV MXMSPHLoad4(_In_reads_(4) const float *pSource)
+{
+  return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pSource));
+}
+
+//------------------------------------------------------------------------------
+// Kernels
+
+// Computes densities and pressures of the sorted particles [first, first + count).
+inline void MXMSPHComputeDensities(MXMSPH &sph, size_t first, size_t count)
+{
+  const MXMHASHGRID &grid = sph.grid;
+  const float h = sph.smoothingLength;
+  const XMVECTOR lanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+  const float poly6 = 315.0f / (64.0f * XM_PI * powf(h, 9.0f));
+  const XMVECTOR hSq = XMVectorReplicate(h * h);
+
+  uint32_t buckets[27];
+  uint32_t bucketCount = 0;
+  MXMINT3 lastCell(0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF);
+
+  for (size_t i = first; i < first + count; ++i) {
+    // consecutive particles mostly share their cell and with it the neighbor buckets
+    const MXMINT3 &cell = grid.cells[grid.indices[i]];
+    if (cell.x != lastCell.x || cell.y != lastCell.y || cell.z != lastCell.z) {
+      bucketCount = MXMSPHNeighborBuckets(grid, cell, buckets);
+      lastCell = cell;
+    }
+
+    const XMVECTOR px = XMVectorReplicate(grid.x[i]);
+    const XMVECTOR py = XMVectorReplicate(grid.y[i]);
+    const XMVECTOR pz = XMVectorReplicate(grid.z[i]);
+    XMVECTOR sum = XMVectorZero();
+
+    for (uint32_t b = 0; b < bucketCount; ++b) {
+      const uint32_t end = grid.bucketStart[buckets[b] + 1];
+      for (uint32_t j = grid.bucketStart[buckets[b]]; j < end; j += 4) {
+        XMVECTOR dx = XMVectorSubtract(MXMSPHLoad4(&grid.x[j]), px);
+        XMVECTOR dy = XMVectorSubtract(MXMSPHLoad4(&grid.y[j]), py);
+        XMVECTOR dz = XMVectorSubtract(MXMSPHLoad4(&grid.z[j]), pz);
+        XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+        // lanes past the bucket and outside the kernel radius contribute zero
+        const XMVECTOR valid = XMVectorAndInt(XMVectorLess(distSq, hSq),
+                                              XMVectorLess(lanes, XMVectorReplicate((float)(end - j))));
+        if (!MXMVectorMoveMask(valid))
+          continue;
+
+        XMVECTOR w = XMVectorSubtract(hSq, distSq);
+        w = XMVectorMultiply(XMVectorMultiply(w, w), w);
+        sum = XMVectorAdd(sum, XMVectorAndInt(w, valid));
+      }
+    }
+
+    const float density = sph.particleMass * poly6 * XMVectorGetX(MXMVectorHorizontalSum(sum));
+    const float pressure = sph.stiffness * (density - sph.restDensity);
+    sph.density[i] = density;
+    sph.pressure[i] = pressure > 0.0f ? pressure : 0.0f;
+  }
+}
+
+// Computes the pressure and viscosity accelerations of the sorted particles
+// [first, first + count) and writes them to pAccelerations in input order.
+inline void MXMSPHComputeAccelerations(const MXMSPH &sph, size_t first, size_t count,
+                                       _Out_writes_(_Inexpressible_(sph.Size())) MXMFLOAT3 *pAccelerations)
+{
+  const MXMHASHGRID &grid = sph.grid;
+  const float h = sph.smoothingLength;
+  const XMVECTOR lanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+  const float gradient = 45.0f / (XM_PI * powf(h, 6.0f));
+  const XMVECTOR hSplat = XMVectorReplicate(h);
+  const XMVECTOR hSq = XMVectorReplicate(h * h);
+  const XMVECTOR half = XMVectorReplicate(0.5f);
+  const XMVECTOR viscosity = XMVectorReplicate(sph.viscosity);
+  const XMVECTOR minDistSq = XMVectorReplicate(1.0e-12f);
+
+  uint32_t buckets[27];
+  uint32_t bucketCount = 0;
+  MXMINT3 lastCell(0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF);
+
+  for (size_t i = first; i < first + count; ++i) {
+    const MXMINT3 &cell = grid.cells[grid.indices[i]];
+    if (cell.x != lastCell.x || cell.y != lastCell.y || cell.z != lastCell.z) {
+      bucketCount = MXMSPHNeighborBuckets(grid, cell, buckets);
+      lastCell = cell;
+    }
+
+    const XMVECTOR px = XMVectorReplicate(grid.x[i]);
+    const XMVECTOR py = XMVectorReplicate(grid.y[i]);
+    const XMVECTOR pz = XMVectorReplicate(grid.z[i]);
+    const XMVECTOR vx = XMVectorReplicate(sph.vx[i]);
+    const XMVECTOR vy = XMVectorReplicate(sph.vy[i]);
+    const XMVECTOR vz = XMVectorReplicate(sph.vz[i]);
+    const XMVECTOR pi = XMVectorReplicate(sph.pressure[i]);
+    XMVECTOR ax = XMVectorZero(), ay = XMVectorZero(), az = XMVectorZero();
+
+    for (uint32_t b = 0; b < bucketCount; ++b) {
+      const uint32_t end = grid.bucketStart[buckets[b] + 1];
+      for (uint32_t j = grid.bucketStart[buckets[b]]; j < end; j += 4) {
+        // positions relative to the neighbors, x_i - x_j
+        XMVECTOR dx = XMVectorSubtract(px, MXMSPHLoad4(&grid.x[j]));
+        XMVECTOR dy = XMVectorSubtract(py, MXMSPHLoad4(&grid.y[j]));
+        XMVECTOR dz = XMVectorSubtract(pz, MXMSPHLoad4(&grid.z[j]));
+        XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+        // the particle itself is excluded by the lower bound of the distance
+        const XMVECTOR valid = XMVectorAndInt(XMVectorAndInt(XMVectorLess(distSq, hSq), XMVectorGreater(distSq, minDistSq)),
+                                              XMVectorLess(lanes, XMVectorReplicate((float)(end - j))));
+        if (!MXMVectorMoveMask(valid))
+          continue;
+
+        const XMVECTOR invDist = XMVectorReciprocalSqrt(XMVectorMax(distSq, minDistSq));
+        const XMVECTOR hMinusDist = XMVectorMax(XMVectorSubtract(hSplat, XMVectorMultiply(distSq, invDist)), XMVectorZero());
+        const XMVECTOR invDensity = XMVectorReciprocal(MXMSPHLoad4(&sph.density[j]));
+
+        // pressure: (p_i + p_j) / (2 rho_j) (h - r)^2 (x_i - x_j) / r
+        XMVECTOR pressure = XMVectorMultiply(XMVectorMultiply(XMVectorAdd(pi, MXMSPHLoad4(&sph.pressure[j])), half), invDensity);
+        pressure = XMVectorMultiply(XMVectorMultiply(pressure, XMVectorMultiply(hMinusDist, hMinusDist)), invDist);
+
+        // viscosity: mu (v_j - v_i) / rho_j (h - r)
+        const XMVECTOR visc = XMVectorMultiply(XMVectorMultiply(viscosity, hMinusDist), invDensity);
+
+        const XMVECTOR fx = XMVectorMultiplyAdd(pressure, dx, XMVectorMultiply(visc, XMVectorSubtract(MXMSPHLoad4(&sph.vx[j]), vx)));
+        const XMVECTOR fy = XMVectorMultiplyAdd(pressure, dy, XMVectorMultiply(visc, XMVectorSubtract(MXMSPHLoad4(&sph.vy[j]), vy)));
+        const XMVECTOR fz = XMVectorMultiplyAdd(pressure, dz, XMVectorMultiply(visc, XMVectorSubtract(MXMSPHLoad4(&sph.vz[j]), vz)));
+        ax = XMVectorAdd(ax, XMVectorAndInt(fx, valid));
+        ay = XMVectorAdd(ay, XMVectorAndInt(fy, valid));
+        az = XMVectorAdd(az, XMVectorAndInt(fz, valid));
+      }
+    }
+
+    // forces are divided by the density of the particle itself
+    const XMVECTOR scale = XMVectorReplicate(sph.particleMass * gradient / sph.density[i]);
+    pAccelerations[grid.indices[i]] = XMVectorMultiply(MXMVectorHorizontalSum3(ax, ay, az), scale);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Integration
+
+// Semi-implicit Euler integration of the particles [first, first + count) in
+// input order.
+inline void XM_CALLCONV MXMSPHIntegrate(_Inout_updates_(_Inexpressible_(first + count)) MXMFLOAT3 *pPositions,
+                                        _Inout_updates_(_Inexpressible_(first + count)) MXMFLOAT3 *pVelocities,
+                                        _In_reads_(_Inexpressible_(first + count)) const MXMFLOAT3 *pAccelerations,
+                                        size_t first, size_t count, FXMVECTOR gravity, float dt)
+{
+  const XMVECTOR step = XMVectorReplicate(dt);
+  for (size_t i = first; i < first + count; ++i) {
+    const XMVECTOR v = XMVectorMultiplyAdd(XMVectorAdd(pAccelerations[i], gravity), step, pVelocities[i]);
+    pVelocities[i] = v;
+    pPositions[i] = XMVectorMultiplyAdd(v, step, pPositions[i]);
+  }
+}
+
+// Runs a complete step on the calling thread: build, densities, accelerations
+// and integration.
+inline void XM_CALLCONV MXMSPHStep(MXMSPH &sph, _Inout_updates_(count) MXMFLOAT3 *pPositions,
+                                   _Inout_updates_(count) MXMFLOAT3 *pVelocities, size_t count,
+                                   FXMVECTOR gravity, float dt)
+{
+  MXMSPHBuild(sph, pPositions, pVelocities, count);
+  if (!count)
+    return;
+  sph.accelerations.resize(count);
+  MXMSPHComputeDensities(sph, 0, count);
+  MXMSPHComputeAccelerations(sph, 0, count, &sph.accelerations[0]);
+  MXMSPHIntegrate(pPositions, pVelocities, &sph.accelerations[0], 0, count, gravity, dt);
+}
+
+//------------------------------------------------------------------------------
+// Locality
+
+// Sorts the positions and velocities along a Morton curve. pOrder receives
+// the applied order so further per particle arrays can follow with
+// MXMApplyOrder.
+inline void MXMSPHReorder(_Inout_updates_(count) MXMFLOAT3 *pPositions, _Inout_updates_(count) MXMFLOAT3 *pVelocities,
+                          size_t count, _Out_writes_(count) uint32_t *pOrder)
+{
+  MXMMortonOrder(pPositions, count, pOrder);
+  MXMApplyOrder(pPositions, pOrder, count);
+  MXMApplyOrder(pVelocities, pOrder, count);
+}
+
+} //namespace DirectX
@@ -0,0 +1,216 @@
+#pragma once
+
+/*------------------------------------------------------------------------------
+// INFO
+
+  Sort and sweep broadphase over axis aligned boxes stored in MXMFLOAT3 min
+  and max arrays.
+
+  The boxes are kept sorted by their minimum on one sweep axis, chosen as the
+  axis with the largest spread of box centers when the body count changes.
+  Between frames the order is reused and repaired with an insertion sort,
+  which is close to linear while bodies move coherently.
+
+  For every box the sweep walks the following boxes until their minimum
+  passes its maximum and tests four of them at a time on the two secondary
+  axes, which are stored in SoA layout in sorted order.
+
+  Pair generation works on ranges of the sorted boxes. Ranges are
+  independent, so they can be processed concurrently into separate pair
+  buffers which are concatenated afterwards with MXMSweepAndPruneMergePairs.
+
+//------------------------------------------------------------------------------
+// Example
+
+    MXMSWEEPANDPRUNE sap;
+
+    // every frame
+    std::vector<MXMSAPPAIR> pairs;
+    MXMSweepAndPrune(sap, &boxMin[0], &boxMax[0], bodyCount, pairs);
+
+    // or by ranges, e.g. one per worker
+    MXMSweepAndPruneUpdate(sap, &boxMin[0], &boxMax[0], bodyCount);
+    MXMSweepAndPruneFindPairs(sap, first, count, pairsOfWorker[w]);
+    MXMSweepAndPruneMergePairs(pairsOfWorker, pairs);
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtension.h"
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+
+namespace DirectX
+{
+
+struct MXMSAPPAIR
+{
+  uint32_t a, b;                     // body indices, a < b
+};
+
+struct MXMSWEEPANDPRUNE
+{
+  uint32_t axis;                     // sweep axis, 0 = x, 1 = y, 2 = z
+  std::vector<uint32_t> order;       // body indices sorted by their minimum on the sweep axis
+
+  // bounds in sorted order, padded by three entries for 4-wide loads
+  std::vector<float> sweepMin, sweepMax;
+  std::vector<float> minA, maxA, minB, maxB;
+
+  MXMSWEEPANDPRUNE() : axis(0) {}
+
+  size_t Size() const { return order.size(); }
+};
+
+//------------------------------------------------------------------------------
+// Sorting
+
+struct MXMSAPSWEEPLESS
+{
+  const MXMFLOAT3 *pMin;
+  uint32_t axis;
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    return (&pMin[a].x)[axis] < (&pMin[b].x)[axis];
+  }
+};
+
+// Picks the axis along which the box centers spread the most.
+inline uint32_t MXMSweepAndPruneChooseAxis(_In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                                           size_t count)
+{
+  XMVECTOR sum = XMVectorZero();
+  XMVECTOR sumSq = XMVectorZero();
+  for (size_t i = 0; i < count; ++i) {
+    XMVECTOR center = XMVectorAdd(pMin[i], pMax[i]);
+    sum = XMVectorAdd(sum, center);
+    sumSq = XMVectorMultiplyAdd(center, center, sumSq);
+  }
+
+  // count * variance, up to a constant factor
+  XMFLOAT3 spread;
+  XMStoreFloat3(&spread, XMVectorSubtract(XMVectorScale(sumSq, (float)count), XMVectorMultiply(sum, sum)));
+  return spread.x >= spread.y ? (spread.x >= spread.z ? 0 : 2) : (spread.y >= spread.z ? 1 : 2);
+}
+
+// Sorts the boxes along the sweep axis and gathers their bounds in sorted
+// order. The order of the previous update is reused as long as the body count
+// does not change.
+inline void MXMSweepAndPruneUpdate(MXMSWEEPANDPRUNE &sap, _In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                                   size_t count)
+{
+  if (sap.order.size() != count) {
+    sap.axis = MXMSweepAndPruneChooseAxis(pMin, pMax, count);
+    sap.order.resize(count);
+    for (size_t i = 0; i < count; ++i)
+      sap.order[i] = (uint32_t)i;
+
+    MXMSAPSWEEPLESS less = { pMin, sap.axis };
+    std::sort(sap.order.begin(), sap.order.end(), less);
+  }
+
+  sap.sweepMin.resize(count + 3);
+  sap.sweepMax.resize(count + 3);
+  sap.minA.resize(count + 3);
+  sap.maxA.resize(count + 3);
+  sap.minB.resize(count + 3);
+  sap.maxB.resize(count + 3);
+
+  // insertion sort of the previous order, the keys are sorted alongside
+  const uint32_t axis = sap.axis;
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t body = sap.order[i];
+    const float key = (&pMin[body].x)[axis];
+    size_t j = i;
+    for (; j > 0 && sap.sweepMin[j - 1] > key; --j) {
+      sap.sweepMin[j] = sap.sweepMin[j - 1];
+      sap.order[j] = sap.order[j - 1];
+    }
+    sap.sweepMin[j] = key;
+    sap.order[j] = body;
+  }
+
+  const uint32_t axisA = (axis + 1) % 3;
+  const uint32_t axisB = (axis + 2) % 3;
+  for (size_t i = 0; i < count; ++i) {
+    const float *boxMin = &pMin[sap.order[i]].x;
+    const float *boxMax = &pMax[sap.order[i]].x;
+    sap.sweepMax[i] = boxMax[axis];
+    sap.minA[i] = boxMin[axisA];
+    sap.maxA[i] = boxMax[axisA];
+    sap.minB[i] = boxMin[axisB];
+    sap.maxB[i] = boxMax[axisB];
+  }
+
+  // padding only fails the sweep test, lanes past the end are masked off
+  // when pairs are generated, e.g. for boxes spanning -FLT_MAX..FLT_MAX
+  for (size_t i = count; i < count + 3; ++i) {
+    sap.sweepMin[i] = sap.minA[i] = sap.minB[i] = FLT_MAX;
+    sap.sweepMax[i] = sap.maxA[i] = sap.maxB[i] = -FLT_MAX;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Pair generation
+
+// Appends the overlapping pairs of the sorted boxes [first, first + count)
+// with all boxes following them in sweep order. Covering all boxes with
+// disjoint ranges finds every pair exactly once.
+inline void MXMSweepAndPruneFindPairs(const MXMSWEEPANDPRUNE &sap, size_t first, size_t count, std::vector<MXMSAPPAIR> &pairs)
+{
+  static const uint32_t laneMasks[5] = { 0x0, 0x1, 0x3, 0x7, 0xF };
+  const size_t size = sap.order.size();
+  for (size_t i = first; i < first + count && i < size; ++i) {
+    const float sweepMax = sap.sweepMax[i];
+    const XMVECTOR sweepMaxV = XMVectorReplicate(sweepMax);
+    const XMVECTOR minA = XMVectorReplicate(sap.minA[i]);
+    const XMVECTOR maxA = XMVectorReplicate(sap.maxA[i]);
+    const XMVECTOR minB = XMVectorReplicate(sap.minB[i]);
+    const XMVECTOR maxB = XMVectorReplicate(sap.maxB[i]);
+    const uint32_t body = sap.order[i];
+
+    for (size_t j = i + 1; j < size && sap.sweepMin[j] <= sweepMax; j += 4) {
+      XMVECTOR overlap = XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&sap.sweepMin[j])), sweepMaxV);
+      overlap = XMVectorAndInt(overlap, XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&sap.minA[j])), maxA));
+      overlap = XMVectorAndInt(overlap, XMVectorGreaterOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&sap.maxA[j])), minA));
+      overlap = XMVectorAndInt(overlap, XMVectorLessOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&sap.minB[j])), maxB));
+      overlap = XMVectorAndInt(overlap, XMVectorGreaterOrEqual(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&sap.maxB[j])), minB));
+
+      const size_t remaining = size - j;
+      uint32_t mask = MXMVectorMoveMask(overlap) & laneMasks[remaining < 4 ? remaining : 4];
+      for (; mask; mask &= mask - 1) {
+        uint32_t lane = 0;
+        while (!(mask & (1u << lane)))
+          ++lane;
+        const uint32_t other = sap.order[j + lane];
+        MXMSAPPAIR pair;
+        pair.a = body < other ? body : other;
+        pair.b = body < other ? other : body;
+        pairs.push_back(pair);
+      }
+    }
+  }
+}
+
+// Concatenates the pair buffers of several ranges.
+inline void MXMSweepAndPruneMergePairs(const std::vector<std::vector<MXMSAPPAIR> > &buffers, std::vector<MXMSAPPAIR> &pairs)
+{
+  size_t total = pairs.size();
+  for (size_t b = 0; b < buffers.size(); ++b)
+    total += buffers[b].size();
+  pairs.reserve(total);
+  for (size_t b = 0; b < buffers.size(); ++b)
+    pairs.insert(pairs.end(), buffers[b].begin(), buffers[b].end());
+}
+
+// Updates the sort and replaces pairs with all overlapping pairs.
+inline void MXMSweepAndPrune(MXMSWEEPANDPRUNE &sap, _In_reads_(count) const MXMFLOAT3 *pMin, _In_reads_(count) const MXMFLOAT3 *pMax,
+                             size_t count, std::vector<MXMSAPPAIR> &pairs)
+{
+  MXMSweepAndPruneUpdate(sap, pMin, pMax, count);
+  pairs.clear();
+  MXMSweepAndPruneFindPairs(sap, 0, count, pairs);
+}
+
+} //namespace DirectX
@@ -0,0 +1,128 @@
+/*------------------------------------------------------------------------------
+// INFO
+
+  Self-contained check of DirectXMathExtensionSweepAndPrune.h.
+
+  Random boxes together with unbounded ones (a world box spanning
+  -FLT_MAX..FLT_MAX and a ground box unbounded on two axes) are swept for
+  body counts that leave every number of padding lanes, whole and split into
+  ranges, over a few frames of coherent motion. The pairs have to match a
+  brute force test exactly.
+
+  Build e.g. with
+    g++ -O2 -msse2 -fsanitize=address DirectXMathExtensionSweepAndPruneCheck.cpp
+
+  Returns 0 when all results match.
+
+//----------------------------------------------------------------------------*/
+
+#include "DirectXMathExtensionSweepAndPrune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace DirectX;
+
+static bool PairLess(const MXMSAPPAIR &x, const MXMSAPPAIR &y)
+{
+  return x.a < y.a || (x.a == y.a && x.b < y.b);
+}
+
+static float Random(float scale)
+{
+  return (float)rand() / (float)RAND_MAX * scale;
+}
+
+static std::vector<MXMSAPPAIR> BruteForce(const std::vector<MXMFLOAT3> &boxMin, const std::vector<MXMFLOAT3> &boxMax)
+{
+  std::vector<MXMSAPPAIR> pairs;
+  for (size_t i = 0; i < boxMin.size(); ++i) {
+    for (size_t j = i + 1; j < boxMin.size(); ++j) {
+      if (boxMin[i].x <= boxMax[j].x && boxMin[j].x <= boxMax[i].x &&
+          boxMin[i].y <= boxMax[j].y && boxMin[j].y <= boxMax[i].y &&
+          boxMin[i].z <= boxMax[j].z && boxMin[j].z <= boxMax[i].z) {
+        MXMSAPPAIR pair = { (uint32_t)i, (uint32_t)j };
+        pairs.push_back(pair);
+      }
+    }
+  }
+  return pairs;
+}
+
+static bool SamePairs(std::vector<MXMSAPPAIR> pairs, const std::vector<MXMSAPPAIR> &reference)
+{
+  std::sort(pairs.begin(), pairs.end(), PairLess);
+  if (pairs.size() != reference.size())
+    return false;
+  for (size_t k = 0; k < pairs.size(); ++k) {
+    if (pairs[k].a != reference[k].a || pairs[k].b != reference[k].b)
+      return false;
+  }
+  return true;
+}
+
+int main()
+{
+  static const size_t counts[] = { 2, 3, 4, 5, 6, 7, 8, 9, 64, 1001 };
+
+  srand(1);
+  size_t failures = 0;
+  size_t checks = 0;
+
+  for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); ++n) {
+    const size_t count = counts[n];
+    std::vector<MXMFLOAT3> center(count), boxMin(count), boxMax(count);
+    std::vector<float> radius(count);
+    for (size_t i = 0; i < count; ++i) {
+      center[i] = MXMFLOAT3(Random(40.0f), Random(10.0f), Random(40.0f));
+      radius[i] = 0.2f + Random(1.5f);
+    }
+
+    MXMSWEEPANDPRUNE sap;
+    for (int frame = 0; frame < 4; ++frame) {
+      for (size_t i = 0; i < count; ++i) {
+        if (frame)
+          center[i] = XMVectorAdd(center[i], XMVectorSet(Random(1.0f) - 0.5f, Random(1.0f) - 0.5f, Random(1.0f) - 0.5f, 0.0f));
+        boxMin[i] = XMVectorSubtract(center[i], XMVectorReplicate(radius[i]));
+        boxMax[i] = XMVectorAdd(center[i], XMVectorReplicate(radius[i]));
+      }
+
+      // world box and ground box, placed differently every frame so they
+      // end up in every lane
+      const size_t world = (size_t)frame % count;
+      boxMin[world] = MXMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+      boxMax[world] = MXMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+      const size_t ground = (size_t)(frame + count / 2) % count;
+      if (ground != world) {
+        boxMin[ground] = MXMFLOAT3(-FLT_MAX, -1.0f, -FLT_MAX);
+        boxMax[ground] = MXMFLOAT3(FLT_MAX, 0.5f, FLT_MAX);
+      }
+
+      const std::vector<MXMSAPPAIR> reference = BruteForce(boxMin, boxMax);
+
+      std::vector<MXMSAPPAIR> pairs;
+      MXMSweepAndPrune(sap, &boxMin[0], &boxMax[0], count, pairs);
+      ++checks;
+      if (!SamePairs(pairs, reference)) {
+        printf("pair mismatch: count %u, frame %d\n", (unsigned)count, frame);
+        ++failures;
+      }
+
+      // three ranges, the last one reaching past the end
+      std::vector<std::vector<MXMSAPPAIR> > buffers(3);
+      MXMSweepAndPruneFindPairs(sap, 0, count / 3, buffers[0]);
+      MXMSweepAndPruneFindPairs(sap, count / 3, count / 3, buffers[1]);
+      MXMSweepAndPruneFindPairs(sap, 2 * (count / 3), count, buffers[2]);
+      pairs.clear();
+      MXMSweepAndPruneMergePairs(buffers, pairs);
+      ++checks;
+      if (!SamePairs(pairs, reference)) {
+        printf("range pair mismatch: count %u, frame %d\n", (unsigned)count, frame);
+        ++failures;
+      }
+    }
+  }
+
+  printf("%u of %u checks passed\n", (unsigned)(checks - failures), (unsigned)checks);
+  return failures ? 1 : 0;
+}